@@ -0,0 +1,72 @@
+/**
+ * Decodes an array of records sharing the same keys with and without the key cache,
+ * reporting time spent, heap growth and garbage collection activity for each mode
+ *
+ * node benchmark/key-cache.js [records] [iterations]
+ */
+const { PerformanceObserver } = require('perf_hooks');
+const bo = require('../');
+
+const recordsLength = parseInt(process.argv[2] || '50000', 10);
+const iterations = parseInt(process.argv[3] || '20', 10);
+const keys = [];
+
+for(let i = 0; i < 20; i++)
+    keys.push('property_name_' + i);
+
+const records = [];
+
+for(let i = 0; i < recordsLength; i++) {
+    const record = {};
+    for(const key of keys)
+        record[key] = i;
+    records.push(record);
+}
+
+const buffer = new bo.ObjectEncoder().encode(records);
+let collections = 0;
+let collectionTime = 0;
+
+const observer = new PerformanceObserver(list => {
+    for(const entry of list.getEntries()) {
+        collections++;
+        collectionTime += entry.duration;
+    }
+});
+observer.observe({ entryTypes: ['gc'] });
+
+function run(keyCache) {
+    return new Promise(resolve => {
+        collections = 0;
+        collectionTime = 0;
+
+        const heapBefore = process.memoryUsage().heapUsed;
+        const start = process.hrtime.bigint();
+
+        for(let i = 0; i < iterations; i++)
+            new bo.ObjectDecoder(buffer, undefined, { keyCache }).decode();
+
+        const elapsed = Number(process.hrtime.bigint() - start) / 1e6;
+        const heapAfter = process.memoryUsage().heapUsed;
+
+        // gc entries are delivered asynchronously
+        setImmediate(() => {
+            console.log(
+                '%s: %s ms per decode, heap growth %s MB, %d collections taking %s ms',
+                keyCache.padEnd(7),
+                (elapsed / iterations).toFixed(2),
+                ((heapAfter - heapBefore) / 1048576).toFixed(2),
+                collections,
+                collectionTime.toFixed(2)
+            );
+            resolve();
+        });
+    });
+}
+
+console.log('%d records with %d keys, %d bytes', recordsLength, keys.length, buffer.byteLength);
+
+run('none')
+    .then(() => run('call'))
+    .then(() => run('decoder'))
+    .then(() => observer.disconnect());
@@ -0,0 +1,39 @@
+/**
+ * Decodes an array of records sharing the same keys with and without the shape cache
+ *
+ * node benchmark/shape-cache.js [records] [iterations]
+ */
+const bo = require('../');
+
+const recordsLength = parseInt(process.argv[2] || '50000', 10);
+const iterations = parseInt(process.argv[3] || '20', 10);
+const records = [];
+
+for(let i = 0; i < recordsLength; i++) {
+    records.push({
+        id: i,
+        name: 'user ' + i,
+        email: 'user' + i + '@example.com',
+        active: i % 2 == 0,
+        score: i * 3,
+        tags: ['a', 'b', 'c']
+    });
+}
+
+const buffer = new bo.ObjectEncoder().encode(records);
+
+function run(shapeCache) {
+    const start = process.hrtime.bigint();
+
+    for(let i = 0; i < iterations; i++)
+        new bo.ObjectDecoder(buffer, undefined, { shapeCache }).decode();
+
+    const elapsed = Number(process.hrtime.bigint() - start) / 1e6;
+
+    console.log('shapeCache = %s: %s ms per decode', String(shapeCache).padEnd(5), (elapsed / iterations).toFixed(2));
+}
+
+console.log('%d records, %d bytes', recordsLength, buffer.byteLength);
+
+run(false);
+run(true);
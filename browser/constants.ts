@@ -18,5 +18,40 @@ export enum PropertyType {
     Undefined = 17,
     Map = 18,
     Buffer = 19,
-    ArrayBuffer = 20
-}
\ No newline at end of file
+    ArrayBuffer = 20,
+    OneByteString = 21,
+    PackedArray = 22,
+    TypedArray = 23,
+    VarInt = 24,
+    Sized = 25,
+    Record = 26,
+    Columns = 27,
+    Dictionary = 28,
+    Reference = 29,
+    Shared = 30
+}
+
+export enum ElementKind {
+    Int8 = 1,
+    UInt8 = 2,
+    UInt8Clamped = 3,
+    Int16 = 4,
+    UInt16 = 5,
+    Int32 = 6,
+    UInt32 = 7,
+    Float32 = 8,
+    Float64 = 9,
+    BigInt64 = 10,
+    BigUInt64 = 11,
+    DataView = 12
+}
+
+export enum Format {
+    V1 = 1,
+    V2 = 2
+}
+
+/**
+ * Messages of any format after the first start with this byte followed by the format
+ */
+export const FormatHeader = 0;
@@ -7,4 +7,14 @@ export abstract class CustomTypeProcessor<T> {
 export interface CustomInstruction<T> {
     value: number;
     processor: CustomTypeProcessor<T>;
+    /**
+     * Values whose prototype is exactly `exactClass.prototype` are
+     * handled by this instruction without calling `validate()`
+     */
+    exactClass?: Function;
+    /**
+     * Values that are instances of `instanceOf` are handled
+     * by this instruction without calling `validate()`
+     */
+    instanceOf?: Function;
 }
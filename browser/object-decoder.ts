@@ -1,28 +1,69 @@
 import { CustomInstruction } from './custom-types';
-import { PropertyType } from './constants';
+import { PropertyType, ElementKind, Format, FormatHeader } from './constants';
 
 export class ObjectDecoder {
     private offset: number;
     private buffer: Buffer;
+    private format: Format;
     private custom?: CustomInstruction<any>[];
+    /**
+     * Values of the shared value being read which can be referenced, in the order they were read
+     */
+    private references?: { minLength: number, values: any[] };
 
     constructor(buffer: Buffer, custom?: CustomInstruction<any>[]) {
         this.buffer = buffer;
         this.offset = 0;
         this.custom = custom;
+        this.format = Format.V1;
     }
 
     public decode(): any {
-        const type: PropertyType = this.readUInt8();
+        this.readHeader();
+
+        let type: PropertyType = this.readUInt8();
+
+        if(type == PropertyType.Sized) {
+            this.offset += 4;
+            type = this.readUInt8();
+        }
 
         if(type == PropertyType.Object)
             return this.decodeObject();
         else if(type == PropertyType.Array)
             return this.decodeArray();
+        else if(type == PropertyType.PackedArray)
+            return this.decodePackedArray();
+        else if(type == PropertyType.Columns)
+            return this.decodeColumns();
+        else if(type == PropertyType.Shared)
+            return this.decodeShared();
 
         throw new Error(`Invalid initial message: ${PropertyType[type]} || ${type}`);
     }
 
+    /**
+     * Messages of the first format have no header
+     */
+    private readHeader() {
+        this.format = Format.V1;
+
+        if(this.offset + 1 < this.buffer.byteLength && this.buffer[this.offset] == FormatHeader && this.buffer[this.offset + 1] == Format.V2) {
+            this.format = Format.V2;
+            this.offset += 2;
+        }
+    }
+
+    /**
+     * Read length of a string or container
+     */
+    private readLength() {
+        if(this.format == Format.V2)
+            return this.readVarUInt();
+
+        return this.readNumber();
+    }
+
     private readBytes(byteLength: number): Buffer {
         if((this.offset + byteLength) > this.buffer.byteLength)
             throw new Error('Exceeded maximum size of buffer, can\'t go any further');
@@ -77,8 +118,8 @@ export class ObjectDecoder {
     }
 
     private decodeArray() {
-        const length = this.readNumber();
-        const list = new Array(length);
+        const length = this.readLength();
+        const list = this.share(new Array(length));
 
         for(let i = 0; i < length; i++)
             list[i] = this.decodeValue();
@@ -86,6 +127,138 @@ export class ObjectDecoder {
         return list;
     }
 
+    /**
+     * Read typed array or `DataView`. Contents are copied, so the
+     * result is aligned no matter where it is in the input
+     */
+    private decodeTypedArray() {
+        const kind: ElementKind = this.readUInt8();
+        const byteLength = this.readLength();
+
+        this.readBytes(this.readUInt8());
+
+        const contents = this.readBytes(byteLength);
+        const buffer = contents.buffer.slice(contents.byteOffset, contents.byteOffset + byteLength);
+
+        switch(kind) {
+            case ElementKind.Int8:
+                return new Int8Array(buffer);
+            case ElementKind.UInt8:
+                return new Uint8Array(buffer);
+            case ElementKind.UInt8Clamped:
+                return new Uint8ClampedArray(buffer);
+            case ElementKind.Int16:
+                return new Int16Array(buffer);
+            case ElementKind.UInt16:
+                return new Uint16Array(buffer);
+            case ElementKind.Int32:
+                return new Int32Array(buffer);
+            case ElementKind.UInt32:
+                return new Uint32Array(buffer);
+            case ElementKind.Float32:
+                return new Float32Array(buffer);
+            case ElementKind.Float64:
+                return new Float64Array(buffer);
+            case ElementKind.BigInt64:
+                return new BigInt64Array(buffer);
+            case ElementKind.BigUInt64:
+                return new BigUint64Array(buffer);
+            case ElementKind.DataView:
+                return new DataView(buffer);
+        }
+
+        throw new Error(`Invalid typed array kind: ${kind}`);
+    }
+
+    /**
+     * Read array of numbers which were written one after the other with the same type
+     */
+    private decodePackedArray() {
+        const type: PropertyType = this.readUInt8();
+        const length = this.readLength();
+        const list = new Array(length);
+
+        for(let i = 0; i < length; i++)
+            list[i] = this.readNumberByType(type);
+
+        return list;
+    }
+
+    /**
+     * Number value when it's inside a shared value, so later references can find it. Containers
+     * are numbered before their contents are read, so they can contain references to themselves
+     */
+    private share<T>(value: T): T {
+        if(this.references)
+            this.references.values.push(value);
+
+        return value;
+    }
+
+    private shareString(value: string) {
+        return this.references && value.length >= this.references.minLength ? this.share(value) : value;
+    }
+
+    private decodeShared() {
+        const outer = this.references;
+
+        this.references = { minLength: this.readLength(), values: [] };
+
+        try {
+            return this.decodeValue();
+        } finally {
+            this.references = outer;
+        }
+    }
+
+    private readReference() {
+        const id = this.readLength();
+
+        if(!this.references)
+            throw new Error('Got reference outside of a shared value');
+        if(id >= this.references.values.length)
+            throw new Error(`Got reference to unknown value ${id}`);
+
+        return this.references.values[id];
+    }
+
+    /**
+     * Read distinct strings followed by the index of each item among them
+     */
+    private decodeDictionary() {
+        const length = this.readLength();
+        const strings = new Array(length);
+
+        for(let i = 0; i < length; i++)
+            strings[i] = this.decodeValue();
+
+        return this.decodeValue().map((index: number) => strings[index]);
+    }
+
+    /**
+     * Read array of objects written as one column per key
+     */
+    private decodeColumns() {
+        const rows = this.readLength();
+        const keys = new Array(this.readLength());
+        const list = new Array(rows);
+
+        for(let i = 0; i < keys.length; i++)
+            keys[i] = this.readString();
+
+        for(let i = 0; i < rows; i++)
+            list[i] = {};
+
+        for(const key of keys) {
+            const column = this.decodeValue();
+
+            for(let i = 0; i < rows; i++)
+                list[i][key] = column[i];
+        }
+
+        return list;
+    }
+
     /**
      * Read an integer of any kind
      */
@@ -111,6 +284,14 @@ export class ObjectDecoder {
             return this.readInt32LE();
         else if(type == PropertyType.UInt32)
             return this.readUInt32LE();
+        else if(type == PropertyType.Float)
+            return this.readFloat();
+        else if(type == PropertyType.VarInt)
+            return this.readVarInt();
+        else if(type == PropertyType.Int64)
+            return this.readBigInt64LE();
+        else if(type == PropertyType.UInt64)
+            return this.readBigUInt64LE();
         else if(type == PropertyType.Double)
             return this.readDouble();
 
@@ -122,12 +303,12 @@ export class ObjectDecoder {
     }
 
     private readString(): string {
-        return this.readBytes(this.readNumber()).toString('utf8');
+        return this.readBytes(this.readLength()).toString('utf8');
     }
 
     private decodeObject(): any {
-        const result: any = {};
-        const propertiesLength = this.readNumber();
+        const result: any = this.share({});
+        const propertiesLength = this.readLength();
 
         for(let i = 0; i < propertiesLength; i++) {
             const propertyName = this.readString();
@@ -145,9 +326,59 @@ export class ObjectDecoder {
         return result;
     }
 
+    private readBigInt64LE(): bigint {
+        const result = this.buffer.readBigInt64LE(this.offset);
+
+        this.offset += 8;
+
+        return result;
+    }
+
+    private readBigUInt64LE(): bigint {
+        const result = this.buffer.readBigUInt64LE(this.offset);
+
+        this.offset += 8;
+
+        return result;
+    }
+
+    /**
+     * Read LEB128 integer
+     */
+    private readVarUInt(): number {
+        let result = 0;
+        let multiplier = 1;
+        let byte;
+
+        do {
+            byte = this.readUInt8();
+            result += (byte & 0x7f) * multiplier;
+            multiplier *= 128;
+        } while(byte & 0x80);
+
+        return result;
+    }
+
+    /**
+     * Read zigzag LEB128 integer
+     */
+    private readVarInt(): number {
+        const result = this.readVarUInt();
+
+        return result % 2 == 0 ? result / 2 : -(result + 1) / 2;
+    }
+
+    private readFloat(): number {
+        const result = this.buffer.readFloatLE(this.offset);
+
+        this.offset += 4;
+
+        return result;
+    }
+
     private readNativeMap(): Map<any, any> {
-        const map = new Map();
-        const length = this.readNumber();
+        const map = this.share(new Map());
+        const length = this.readLength();
 
         for(let i = 0; i < length; i++) {
             const key = this.decodeValue();
@@ -165,7 +396,7 @@ export class ObjectDecoder {
             const { value, processor } = this.custom[i];
 
             if(value == type) {
-                const customDataLength = this.readNumber();
+                const customDataLength = this.readLength();
 
                 return processor.decode(this.readBytes(customDataLength));
             }
@@ -181,22 +412,40 @@ export class ObjectDecoder {
             return null;
         else if(type == PropertyType.Undefined)
             return undefined;
-        else if(type == PropertyType.Object)
+        else if(type == PropertyType.Sized) {
+            // Byte length is only needed to step over values without reading them
+            this.offset += 4;
+            return this.decodeValue();
+        } else if(type == PropertyType.Object)
             return this.decodeObject();
         else if(type == PropertyType.String)
-            return this.readBytes(this.readNumber()).toString('utf8');
+            return this.shareString(this.readBytes(this.readLength()).toString('utf8'));
+        else if(type == PropertyType.OneByteString)
+            return this.shareString(this.readBytes(this.readLength()).toString('latin1'));
         else if(type == PropertyType.Date)
             return new Date(this.readDouble());
         else if(type == PropertyType.Boolean)
             return this.readUInt8() == 1 ? true : false;
         else if(type == PropertyType.Array)
             return this.decodeArray();
+        else if(type == PropertyType.PackedArray)
+            return this.share(this.decodePackedArray());
+        else if(type == PropertyType.Columns)
+            return this.decodeColumns();
+        else if(type == PropertyType.Shared)
+            return this.decodeShared();
+        else if(type == PropertyType.Reference)
+            return this.readReference();
+        else if(type == PropertyType.Dictionary)
+            return this.decodeDictionary();
         else if(type == PropertyType.Map)
             return this.readNativeMap();
         else if(type == PropertyType.Buffer)
-            return this.readBytes(this.readNumber());
+            return this.readBytes(this.readLength());
+        else if(type == PropertyType.TypedArray)
+            return this.decodeTypedArray();
         else if(type == PropertyType.ArrayBuffer) {
-            const output = this.readBytes(this.readNumber());
+            const output = this.readBytes(this.readLength());
 
             return output.buffer.slice(output.byteOffset, output.byteOffset + output.byteLength);
         } else {
@@ -92,6 +92,40 @@ export class ObjectEncoder {
             this.encodeInteger(4, value, true);
         else if(value >= -0x80000000 && value <= 0x7fffffff)
             this.encodeInteger(4, value, false);
+        else if(Number.isSafeInteger(value))
+            this.encodeVarInt(value);
+        else
+            this.encodeDouble(value);
+    }
+
+    /**
+     * Write safe integer as zigzag LEB128
+     */
+    private encodeVarInt(value: number) {
+        const bytes: number[] = [PropertyType.VarInt];
+        let n = value < 0 ? -value * 2 - 1 : value * 2;
+
+        while(n >= 0x80) {
+            bytes.push((n % 0x80) | 0x80);
+            n = Math.floor(n / 0x80);
+        }
+
+        bytes.push(n);
+        this.buffers.push(Buffer.from(bytes));
+    }
+
+    private encodeBigInt(value: bigint) {
+        const buffer = Buffer.allocUnsafe(9);
+
+        if(value < 0n) {
+            buffer.writeUInt8(PropertyType.Int64, 0);
+            buffer.writeBigInt64LE(value, 1);
+        } else {
+            buffer.writeUInt8(PropertyType.UInt64, 0);
+            buffer.writeBigUInt64LE(value, 1);
+        }
+
+        this.buffers.push(buffer);
     }
 
     private encodeDouble(n: number) {
@@ -162,6 +196,8 @@ export class ObjectEncoder {
             this.writeUInt8(value ? 1 : 0);
         } else if(typeof value == 'number') {
             this.encodeNumber(value);
+        } else if(typeof value == 'bigint') {
+            this.encodeBigInt(value);
         } else if(typeof value == 'object' && value.constructor == Object) {
             this.encodeObject(value);
         } else {
@@ -179,9 +215,17 @@ export class ObjectEncoder {
             return false;
 
         for(let i = 0; i < this.custom.length; i++) {
-            const { processor, value: customType } = this.custom[i];
+            const { processor, value: customType, exactClass, instanceOf } = this.custom[i];
+            let matches: boolean;
+
+            if(exactClass)
+                matches = typeof value == 'object' && Object.getPrototypeOf(value) === exactClass.prototype;
+            else if(instanceOf)
+                matches = value instanceof instanceOf;
+            else
+                matches = processor.validate(value);
 
-            if(processor.validate(value)) {
+            if(matches) {
                 const result = processor.encode(value);
 
                 this.writeUInt8(customType);
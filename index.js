@@ -1,22 +1,266 @@
 const bo = require('bindings')('binobject');
+const { Transform } = require('stream');
 
 class CustomTypeProcessor {
 
 }
 
+/**
+ * Stands for `null` in object streams, where pushing `null` would end the stream
+ */
+const NULL = Symbol('binobject.null');
+
 class BinaryObject {
-    constructor(custom) {
+    constructor(custom, options) {
         this.custom = custom;
+        this.options = options;
+        this.encoder = new bo.ObjectEncoder(custom, options);
     }
     encode(object) {
-        return new bo.ObjectEncoder(this.custom).encode(object);
+        return this.encoder.encode(object);
+    }
+    encodeAsync(object) {
+        return encodeAsync(this.encoder, object);
+    }
+    encodeInto(object, buffer, offset) {
+        return this.encoder.encodeInto(object, buffer, offset);
+    }
+    encodeMany(values) {
+        return this.encoder.encodeMany(values);
+    }
+    decode(buffer, options) {
+        return new bo.ObjectDecoder(buffer, this.custom, this.options).decode(options);
+    }
+    decodeMany(buffer) {
+        return new bo.ObjectDecoder(buffer, this.custom, this.options).decodeMany();
+    }
+    decodeAsync(buffer) {
+        return decodeAsync(new bo.ObjectDecoder(buffer, this.custom, this.options));
     }
-    decode(buffer) {
-        return new bo.ObjectDecoder(buffer, this.custom).decode();
+    decodeLazy(buffer) {
+        return new bo.ObjectDecoder(buffer, this.custom, this.options).decodeLazy();
     }
 }
 
+function encodeAsync(encoder, value, schema) {
+    return new Promise((resolve, reject) => {
+        encoder.encodeAsync(value, schema, (error, buffer) => error ? reject(error) : resolve(buffer));
+    });
+}
+
+function decodeAsync(decoder) {
+    return new Promise((resolve, reject) => {
+        decoder.decodeAsync((error, value) => error ? reject(error) : resolve(value));
+    });
+}
+
+/**
+ * Value at `offset` of the decoder input. Objects and arrays are proxies which only decode
+ * an item when it is accessed, using offsets of all of their items found on first access
+ */
+function lazyValue(decoder, offset) {
+    const type = decoder.typeAt(offset);
+
+    if(type == 'value')
+        return decoder.decodeAt(offset);
+
+    const isArray = type == 'array';
+    const target = isArray ? [] : {};
+    let offsets = null;
+
+    const load = () => {
+        if(offsets !== null)
+            return offsets;
+
+        const index = decoder.index(offset);
+
+        offsets = new Map();
+
+        if(isArray) {
+            for(let i = 0; i < index.length; i++)
+                offsets.set(String(i), index[i]);
+            target.length = index.length;
+        } else {
+            for(let i = 0; i < index.length; i += 2)
+                offsets.set(index[i], index[i + 1]);
+        }
+
+        return offsets;
+    };
+
+    // Items become own properties of the target once decoded, so they are decoded only once
+    const materialize = (key) => {
+        const items = load();
+
+        if(items.has(key) && !Object.prototype.hasOwnProperty.call(target, key)) {
+            const value = lazyValue(decoder, items.get(key));
+
+            Object.defineProperty(target, key, { value, writable: true, enumerable: true, configurable: true });
+        }
+    };
+
+    return new Proxy(target, {
+        get(target, key, receiver) {
+            materialize(key);
+            return Reflect.get(target, key, receiver);
+        },
+        has(target, key) {
+            return load().has(key) || Reflect.has(target, key);
+        },
+        set(target, key, value, receiver) {
+            load();
+            return Reflect.set(target, key, value, receiver);
+        },
+        deleteProperty(target, key) {
+            load().delete(key);
+            return Reflect.deleteProperty(target, key);
+        },
+        ownKeys(target) {
+            const keys = new Set(load().keys());
+
+            for(const key of Reflect.ownKeys(target))
+                keys.add(key);
+
+            return Array.from(keys);
+        },
+        getOwnPropertyDescriptor(target, key) {
+            materialize(key);
+            return Reflect.getOwnPropertyDescriptor(target, key);
+        }
+    });
+}
+
+/**
+ * Read the next value lazily. Input is checked to hold a complete value, but objects and arrays
+ * in it are only decoded as far as they are accessed. Values stay valid while the input is not changed
+ */
+bo.ObjectDecoder.prototype.decodeLazy = function() {
+    return lazyValue(this, this.skipValue());
+};
+
+/**
+ * Decode records of the log one after the other, in the order they were appended
+ */
+bo.RecordLogReader.prototype[Symbol.iterator] = function*() {
+    for(let i = 0; i < this.count(); i++)
+        yield this.decode(i);
+};
+
+/**
+ * Encode objects written to it into chunks of `chunkSize` bytes. If `length` option
+ * is given they are the elements of an array, otherwise each one is a value of it's own
+ */
+class EncodeStream extends Transform {
+    constructor(custom, options = {}) {
+        const { length, ...encoderOptions } = options;
+
+        super({ writableObjectMode: true });
+        this.encoder = new bo.ObjectStreamEncoder(custom, encoderOptions);
+
+        if(length !== undefined)
+            this.pushChunks(this.encoder.writeArrayHeader(length));
+    }
+    pushChunks(chunks) {
+        for(const chunk of chunks)
+            this.push(chunk);
+    }
+    _transform(value, encoding, callback) {
+        try {
+            this.pushChunks(this.encoder.write(value === NULL ? null : value));
+        } catch(reason) {
+            return callback(reason);
+        }
+        callback();
+    }
+    _flush(callback) {
+        try {
+            this.pushChunks(this.encoder.end());
+        } catch(reason) {
+            return callback(reason);
+        }
+        callback();
+    }
+}
+
+/**
+ * Decode chunks written to it into the values they contain. With the `elements` option elements of
+ * top-level arrays are given out one at a time instead of the arrays
+ */
+class DecodeStream extends Transform {
+    constructor(custom, options = {}) {
+        const { elements, ...decoderOptions } = options;
+
+        super({ readableObjectMode: true });
+
+        if(elements)
+            decoderOptions.onElement = (value) => this.push(value === null ? NULL : value);
+
+        this.decoder = new bo.ObjectStreamDecoder(custom, decoderOptions);
+    }
+    _transform(chunk, encoding, callback) {
+        try {
+            for(const value of this.decoder.write(chunk))
+                this.push(value === null ? NULL : value);
+        } catch(reason) {
+            return callback(reason);
+        }
+        callback();
+    }
+    _flush(callback) {
+        try {
+            this.decoder.end();
+        } catch(reason) {
+            return callback(reason);
+        }
+        callback();
+    }
+}
+
+/**
+ * Check `buffer` holds one well formed message, without decoding it. Gives back null
+ * if it does, or `{ offset, message }` telling where the first error is otherwise
+ */
+bo.validate = function(buffer, custom, options) {
+    return new bo.ObjectDecoder(buffer, custom, options).validate();
+};
+
+/**
+ * Encode `value` right away, but compress it on the thread pool when the `compress` option is set,
+ * so the event loop isn't blocked while it is
+ */
+bo.encodeAsync = function(value, custom, options) {
+    return encodeAsync(new bo.ObjectEncoder(custom, options), value);
+};
+
+/**
+ * Decode `buffer` without blocking the event loop while it's checked and it's items are found.
+ * Buffer must not be changed until the promise is settled
+ */
+bo.decodeAsync = function(buffer, custom, options) {
+    return decodeAsync(new bo.ObjectDecoder(buffer, custom, options));
+};
+
+/**
+ * Compile the layout of a record, such as `{ id: 'uint32', name: 'string', tags: ['string'] }`. The schema
+ * encodes and decodes records on it's own, and can be given to the `schemas` option of any encoder or
+ * decoder so records are nested in other messages. Options `id` and `class` are used for that: records
+ * are told apart by their id, and encoders write instances of `class` as records
+ */
+bo.compileSchema = function(definition, options = {}) {
+    const { id, class: recordClass, ...codecOptions } = options;
+    const schema = new bo.ObjectSchema(definition, { id, class: recordClass });
+    const encoder = new bo.ObjectEncoder(undefined, { ...codecOptions, schemas: [schema] });
+    const decoderOptions = { ...codecOptions, schemas: [schema] };
+
+    schema.encode = (value) => encoder.encode(value, schema);
+    schema.decode = (buffer) => new bo.ObjectDecoder(buffer, undefined, decoderOptions).decode();
+    return schema;
+};
+
 bo.BinaryObject = BinaryObject;
+bo.EncodeStream = EncodeStream;
+bo.DecodeStream = DecodeStream;
+bo.NULL = NULL;
 bo.CustomTypeProcessor = CustomTypeProcessor;
 
 module.exports = bo;
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef ASCII_H_
+#define ASCII_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace Ascii {
+    /**
+     * Check if every byte is below 0x80, 16 bytes at a time when SIMD is available
+     */
+    inline bool IsASCII(const uint8_t* data, size_t length) {
+        size_t i = 0;
+
+#if defined(__SSE2__)
+        for(; i + 16 <= length; i += 16) {
+            __m128i chunk = _mm_loadu_si128((const __m128i*) (data + i));
+            if(_mm_movemask_epi8(chunk) != 0)
+                return false;
+        }
+#elif defined(__ARM_NEON)
+        for(; i + 16 <= length; i += 16) {
+            if(vmaxvq_u8(vld1q_u8(data + i)) >= 0x80)
+                return false;
+        }
+#endif
+
+        for(; i + 8 <= length; i += 8) {
+            uint64_t word;
+            memcpy(&word, data + i, sizeof(word));
+            if((word & 0x8080808080808080ULL) != 0)
+                return false;
+        }
+
+        for(; i < length; i++)
+            if(data[i] >= 0x80)
+                return false;
+
+        return true;
+    }
+}
+
+#endif
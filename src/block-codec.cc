@@ -0,0 +1,213 @@
+#include "block-codec.h"
+
+#include <string.h>
+#include <vector>
+
+static const size_t min_match = 4;
+static const size_t max_distance = 65535;
+static const int hash_bits = 14;
+static const uint32_t no_position = UINT32_MAX;
+
+static inline uint32_t Load32(const uint8_t* data) {
+    uint32_t n;
+    memcpy(&n, data, sizeof(n));
+    return n;
+}
+
+static inline uint32_t Hash(uint32_t sequence) {
+    return (sequence * 2654435761U) >> (32 - hash_bits);
+}
+
+/**
+ * Write `length` as the extra bytes of a nibble which was set to 15
+ */
+static bool WriteExtraLength(uint8_t* output, size_t capacity, size_t* offset, size_t length) {
+    while(length >= 255) {
+        if(*offset >= capacity)
+            return false;
+
+        output[(*offset)++] = 255;
+        length -= 255;
+    }
+
+    if(*offset >= capacity)
+        return false;
+
+    output[(*offset)++] = (uint8_t) length;
+    return true;
+}
+
+/**
+ * Write sequence of `literals_length` bytes of `literals` followed by a match. A `match_length` of zero means there is no match
+ */
+static bool WriteSequence(uint8_t* output, size_t capacity, size_t* offset, const uint8_t* literals, size_t literals_length,
+    size_t distance, size_t match_length) {
+    size_t match_nibble = match_length > 0 ? match_length - min_match : 0;
+
+    if(*offset >= capacity)
+        return false;
+
+    output[(*offset)++] = (uint8_t) (((literals_length < 15 ? literals_length : 15) << 4) | (match_nibble < 15 ? match_nibble : 15));
+
+    if(literals_length >= 15 && !WriteExtraLength(output, capacity, offset, literals_length - 15))
+        return false;
+
+    if(literals_length > capacity - *offset)
+        return false;
+
+    if(literals_length > 0)
+        memcpy(output + *offset, literals, literals_length);
+
+    *offset += literals_length;
+
+    if(match_length == 0)
+        return true;
+
+    if(capacity - *offset < 2)
+        return false;
+
+    output[(*offset)++] = (uint8_t) (distance & 0xff);
+    output[(*offset)++] = (uint8_t) (distance >> 8);
+
+    return match_nibble < 15 || WriteExtraLength(output, capacity, offset, match_nibble - 15);
+}
+
+size_t BlockCodec::Bound(size_t length) {
+    return length + length / 255 + 16;
+}
+
+size_t BlockCodec::Compress(const uint8_t* input, size_t length, uint8_t* output, size_t capacity) {
+    std::vector<uint32_t> positions(1 << hash_bits, no_position);
+    size_t offset = 0;
+    size_t anchor = 0;
+    size_t position = 0;
+
+    while(length >= min_match && position <= length - min_match) {
+        uint32_t sequence = Load32(input + position);
+        uint32_t hash = Hash(sequence);
+        size_t candidate = positions[hash];
+
+        positions[hash] = (uint32_t) position;
+
+        if(candidate == no_position || position - candidate > max_distance || Load32(input + candidate) != sequence) {
+            // Input which doesn't compress is stepped over faster the longer it goes on
+            position += 1 + ((position - anchor) >> 6);
+            continue;
+        }
+
+        size_t match_length = min_match;
+
+        while(position + match_length < length && input[candidate + match_length] == input[position + match_length])
+            match_length++;
+
+        if(!WriteSequence(output, capacity, &offset, input + anchor, position - anchor, position - candidate, match_length))
+            return 0;
+
+        position += match_length;
+        anchor = position;
+    }
+
+    if(!WriteSequence(output, capacity, &offset, input + anchor, length - anchor, 0, 0))
+        return 0;
+
+    return offset;
+}
+
+/**
+ * Read extra bytes of a nibble which was set to 15 and add them to `length`
+ */
+static bool ReadExtraLength(const uint8_t* input, size_t input_length, size_t* offset, size_t* length) {
+    uint8_t byte;
+
+    do {
+        if(*offset >= input_length)
+            return false;
+
+        byte = input[(*offset)++];
+        *length += byte;
+    } while(byte == 255);
+
+    return true;
+}
+
+bool BlockCodec::Decompress(const uint8_t* input, size_t length, uint8_t* output, size_t output_length) {
+    size_t offset = 0;
+    size_t position = 0;
+
+    while(offset < length) {
+        uint8_t token = input[offset++];
+        size_t literals_length = token >> 4;
+
+        if(literals_length == 15 && !ReadExtraLength(input, length, &offset, &literals_length))
+            return false;
+
+        if(literals_length > length - offset || literals_length > output_length - position)
+            return false;
+
+        if(literals_length > 0)
+            memcpy(output + position, input + offset, literals_length);
+
+        offset += literals_length;
+        position += literals_length;
+
+        if(offset == length)
+            break;
+
+        if(length - offset < 2)
+            return false;
+
+        size_t distance = input[offset] | (input[offset + 1] << 8);
+        size_t match_length = token & 0x0f;
+
+        offset += 2;
+
+        if(match_length == 15 && !ReadExtraLength(input, length, &offset, &match_length))
+            return false;
+
+        match_length += min_match;
+
+        if(distance == 0 || distance > position || match_length > output_length - position)
+            return false;
+
+        // Matches can overlap the bytes they produce, which repeats a short pattern
+        if(distance >= match_length) {
+            memcpy(output + position, output + position - distance, match_length);
+        } else {
+            for(size_t i = 0; i < match_length; i++)
+                output[position + i] = output[position + i - distance];
+        }
+
+        position += match_length;
+    }
+
+    return position == output_length;
+}
+
+/**
+ * Table of the CRC of every byte value, made when the module is loaded
+ */
+struct ChecksumTable {
+    uint32_t entries[256];
+
+    ChecksumTable() {
+        for(uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+
+            for(int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1)));
+
+            entries[i] = crc;
+        }
+    }
+};
+
+static const ChecksumTable checksum_table;
+
+uint32_t BlockCodec::Checksum(const uint8_t* data, size_t length) {
+    uint32_t crc = 0xFFFFFFFFU;
+
+    for(size_t i = 0; i < length; i++)
+        crc = checksum_table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+    return crc ^ 0xFFFFFFFFU;
+}
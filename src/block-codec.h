@@ -0,0 +1,36 @@
+#ifndef BLOCK_CODEC_H_
+#define BLOCK_CODEC_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Byte-oriented LZ77 codec for blocks of encoded messages. A block is a list of sequences, each made of a token
+ * byte, the literals which are copied as they are and a match, which repeats bytes written before it. The high
+ * nibble of the token is the amount of literals and the low nibble the match length minus 4. A nibble of 15
+ * is followed by bytes which are added to it, until one of them is not 255. Matches are written as the
+ * distance to the bytes they repeat, as a 16-bit integer, followed by the rest of their length. The last
+ * sequence of a block has literals only
+ */
+namespace BlockCodec {
+    /**
+     * Largest amount of bytes `length` bytes of input can be compressed into
+     */
+    size_t Bound(size_t length);
+    /**
+     * Compress `length` bytes of `input` into `output`, which has room for `capacity` bytes. Returns
+     * the amount of bytes written, or zero if they did not fit
+     */
+    size_t Compress(const uint8_t* input, size_t length, uint8_t* output, size_t capacity);
+    /**
+     * Decompress `length` bytes of `input` into exactly `output_length` bytes of `output`. Returns false
+     * if the input is not valid, such as when it points before the beginning of the output
+     */
+    bool Decompress(const uint8_t* input, size_t length, uint8_t* output, size_t output_length);
+    /**
+     * CRC-32 of `length` bytes of `data`, with the same polynomial as zlib
+     */
+    uint32_t Checksum(const uint8_t* data, size_t length);
+}
+
+#endif
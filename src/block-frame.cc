@@ -0,0 +1,260 @@
+#include "block-frame.h"
+#include "block-codec.h"
+#include "node-binobject.h"
+
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+static const size_t header_length = 10;
+static const size_t block_entry_length = 12;
+/**
+ * Blocks can't hold more than this amount of bytes for each compressed byte, so
+ * frames can't claim messages much bigger than themselves
+ */
+static const size_t max_ratio = 256;
+static const unsigned int max_threads = 4;
+
+/**
+ * Threads which run the blocks of frames, together with the threads which asked for them. Several
+ * frames can run at once: pool threads take blocks of the oldest frame first, while each thread which
+ * asked for a frame only runs blocks of it's own, so it never waits behind other frames. Threads
+ * are started when the first frame with more than one block is written or read
+ */
+class BlockPool {
+private:
+    /**
+     * Blocks of a frame being run
+     */
+    struct Job {
+        const std::function<void(size_t)>* fn;
+        size_t next = 0;
+        size_t count = 0;
+        size_t pending = 0;
+    };
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+    std::vector<std::thread> threads;
+    /**
+     * Jobs which still have blocks nobody took, oldest first
+     */
+    std::vector<Job*> jobs;
+
+    /**
+     * Run the next block of `job`, which is taken off the queue once it has none left. Called with `lock` held
+     */
+    void RunBlock(Job* job, std::unique_lock<std::mutex>& lock) {
+        size_t index = job->next++;
+
+        if(job->next == job->count)
+            jobs.erase(std::find(jobs.begin(), jobs.end(), job));
+
+        lock.unlock();
+        (*job->fn)(index);
+        lock.lock();
+
+        if(--job->pending == 0)
+            work_done.notify_all();
+    }
+
+    void Loop() {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while(true) {
+            work_ready.wait(lock, [this] { return !jobs.empty(); });
+            RunBlock(jobs.front(), lock);
+        }
+    }
+
+    void Start() {
+        unsigned int concurrency = std::min(std::max(std::thread::hardware_concurrency(), 1U), max_threads);
+
+        // Threads live as long as the process, so they are never joined
+        for(unsigned int i = 1; i < concurrency; i++) {
+            threads.push_back(std::thread(&BlockPool::Loop, this));
+            threads.back().detach();
+        }
+    }
+public:
+    /**
+     * Call `fn` with every index below `length`, spread across the pool. Returns when all calls are done
+     */
+    void Run(size_t length, const std::function<void(size_t)>& fn) {
+        if(length <= 1) {
+            for(size_t i = 0; i < length; i++)
+                fn(i);
+            return;
+        }
+
+        Job job;
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if(threads.empty())
+            Start();
+
+        job.fn = &fn;
+        job.count = length;
+        job.pending = length;
+        jobs.push_back(&job);
+        work_ready.notify_all();
+
+        while(job.next < job.count)
+            RunBlock(&job, lock);
+
+        // Blocks taken by pool threads are still being run, and the job must outlive them
+        work_done.wait(lock, [&job] { return job.pending == 0; });
+    }
+};
+
+// Threads of the pool keep using it until the process exits, so it's never deleted
+static BlockPool* pool = new BlockPool();
+
+static inline void WriteUInt32LE(uint8_t* output, uint32_t n) {
+    output[0] = (uint8_t) n;
+    output[1] = (uint8_t) (n >> 8);
+    output[2] = (uint8_t) (n >> 16);
+    output[3] = (uint8_t) (n >> 24);
+}
+
+static inline uint32_t ReadUInt32LE(const uint8_t* data) {
+    return (uint32_t) data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+bool BlockFrame::IsFrame(const uint8_t* data, size_t length) {
+    return length >= 2 && data[0] == BO::Format::Header && data[1] == BO::Format::Compressed;
+}
+
+void BlockFrame::Write(const uint8_t* data, size_t length, uint32_t block_size, std::vector<uint8_t>& output) {
+    size_t block_count = length == 0 ? 0 : (length - 1) / block_size + 1;
+    std::vector<std::vector<uint8_t>> blocks(block_count);
+    std::vector<uint32_t> checksums(block_count);
+
+    pool->Run(block_count, [&](size_t i) {
+        const uint8_t* contents = data + i * block_size;
+        size_t contents_length = std::min((size_t) block_size, length - i * block_size);
+        std::vector<uint8_t>& block = blocks[i];
+
+        block.resize(BlockCodec::Bound(contents_length));
+
+        size_t compressed_length = BlockCodec::Compress(contents, contents_length, block.data(), block.size());
+
+        if(compressed_length == 0 || compressed_length >= contents_length)
+            block.assign(contents, contents + contents_length);
+        else
+            block.resize(compressed_length);
+
+        checksums[i] = BlockCodec::Checksum(contents, contents_length);
+    });
+
+    size_t frame_length = header_length + block_count * block_entry_length;
+
+    for(const std::vector<uint8_t>& block : blocks)
+        frame_length += block.size();
+
+    output.resize(frame_length);
+
+    uint8_t* position = output.data();
+
+    position[0] = BO::Format::Header;
+    position[1] = BO::Format::Compressed;
+    WriteUInt32LE(position + 2, (uint32_t) length);
+    WriteUInt32LE(position + 6, (uint32_t) block_count);
+    position += header_length;
+
+    for(size_t i = 0; i < block_count; i++) {
+        WriteUInt32LE(position, (uint32_t) std::min((size_t) block_size, length - i * block_size));
+        WriteUInt32LE(position + 4, (uint32_t) blocks[i].size());
+        WriteUInt32LE(position + 8, checksums[i]);
+        position += block_entry_length;
+    }
+
+    for(const std::vector<uint8_t>& block : blocks) {
+        memcpy(position, block.data(), block.size());
+        position += block.size();
+    }
+}
+
+const char* BlockFrame::Measure(const uint8_t* data, size_t length, size_t* message_length) {
+    if(length < header_length)
+        return "Compressed frame ends before it's header does";
+
+    size_t block_count = ReadUInt32LE(data + 6);
+
+    if(block_count > (length - header_length) / block_entry_length)
+        return "Compressed frame ends before it's block table does";
+
+    size_t remaining = length - header_length - block_count * block_entry_length;
+    size_t total = 0;
+
+    for(size_t i = 0; i < block_count; i++) {
+        const uint8_t* entry = data + header_length + i * block_entry_length;
+        size_t contents_length = ReadUInt32LE(entry);
+        size_t stored_length = ReadUInt32LE(entry + 4);
+
+        if(stored_length > remaining || stored_length > contents_length || contents_length > stored_length * max_ratio)
+            return "Compressed frame has a block of invalid length";
+
+        remaining -= stored_length;
+        total += contents_length;
+    }
+
+    if(remaining != 0 || total != ReadUInt32LE(data + 2))
+        return "Compressed frame length doesn't match it's blocks";
+
+    *message_length = total;
+    return nullptr;
+}
+
+const char* BlockFrame::Read(const uint8_t* data, size_t length, uint8_t* output, size_t output_length) {
+    // Frames are checked by `Measure()` first, but blocks are still kept within the input in case it changed since
+    if(length < header_length || ReadUInt32LE(data + 6) > (length - header_length) / block_entry_length)
+        return "Compressed frame ends before it's block table does";
+
+    size_t block_count = ReadUInt32LE(data + 6);
+    const uint8_t* table = data + header_length;
+    std::vector<size_t> input_offsets(block_count);
+    std::vector<size_t> output_offsets(block_count);
+    std::vector<const char*> errors(block_count, nullptr);
+    size_t input_offset = header_length + block_count * block_entry_length;
+    size_t output_offset = 0;
+
+    for(size_t i = 0; i < block_count; i++) {
+        input_offsets[i] = input_offset;
+        output_offsets[i] = output_offset;
+        output_offset += ReadUInt32LE(table + i * block_entry_length);
+        input_offset += ReadUInt32LE(table + i * block_entry_length + 4);
+
+        if(input_offset > length)
+            return "Compressed frame ends before it's blocks do";
+    }
+
+    if(output_offset != output_length)
+        return "Compressed frame length doesn't match it's blocks";
+
+    pool->Run(block_count, [&](size_t i) {
+        const uint8_t* entry = table + i * block_entry_length;
+        size_t contents_length = ReadUInt32LE(entry);
+        size_t stored_length = ReadUInt32LE(entry + 4);
+        uint8_t* contents = output + output_offsets[i];
+
+        if(stored_length == contents_length) {
+            memcpy(contents, data + input_offsets[i], contents_length);
+        } else if(!BlockCodec::Decompress(data + input_offsets[i], stored_length, contents, contents_length)) {
+            errors[i] = "Compressed frame has an invalid block";
+            return;
+        }
+
+        if(BlockCodec::Checksum(contents, contents_length) != ReadUInt32LE(entry + 8))
+            errors[i] = "Compressed frame has a block which doesn't match it's checksum";
+    });
+
+    for(const char* error : errors)
+        if(error != nullptr)
+            return error;
+
+    return nullptr;
+}
@@ -0,0 +1,37 @@
+#ifndef BLOCK_FRAME_H_
+#define BLOCK_FRAME_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/**
+ * Frame of independently compressed blocks holding an encoded message. It starts with the format header
+ * followed by `BO::Format::Compressed`, the length of the message and the amount of blocks, as unsigned
+ * 32-bit integers. Then comes the length of each block before and after compression and the checksum of
+ * it's contents, followed by the blocks. Blocks which don't get smaller are kept as they are. Blocks are
+ * compressed and decompressed by a small pool of native threads, so large messages use several cores
+ */
+namespace BlockFrame {
+    /**
+     * True if `length` bytes of `data` start with the header of a compressed frame
+     */
+    bool IsFrame(const uint8_t* data, size_t length);
+    /**
+     * Compress `length` bytes of `data` into a frame of blocks of `block_size` bytes, which replaces the contents of `output`
+     */
+    void Write(const uint8_t* data, size_t length, uint32_t block_size, std::vector<uint8_t>& output);
+    /**
+     * Check the block table of a frame and find out the length of the message it holds. Returns
+     * an error message, or nullptr if the frame is valid
+     */
+    const char* Measure(const uint8_t* data, size_t length, size_t* message_length);
+    /**
+     * Decompress `length` bytes of a frame checked by `Measure()` into `output_length` bytes of `output`, the length
+     * of the message. Returns an error message if the frame doesn't fit in them, a block is not valid or it's contents
+     * don't match their checksum, or nullptr
+     */
+    const char* Read(const uint8_t* data, size_t length, uint8_t* output, size_t output_length);
+}
+
+#endif
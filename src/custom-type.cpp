@@ -1,17 +1,262 @@
 #include <nan.h>
 #include "custom-type.h"
+#include "node-binobject.h"
+
+static const uint32_t first_reserved_type = BO::OneByteString;
+static const uint32_t last_reserved_type = BO::Shared;
+
+CustomType::Table::Table() {
+    for(size_t i = 0; i < 256; i++)
+        types[i] = nullptr;
+}
+
+CustomType::Table::~Table() {
+    for(Entry* entry : entries)
+        delete entry;
+}
+
+CustomType::Entry::Entry(): type(0), matcher(NoMatcher), native(NoNative), byte_length(0) {
+}
+
+CustomType::Entry::~Entry() {
+    property.Reset();
+    processor.Reset();
+    validate.Reset();
+    encode.Reset();
+    decode.Reset();
+    prototype.Reset();
+}
+
+bool CustomType::Table::IsEmpty() {
+    return entries.empty();
+}
+
+bool CustomType::Table::IsObjectsOnly() {
+    return entries.empty() || (objects_only && !strings);
+}
+
+bool CustomType::Table::IsObjectsAndStringsOnly() {
+    return entries.empty() || objects_only;
+}
+
+bool CustomType::Table::ClaimsStrings() {
+    return strings;
+}
+
+CustomType::Entry* CustomType::Table::Find(uint8_t type) {
+    return types[type];
+}
+
+/**
+ * Get `name` function from processor. Throws if it is required and not available
+ */
+static bool GetProcessorFunction(Local<Object> processor, const char* name, bool required, Nan::Persistent<Function>& result) {
+    Local<Value> fn = Nan::Get(processor, Nan::New(name).ToLocalChecked()).ToLocalChecked();
+
+    if(fn->IsFunction()) {
+        result.Reset(Local<Function>::Cast(fn));
+        return true;
+    }
+
+    if(!required)
+        return true;
+
+    Nan::ThrowError(std::string("Processor must have a " + std::string(name) + "() method").c_str());
+    return false;
+}
+
+/**
+ * Get an optional class from the instruction and store it's prototype, so it can be compared
+ * with the prototype of the values later without calling into JavaScript
+ *
+ * 0 - not defined
+ * 1 - defined
+ * 2 - invalid class
+ */
+static uint8_t GetMatcherClass(Local<Object> instruction, const char* name, Local<Value>& prototype) {
+    Local<String> key = Nan::New(name).ToLocalChecked();
+
+    if(!Nan::HasOwnProperty(instruction, key).FromJust())
+        return 0;
+
+    Local<Value> value = Nan::Get(instruction, key).ToLocalChecked();
+
+    if(!value->IsFunction()) {
+        Nan::ThrowError(std::string("Instruction `" + std::string(name) + "` property must be a class").c_str());
+        return 2;
+    }
+
+    prototype = Nan::Get(Local<Function>::Cast(value), Nan::New("prototype").ToLocalChecked()).ToLocalChecked();
+    return 1;
+}
+
+bool CustomType::Table::Compile(Local<Value> instructions, Usage usage) {
+    if(instructions->IsUndefined())
+        return true;
+
+    if(!instructions->IsArray()) {
+        Nan::ThrowError("Instructions must be an array");
+        return false;
+    }
+
+    Local<Array> list = Local<Array>::Cast(instructions);
+    uint32_t length = list->Length();
+
+    for(uint32_t i = 0; i < length; i++) {
+        Local<Value> item = Nan::Get(list, i).ToLocalChecked();
+
+        if(!item->IsObject()) {
+            Nan::ThrowError("Instruction item should be plain objects");
+            return false;
+        }
+
+        Local<Object> instruction = Nan::To<Object>(item).ToLocalChecked();
+        Local<Value> value = Nan::Get(instruction, Nan::New("value").ToLocalChecked()).ToLocalChecked();
+        Local<Value> processor = Nan::Get(instruction, Nan::New("processor").ToLocalChecked()).ToLocalChecked();
+
+        if(!value->IsUint32() || Nan::To<uint32_t>(value).FromJust() > 255) {
+            Nan::ThrowError("Instruction value must be an integer between 0 and 255");
+            return false;
+        }
+
+        uint32_t code = Nan::To<uint32_t>(value).FromJust();
+
+        // Zero starts the format header, and codes after the ones of the first version are taken by newer built-in types
+        if(code == BO::Format::Header || (code >= first_reserved_type && code <= last_reserved_type)) {
+            Nan::ThrowError(std::string("Instruction value " + std::to_string(code) + " is reserved, since 0 and " +
+                std::to_string(first_reserved_type) + " to " + std::to_string(last_reserved_type) + " are used by built-in types").c_str());
+            return false;
+        }
+
+        if(!processor->IsObject()) {
+            Nan::ThrowError("Instruction processor must be an object");
+            return false;
+        }
+
+        Entry* entry = new Entry();
+        entry->type = Nan::To<uint32_t>(value).FromJust();
+        entry->processor.Reset(Nan::To<Object>(processor).ToLocalChecked());
+        entries.push_back(entry);
+
+        Local<Object> object = Nan::New(entry->processor);
+        Local<Value> prototype;
+        NativeProcessor* native = NativeProcessor::From(processor);
+
+        if(native != nullptr) {
+            Entry* source = native->GetEntry();
+
+            entry->native = source->native;
+            entry->byte_length = source->byte_length;
+
+            if(source->native == FixedBufferNative) {
+                entry->matcher = InstanceOfMatcher;
+                entry->property.Reset(Nan::New(source->property));
+                entry->prototype.Reset(Nan::New(source->prototype));
+            } else {
+                strings = true;
+            }
+
+            if(types[entry->type] == nullptr)
+                types[entry->type] = entry;
+            continue;
+        }
+
+        if(!GetProcessorFunction(object, "validate", usage == ForEncoding, entry->validate) ||
+            !GetProcessorFunction(object, "encode", usage == ForEncoding, entry->encode) ||
+            !GetProcessorFunction(object, "decode", usage == ForDecoding, entry->decode))
+            return false;
+
+        uint8_t exact_class = GetMatcherClass(instruction, "exactClass", prototype);
+        uint8_t instance_of = exact_class == 0 ? GetMatcherClass(instruction, "instanceOf", prototype) : 0;
+
+        if(exact_class == 2 || instance_of == 2)
+            return false;
+        else if(exact_class == 1)
+            entry->matcher = ExactClassMatcher;
+        else if(instance_of == 1)
+            entry->matcher = InstanceOfMatcher;
+
+        if(entry->matcher != NoMatcher)
+            entry->prototype.Reset(prototype);
+        else
+            objects_only = false;
+
+        if(types[entry->type] == nullptr)
+            types[entry->type] = entry;
+    }
+
+    return true;
+}
+
+/**
+ * Check value against the class of the instruction by walking
+ * through the prototype chain of it, no JavaScript code is called
+ */
+static bool MatchPrototype(CustomType::Entry* entry, Local<Value> value) {
+    if(!value->IsObject())
+        return false;
+
+    Local<Value> prototype = Nan::New(entry->prototype);
+    Local<Value> current = Local<Object>::Cast(value)->GetPrototype();
+
+    if(entry->matcher == CustomType::ExactClassMatcher)
+        return current->StrictEquals(prototype);
+
+    while(current->IsObject()) {
+        if(current->StrictEquals(prototype))
+            return true;
+        current = Local<Object>::Cast(current)->GetPrototype();
+    }
+
+    return false;
+}
+
+CustomType::Entry* CustomType::Table::Match(Local<Value> value, bool* failed) {
+    *failed = false;
+
+    if(entries.empty() || (objects_only && !value->IsObject() && !(strings && value->IsString())))
+        return nullptr;
+
+    for(Entry* entry : entries) {
+        if(entry->native == HexStringNative || entry->native == UUIDNative) {
+            if(ValidateNative(entry, value))
+                return entry;
+            continue;
+        } else if(entry->matcher != NoMatcher) {
+            if(MatchPrototype(entry, value))
+                return entry;
+            continue;
+        }
+
+        uint8_t validationResult = Validate(entry, value);
+
+        if(validationResult == 2) {
+            *failed = true;
+            return nullptr;
+        } else if(validationResult == 1) {
+            return entry;
+        }
+    }
+
+    return nullptr;
+}
 
 /**
  * 0 - false
  * 1 - true
  * 2 - invalid result
  */
-uint8_t CustomType::Validate(Local<Object> processor, Local<Value> value) {
+uint8_t CustomType::Validate(Entry* entry, Local<Value> value) {
     Local<Value> args[1] = { value };
     Local<Context> context = Nan::GetCurrentContext();
-    Local<Function> validate = Local<Function>::Cast(Nan::Get(processor, Nan::New("validate").ToLocalChecked()).ToLocalChecked());
+    Local<Function> validate = Nan::New(entry->validate);
+
+    MaybeLocal<Value> maybe_result = validate->Call(context, Nan::New(entry->processor), 1, args);
 
-    Local<Value> result = validate->Call(context, processor, 1, args).ToLocalChecked();
+    if(maybe_result.IsEmpty())
+        return 2;
+
+    Local<Value> result = maybe_result.ToLocalChecked();
 
     if(!result->IsBoolean()){
         Nan::ThrowError("Result of validation function must be boolean");
@@ -21,31 +266,339 @@ uint8_t CustomType::Validate(Local<Object> processor, Local<Value> value) {
     return Nan::To<v8::Boolean>(result).ToLocalChecked()->Value() ? 1 : 0;
 }
 
-Local<Value> CustomType::Decode(size_t byte_length, uint8_t* input_buffer, Local<Object> processor) {
+MaybeLocal<Value> CustomType::Decode(Entry* entry, size_t byte_length, uint8_t* input_buffer) {
+    return Decode(entry, Nan::NewBuffer((char*) input_buffer, byte_length).ToLocalChecked());
+}
+
+MaybeLocal<Value> CustomType::Decode(Entry* entry, Local<Object> buffer) {
     Local<Context> context = Nan::GetCurrentContext();
-    Local<Function> decodeFunction = Local<Function>::Cast(Nan::Get(processor, Nan::New("decode").ToLocalChecked()).ToLocalChecked());
-    Local<Object> nodejs_buffer = Nan::NewBuffer((char*) input_buffer, byte_length).ToLocalChecked();
-    Local<Value> args[1] = { nodejs_buffer };
+    Local<Function> decodeFunction = Nan::New(entry->decode);
+    Local<Value> args[1] = { buffer };
 
-    return decodeFunction->Call(context, processor, 1, args).ToLocalChecked();
+    return decodeFunction->Call(context, Nan::New(entry->processor), 1, args);
 }
 
-uint8_t CustomType::Encode(Local<Object> processor, Local<Value> value, uint8_t** result, size_t* byte_length) {
+uint8_t CustomType::Encode(Entry* entry, Local<Value> value, Local<Value>* result) {
     Local<Value> args[1] = { value };
     Local<Context> context = Nan::GetCurrentContext();
-    Local<Function> encodeFunction = Local<Function>::Cast(Nan::Get(processor, Nan::New("encode").ToLocalChecked()).ToLocalChecked());
-    Local<Value> buffer = encodeFunction->Call(context, processor, 1, args).ToLocalChecked();
+    Local<Function> encodeFunction = Nan::New(entry->encode);
+    MaybeLocal<Value> buffer = encodeFunction->Call(context, Nan::New(entry->processor), 1, args);
+
+    if(buffer.IsEmpty())
+        return 1;
 
-    if(!buffer->IsTypedArray()){
+    *result = buffer.ToLocalChecked();
+
+    if(!(*result)->IsTypedArray()){
         Nan::ThrowError("Result from encoder method must be an typed array");
         return 1;
     }
 
-    *byte_length = node::Buffer::Length(buffer);
+    return 0;
+}
+
+/**
+ * Only lowercase digits are accepted, since that is what
+ * the decoder gives back and strings must not change
+ */
+static int8_t HexDigit(uint16_t ch) {
+    if(ch >= '0' && ch <= '9')
+        return ch - '0';
+    else if(ch >= 'a' && ch <= 'f')
+        return ch - 'a' + 10;
+    return -1;
+}
+
+static const char hex_digits[] = "0123456789abcdef";
+
+/**
+ * Parse hexadecimal characters of `input` into `output`. Dashes are skipped at the
+ * positions listed in `dashes`. Returns false if any character is not expected
+ */
+static bool ParseHex(const uint16_t* input, size_t length, uint8_t* output, const size_t* dashes, size_t dashes_length) {
+    size_t dash = 0;
+    size_t offset = 0;
+
+    for(size_t i = 0; i < length;) {
+        if(dash < dashes_length && dashes[dash] == i) {
+            if(input[i] != '-')
+                return false;
+            dash++;
+            i++;
+            continue;
+        }
 
-    size_t buffer_length = *byte_length;
-    *result = (uint8_t*)malloc(buffer_length);
+        int8_t high = HexDigit(input[i]);
+        int8_t low = HexDigit(input[i + 1]);
 
-    memcpy(*result, node::Buffer::Data(buffer), buffer_length);
+        if(high < 0 || low < 0)
+            return false;
+
+        output[offset++] = (high << 4) | low;
+        i += 2;
+    }
+
+    return true;
+}
+
+static const size_t uuid_dashes[] = { 8, 13, 18, 23 };
+
+/**
+ * Characters of a string claimed by a built-in processor. UUIDs and most hexadecimal strings fit in
+ * `inline_characters`, so they are read without allocating memory
+ */
+struct NativeString {
+    uint16_t inline_characters[64];
+    std::vector<uint16_t> heap_characters;
+    const uint16_t* characters = nullptr;
+    size_t length = 0;
+};
+
+/**
+ * Read string characters into `result` and check if it has the expected length for the processor
+ */
+static bool ReadNativeString(CustomType::Entry* entry, Local<Value> value, NativeString* result) {
+    if(!value->IsString())
+        return false;
+
+    Local<String> string = Local<String>::Cast(value);
+    size_t length = string->Length();
+    uint16_t* characters = result->inline_characters;
+
+    if(entry->native == CustomType::UUIDNative) {
+        if(length != 36)
+            return false;
+    } else if(length == 0 || length % 2 != 0 || (entry->byte_length > 0 && length != entry->byte_length * 2)) {
+        return false;
+    }
+
+    if(length > sizeof(result->inline_characters) / sizeof(uint16_t)) {
+        result->heap_characters.resize(length);
+        characters = result->heap_characters.data();
+    }
+
+    string->Write(Isolate::GetCurrent(), characters, 0, (int) length, String::NO_NULL_TERMINATION);
+    result->characters = characters;
+    result->length = length;
+    return true;
+}
+
+bool CustomType::ValidateNative(Entry* entry, Local<Value> value) {
+    if(entry->native == FixedBufferNative) {
+        if(!value->IsObject())
+            return false;
+
+        Local<Value> buffer = Nan::Get(Local<Object>::Cast(value), Nan::New(entry->property)).ToLocalChecked();
+        return buffer->IsTypedArray() && node::Buffer::Length(buffer) == entry->byte_length;
+    }
+
+    NativeString string;
+    uint8_t bytes[16];
+
+    if(!ReadNativeString(entry, value, &string))
+        return false;
+
+    if(entry->native == UUIDNative)
+        return ParseHex(string.characters, string.length, bytes, uuid_dashes, 4);
+
+    for(size_t i = 0; i < string.length; i++)
+        if(HexDigit(string.characters[i]) < 0)
+            return false;
+
+    return true;
+}
+
+uint8_t CustomType::EncodeNative(Entry* entry, Local<Value> value, std::vector<uint8_t>& scratch, const uint8_t** result, size_t* byte_length) {
+    if(entry->native == FixedBufferNative) {
+        if(!value->IsObject()) {
+            Nan::ThrowError("Expected an object");
+            return 1;
+        }
+
+        Local<Value> buffer = Nan::Get(Local<Object>::Cast(value), Nan::New(entry->property)).ToLocalChecked();
+
+        if(!buffer->IsTypedArray() || node::Buffer::Length(buffer) != entry->byte_length) {
+            Nan::ThrowError(std::string("Expected property to be a buffer of " + std::to_string(entry->byte_length) + " bytes").c_str());
+            return 1;
+        }
+
+        *result = (uint8_t*) node::Buffer::Data(buffer);
+        *byte_length = entry->byte_length;
+        return 0;
+    }
+
+    NativeString string;
+
+    if(!ReadNativeString(entry, value, &string)) {
+        Nan::ThrowError("Invalid string for built-in processor");
+        return 1;
+    }
+
+    bool valid;
+
+    if(entry->native == UUIDNative) {
+        *byte_length = 16;
+        scratch.resize(16);
+        valid = ParseHex(string.characters, string.length, scratch.data(), uuid_dashes, 4);
+    } else {
+        *byte_length = string.length / 2;
+        scratch.resize(*byte_length);
+        valid = ParseHex(string.characters, string.length, scratch.data(), nullptr, 0);
+    }
+
+    if(!valid) {
+        Nan::ThrowError("Invalid string for built-in processor");
+        return 1;
+    }
+
+    *result = scratch.data();
     return 0;
-}
\ No newline at end of file
+}
+
+Local<Value> CustomType::DecodeNative(Entry* entry, size_t byte_length, const uint8_t* input_buffer) {
+    if(entry->byte_length > 0 && byte_length != entry->byte_length) {
+        Nan::ThrowError(std::string("Expected " + std::to_string(entry->byte_length) + " bytes for custom type " + std::to_string(entry->type)).c_str());
+        return Nan::Undefined();
+    }
+
+    if(entry->native == FixedBufferNative) {
+        Local<Context> context = Nan::GetCurrentContext();
+        Local<Object> result = Nan::New<Object>();
+
+        result->SetPrototype(context, Nan::New(entry->prototype)).FromJust();
+        Nan::Set(result, Nan::New(entry->property), Nan::CopyBuffer((const char*) input_buffer, byte_length).ToLocalChecked());
+        return result;
+    }
+
+    size_t offset = 0;
+    std::vector<uint8_t> characters(byte_length * 2 + 4);
+
+    for(size_t i = 0; i < byte_length; i++) {
+        if(entry->native == UUIDNative && (i == 4 || i == 6 || i == 8 || i == 10))
+            characters[offset++] = '-';
+
+        characters[offset++] = hex_digits[input_buffer[i] >> 4];
+        characters[offset++] = hex_digits[input_buffer[i] & 0x0f];
+    }
+
+    return Nan::NewOneByteString(characters.data(), offset).ToLocalChecked();
+}
+
+Nan::Persistent<FunctionTemplate> CustomType::NativeProcessor::tpl;
+
+CustomType::NativeProcessor::NativeProcessor() {
+}
+
+CustomType::NativeProcessor::~NativeProcessor() {
+}
+
+CustomType::Entry* CustomType::NativeProcessor::GetEntry() {
+    return &entry;
+}
+
+CustomType::NativeProcessor* CustomType::NativeProcessor::From(Local<Value> value) {
+    if(!value->IsObject() || !Nan::New(tpl)->HasInstance(value))
+        return nullptr;
+
+    return Nan::ObjectWrap::Unwrap<NativeProcessor>(Local<Object>::Cast(value));
+}
+
+void CustomType::NativeProcessor::Init(Local<Object> exports) {
+    Local<FunctionTemplate> t = Nan::New<FunctionTemplate>(New);
+    t->SetClassName(Nan::New("NativeProcessor").ToLocalChecked());
+    t->InstanceTemplate()->SetInternalFieldCount(1);
+
+    Nan::SetPrototypeMethod(t, "validate", Validate);
+    Nan::SetPrototypeMethod(t, "encode", Encode);
+    Nan::SetPrototypeMethod(t, "decode", Decode);
+
+    tpl.Reset(t);
+    Nan::Set(exports, Nan::New("NativeProcessor").ToLocalChecked(), Nan::GetFunction(t).ToLocalChecked());
+}
+
+/**
+ * new NativeProcessor({ type: 'fixed', class: ObjectID, byteLength: 12, property: 'id' })
+ * new NativeProcessor({ type: 'hex', byteLength: 12 })
+ * new NativeProcessor({ type: 'uuid' })
+ */
+NAN_METHOD(CustomType::NativeProcessor::New) {
+    Local<Value> value = info[0];
+
+    if(!value->IsObject()) {
+        Nan::ThrowError("First argument must be an object");
+        return;
+    }
+
+    Local<Object> options = Local<Object>::Cast(value);
+    Local<Value> type = Nan::Get(options, Nan::New("type").ToLocalChecked()).ToLocalChecked();
+    Local<Value> byte_length = Nan::Get(options, Nan::New("byteLength").ToLocalChecked()).ToLocalChecked();
+    std::string name = *Nan::Utf8String(type);
+
+    if(!byte_length->IsUndefined() && !byte_length->IsUint32()) {
+        Nan::ThrowError("`byteLength` must be a positive integer");
+        return;
+    }
+
+    NativeProcessor* processor = new NativeProcessor();
+    Entry* entry = &processor->entry;
+
+    processor->Wrap(info.This());
+    entry->byte_length = byte_length->IsUndefined() ? 0 : Nan::To<uint32_t>(byte_length).FromJust();
+
+    if(name == "fixed") {
+        Local<Value> class_value = Nan::Get(options, Nan::New("class").ToLocalChecked()).ToLocalChecked();
+        Local<Value> property = Nan::Get(options, Nan::New("property").ToLocalChecked()).ToLocalChecked();
+
+        if(!class_value->IsFunction()) {
+            Nan::ThrowError("`class` must be a class");
+            return;
+        }
+        if(entry->byte_length == 0) {
+            Nan::ThrowError("`byteLength` is required for fixed processors");
+            return;
+        }
+
+        entry->native = FixedBufferNative;
+        entry->property.Reset(property->IsString() ? Local<String>::Cast(property) : Nan::New("id").ToLocalChecked());
+        entry->prototype.Reset(Nan::Get(Local<Object>::Cast(class_value), Nan::New("prototype").ToLocalChecked()).ToLocalChecked());
+    } else if(name == "hex") {
+        entry->native = HexStringNative;
+    } else if(name == "uuid") {
+        entry->native = UUIDNative;
+        entry->byte_length = 16;
+    } else {
+        Nan::ThrowError("`type` must be one of: fixed, hex, uuid");
+        return;
+    }
+
+    info.GetReturnValue().Set(info.This());
+}
+
+NAN_METHOD(CustomType::NativeProcessor::Validate) {
+    NativeProcessor* processor = Nan::ObjectWrap::Unwrap<NativeProcessor>(info.Holder());
+
+    info.GetReturnValue().Set(ValidateNative(&processor->entry, info[0]));
+}
+
+NAN_METHOD(CustomType::NativeProcessor::Encode) {
+    NativeProcessor* processor = Nan::ObjectWrap::Unwrap<NativeProcessor>(info.Holder());
+    std::vector<uint8_t> scratch;
+    const uint8_t* result;
+    size_t byte_length;
+
+    if(EncodeNative(&processor->entry, info[0], scratch, &result, &byte_length) != 0)
+        return;
+
+    info.GetReturnValue().Set(Nan::CopyBuffer((const char*) result, byte_length).ToLocalChecked());
+}
+
+NAN_METHOD(CustomType::NativeProcessor::Decode) {
+    NativeProcessor* processor = Nan::ObjectWrap::Unwrap<NativeProcessor>(info.Holder());
+
+    if(!info[0]->IsTypedArray()) {
+        Nan::ThrowError("First argument must be a buffer");
+        return;
+    }
+
+    info.GetReturnValue().Set(DecodeNative(&processor->entry, node::Buffer::Length(info[0]), (const uint8_t*) node::Buffer::Data(info[0])));
+}
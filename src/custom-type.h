@@ -1,5 +1,6 @@
 #include <stdint.h>
-#include <v8.h>
+#include <vector>
+#include <nan.h>
 
 #ifndef CUSTOM_TYPE_H_
 #define CUSTOM_TYPE_H_
@@ -7,13 +8,157 @@
 using namespace v8;
 
 namespace CustomType {
-    uint8_t Validate(Local<Object> processor, Local<Value> value);
-    uint8_t Encode(Local<Object> processor, Local<Value> value, uint8_t** result, size_t* byte_length);
+    enum Usage {
+        ForEncoding = 1,
+        ForDecoding = 2
+    };
+
+    enum Matcher {
+        /**
+         * Only the processor `validate()` function can tell if the value belongs to this type
+         */
+        NoMatcher = 0,
+        /**
+         * Value prototype must be exactly `exactClass.prototype`
+         */
+        ExactClassMatcher = 1,
+        /**
+         * `exactClass.prototype` or `instanceOf.prototype` must be in the value prototype chain
+         */
+        InstanceOfMatcher = 2
+    };
+
+    enum Native {
+        /**
+         * Processor is implemented in JavaScript
+         */
+        NoNative = 0,
+        /**
+         * Instances of a class which keep exactly `byte_length` bytes in a buffer property
+         */
+        FixedBufferNative = 1,
+        /**
+         * Hexadecimal strings, encoded as the bytes they represent
+         */
+        HexStringNative = 2,
+        /**
+         * Canonical UUID strings, encoded as 16 bytes
+         */
+        UUIDNative = 3
+    };
+
+    /**
+     * Instruction item compiled into native handles, so processor
+     * functions and type codes are not looked up for every value
+     */
+    struct Entry {
+        uint8_t type;
+        Matcher matcher;
+        Native native;
+        /**
+         * Expected length of the encoded value for built-in processors. Zero means any length
+         */
+        size_t byte_length;
+        /**
+         * Buffer property of `FixedBufferNative` instances
+         */
+        Nan::Persistent<String> property;
+        Nan::Persistent<Object> processor;
+        Nan::Persistent<Function> validate;
+        Nan::Persistent<Function> encode;
+        Nan::Persistent<Function> decode;
+        Nan::Persistent<Value> prototype;
+        Entry();
+        ~Entry();
+    };
+
+    class Table {
+    private:
+        std::vector<Entry*> entries;
+        Entry* types[256];
+        /**
+         * True when every entry has a native matcher, so primitive values other
+         * than the strings claimed by built-in processors never need to be checked
+         */
+        bool objects_only = true;
+        /**
+         * True when a built-in processor claims strings
+         */
+        bool strings = false;
+    public:
+        Table();
+        ~Table();
+        /**
+         * Compile an instructions array into this table. Throws a JavaScript
+         * exception and returns false if `instructions` is not valid
+         */
+        bool Compile(Local<Value> instructions, Usage usage);
+        /**
+         * Find the entry whose processor claims `value`. Returns nullptr if no entry
+         * matches. If a JavaScript exception was thrown `failed` is set to true
+         */
+        Entry* Match(Local<Value> value, bool* failed);
+        Entry* Find(uint8_t type);
+        bool IsEmpty();
+        /**
+         * True when values other than objects never match an entry of this table
+         */
+        bool IsObjectsOnly();
+        /**
+         * True when values other than objects and strings never match an entry of this table, so numbers are never claimed
+         */
+        bool IsObjectsAndStringsOnly();
+        bool ClaimsStrings();
+    };
+
+    /**
+     * Built-in processor which encodes and decodes values without calling into JavaScript. It
+     * can be used as the `processor` of an instruction just like any other processor
+     */
+    class NativeProcessor : public Nan::ObjectWrap {
+    private:
+        Entry entry;
+        NativeProcessor();
+        ~NativeProcessor();
+        static Nan::Persistent<FunctionTemplate> tpl;
+        static NAN_METHOD(New);
+        static NAN_METHOD(Validate);
+        static NAN_METHOD(Encode);
+        static NAN_METHOD(Decode);
+    public:
+        static void Init(Local<Object> exports);
+        /**
+         * Get processor behind `value` or nullptr if it is not a built-in processor
+         */
+        static NativeProcessor* From(Local<Value> value);
+        Entry* GetEntry();
+    };
+
+    uint8_t Validate(Entry* entry, Local<Value> value);
+    /**
+     * Call processor `encode()` function. `result` is the typed array returned by it
+     */
+    uint8_t Encode(Entry* entry, Local<Value> value, Local<Value>* result);
     /**
      * Decode custom type using a function available in processor. Attention to `input_buffer` argument, it
-     * should be previously allocated so this function can take ownership of it's deallocation
+     * should be previously allocated so this function can take ownership of it's deallocation. Result is
+     * empty if the function threw
+     */
+    MaybeLocal<Value> Decode(Entry* entry, size_t byte_length, uint8_t* input_buffer);
+    MaybeLocal<Value> Decode(Entry* entry, Local<Object> buffer);
+    /**
+     * Check value against a built-in processor
+     */
+    bool ValidateNative(Entry* entry, Local<Value> value);
+    /**
+     * Encode value using a built-in processor. `result` points either to memory owned
+     * by `value` or to `scratch`. Returns 1 and throws if value could not be encoded
+     */
+    uint8_t EncodeNative(Entry* entry, Local<Value> value, std::vector<uint8_t>& scratch, const uint8_t** result, size_t* byte_length);
+    /**
+     * Decode value using a built-in processor. `input_buffer` is copied if needed
      */
-    Local<Value> Decode(size_t byte_length, uint8_t* input_buffer, Local<Object> processor);
+    Local<Value> DecodeNative(Entry* entry, size_t byte_length, const uint8_t* input_buffer);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,55 @@
+#include "key-cache.h"
+
+KeyCache::KeyCache() {
+    entries = new Entry[size];
+}
+
+KeyCache::~KeyCache() {
+    Clear();
+    delete[] entries;
+}
+
+void KeyCache::Clear() {
+    for(size_t i = 0; i < size; i++) {
+        entries[i].value.Reset();
+        entries[i].bytes.clear();
+    }
+}
+
+static uint32_t Hash(const uint8_t* data, size_t length) {
+    uint32_t hash = 2166136261u;
+
+    for(size_t i = 0; i < length; i++)
+        hash = (hash ^ data[i]) * 16777619u;
+
+    return hash;
+}
+
+static Local<String> NewKey(const uint8_t* data, size_t length, bool ascii) {
+    Isolate* isolate = Isolate::GetCurrent();
+
+    if(ascii)
+        return String::NewFromOneByte(isolate, data, NewStringType::kInternalized, length).ToLocalChecked();
+
+    return String::NewFromUtf8(isolate, (const char*) data, NewStringType::kInternalized, length).ToLocalChecked();
+}
+
+Local<String> KeyCache::Get(const uint8_t* data, size_t length, bool ascii) {
+    if(length > max_key_length)
+        return NewKey(data, length, ascii);
+
+    uint32_t hash = Hash(data, length);
+    Entry& entry = entries[hash & (size - 1)];
+
+    if(!entry.value.IsEmpty() && entry.hash == hash && entry.bytes.size() == length &&
+        memcmp(entry.bytes.data(), data, length) == 0)
+        return Nan::New(entry.value);
+
+    Local<String> key = NewKey(data, length, ascii);
+
+    entry.hash = hash;
+    entry.bytes.assign((const char*) data, length);
+    entry.value.Reset(key);
+
+    return key;
+}
@@ -0,0 +1,37 @@
+#ifndef KEY_CACHE_H_
+#define KEY_CACHE_H_
+
+#include <nan.h>
+#include <stdint.h>
+#include <string>
+
+using namespace v8;
+
+/**
+ * Direct-mapped cache of internalized object keys indexed by their bytes, so repeated
+ * property names cost one hash lookup instead of a new string each
+ */
+class KeyCache {
+private:
+    struct Entry {
+        uint32_t hash;
+        std::string bytes;
+        Nan::Persistent<String> value;
+    };
+    static const size_t size = 512;
+    /**
+     * Longer keys are not cached
+     */
+    static const size_t max_key_length = 64;
+    Entry* entries;
+public:
+    KeyCache();
+    ~KeyCache();
+    /**
+     * Get internalized string for UTF-8 `data`, creating it if needed
+     */
+    Local<String> Get(const uint8_t* data, size_t length, bool ascii);
+    void Clear();
+};
+
+#endif
@@ -1,10 +1,22 @@
 #include "node-encoder.h"
 #include "node-decoder.h"
+#include "node-stream-decoder.h"
+#include "node-stream-encoder.h"
+#include "node-record-writer.h"
+#include "node-record-reader.h"
+#include "custom-type.h"
+#include "object-schema.h"
 #include <nan.h>
 
 void Init(Local<Object> exports) {
     Encoder::Init(exports);
     Decoder::Init(exports);
+    StreamDecoder::Init(exports);
+    StreamEncoder::Init(exports);
+    RecordWriter::Init(exports);
+    RecordReader::Init(exports);
+    CustomType::NativeProcessor::Init(exports);
+    ObjectSchema::Init(exports);
 }
 
 NODE_MODULE(binobject, Init);
\ No newline at end of file
@@ -1,6 +1,9 @@
 #ifndef NODE_BINOBJECT_H_
 #define NODE_BINOBJECT_H_
 
+#include <stdint.h>
+#include <stddef.h>
+
 namespace BO {
     enum PropertyType {
         Object = 1,
@@ -22,8 +25,120 @@ namespace BO {
         Undefined = 17,
         Map = 18,
         Buffer = 19,
-        ArrayBuffer = 20
+        ArrayBuffer = 20,
+        /**
+         * Latin-1 string, one byte per character. `String` is UTF-8
+         */
+        OneByteString = 21,
+        /**
+         * Array of numbers which all fit the same number type. It's followed by that type and the
+         * length of the array, then the values are laid out one after the other without types
+         */
+        PackedArray = 22,
+        /**
+         * Typed array or `DataView`. It's followed by the element kind, the byte length and the amount of padding
+         * bytes which come before the contents, so they start at a multiple of the element size
+         */
+        TypedArray = 23,
+        /**
+         * Integer written as zigzag LEB128. Used for safe integers which don't fit in 32 bits
+         */
+        VarInt = 24,
+        /**
+         * Object, array or map preceded by the byte length of it's contents as an unsigned 32 bit
+         * integer, so readers can step over it without looking at what it contains
+         */
+        Sized = 25,
+        /**
+         * Record of a schema known by the reader. It's followed by the schema id, the byte length
+         * of the record as an unsigned 32 bit integer and then the fields, without keys nor types
+         */
+        Record = 26,
+        /**
+         * Array of objects which all have the same keys, written as one column per key. It's followed by the
+         * amount of rows, the amount of keys, the keys without types and then each column as an array value,
+         * which is packed for numbers and a `BO::Dictionary` for repeated strings
+         */
+        Columns = 27,
+        /**
+         * Array of strings written as the list of distinct strings followed by the index of each
+         * item in that list, as a packed array. It's followed by the amount of distinct strings
+         */
+        Dictionary = 28,
+        /**
+         * Object, array, map or string written earlier in the same `BO::Shared` value. It's followed
+         * by the number of that value, as objects and long strings are numbered in the order they are read
+         */
+        Reference = 29,
+        /**
+         * Value whose objects, arrays, maps and strings can be referenced by `BO::Reference`. It's followed by
+         * the minimum length of the strings which are numbered and then the value
+         */
+        Shared = 30
     };
+    namespace ElementKind {
+        enum ElementKind {
+            Int8 = 1,
+            UInt8 = 2,
+            UInt8Clamped = 3,
+            Int16 = 4,
+            UInt16 = 5,
+            Int32 = 6,
+            UInt32 = 7,
+            Float32 = 8,
+            Float64 = 9,
+            BigInt64 = 10,
+            BigUInt64 = 11,
+            DataView = 12
+        };
+
+        /**
+         * Size in bytes of each element of `kind`, or zero if it's not a valid kind
+         */
+        inline size_t ElementSize(uint8_t kind) {
+            switch(kind) {
+                case Int8:
+                case UInt8:
+                case UInt8Clamped:
+                case DataView:
+                    return 1;
+                case Int16:
+                case UInt16:
+                    return 2;
+                case Int32:
+                case UInt32:
+                case Float32:
+                    return 4;
+                case Float64:
+                case BigInt64:
+                case BigUInt64:
+                    return 8;
+            }
+
+            return 0;
+        }
+    }
+    namespace Format {
+        enum Format {
+            /**
+             * Lengths are written as tagged numbers
+             */
+            V1 = 1,
+            /**
+             * Lengths are LEB128 without type, integers are zigzag LEB128 and fractional
+             * numbers are floats when they don't change by being stored as one
+             */
+            V2 = 2,
+            /**
+             * Frame of compressed blocks which hold a message of any other format. It's never given to the `format` option
+             */
+            Compressed = 3
+        };
+        /**
+         * Messages of any version after the first start with this byte followed by the version
+         */
+        static const uint8_t Header = 0;
+    }
     namespace NumberErrors {
         enum NumberErrors {
             Ok = 1,
@@ -1,6 +1,12 @@
 #include "custom-type.h"
 #include "node-decoder.h"
 #include "node-binobject.h"
+#include "node-options.h"
+#include "ascii.h"
+#include "utf8.h"
+#include "number-scan.h"
+#include "varint.h"
+#include "block-frame.h"
 
 #include <nan.h>
 
@@ -8,12 +14,41 @@ using namespace v8;
 
 Nan::Persistent<Function> Decoder::constructor;
 
-Decoder::Decoder(size_t byte_length, uint8_t* buffer) {
+Decoder::Decoder(size_t byte_length, uint8_t* buffer): buffer(buffer), byte_length(byte_length), source_offset(0), format(BO::Format::V1) {
     mff_deserializer_init(&decoder, buffer, byte_length);
 }
 
 Decoder::~Decoder() {
     mff_deserializer_destroy(decoder);
+    source.Reset();
+}
+
+size_t Decoder::Offset() {
+    return decoder->offset;
+}
+
+const uint8_t* Decoder::Consume(size_t length) {
+    size_t offset = Offset();
+
+    if(offset > byte_length || length > byte_length - offset) {
+        Nan::ThrowError("Exceeded maximum size of buffer, can't go any further");
+        return nullptr;
+    }
+
+    decoder->offset = offset + length;
+    return buffer + offset;
+}
+
+Local<Object> Decoder::Slice(size_t offset, size_t length) {
+    return node::Buffer::New(Isolate::GetCurrent(), Nan::New(source), source_offset + offset, length).ToLocalChecked();
+}
+
+Local<ArrayBuffer> Decoder::GetSource() {
+    return Nan::New(source);
+}
+
+size_t Decoder::SourceOffset(size_t offset) {
+    return source_offset + offset;
 }
 
 uint8_t Decoder::ReadUInt8() {
@@ -64,6 +99,114 @@ float Decoder::ReadFloatLE() {
     return n;
 }
 
+int64_t Decoder::ReadInt64LE() {
+    int64_t n = 0;
+    const uint8_t* data = Consume(sizeof(n));
+
+    if(data != nullptr)
+        memcpy(&n, data, sizeof(n));
+    return n;
+}
+
+uint64_t Decoder::ReadUInt64LE() {
+    uint64_t n = 0;
+    const uint8_t* data = Consume(sizeof(n));
+
+    if(data != nullptr)
+        memcpy(&n, data, sizeof(n));
+    return n;
+}
+
+uint64_t Decoder::ReadVarint() {
+    uint64_t n = 0;
+    size_t offset = Offset();
+    size_t length = offset < byte_length ? Varint::Decode(buffer + offset, byte_length - offset, &n) : 0;
+
+    if(length == 0) {
+        Nan::ThrowError("Got invalid variable length integer");
+        return 0;
+    }
+
+    Consume(length);
+    return n;
+}
+
+bool Decoder::IsInt64AsBigInt() {
+    return int64 == Int64Mode::BigInt;
+}
+
+bool Decoder::IsReadingColumnsAsArrays() {
+    return columns == ColumnsMode::Arrays;
+}
+
+uint8_t Decoder::GetFormat() {
+    return format;
+}
+
+void Decoder::SetFormat(uint8_t value) {
+    format = value;
+}
+
+void Decoder::SetInput(uint8_t* memory, size_t length) {
+    mff_deserializer_destroy(decoder);
+    buffer = memory;
+    byte_length = length;
+    mff_deserializer_init(&decoder, buffer, byte_length);
+}
+
+void Decoder::SetDecompressed(Local<Object> contents) {
+    Local<ArrayBufferView> view = Local<ArrayBufferView>::Cast(contents);
+
+    SetInput((uint8_t*) node::Buffer::Data(contents), node::Buffer::Length(contents));
+    source.Reset(view->Buffer());
+    source_offset = view->ByteOffset();
+    compressed = false;
+#if V8_MAJOR_VERSION >= 8
+    backing_store.reset();
+#endif
+}
+
+bool Decoder::Decompress() {
+    if(!compressed)
+        return true;
+
+    Local<Object> contents;
+    const char* error;
+
+    if(!Nan::NewBuffer(message_length).ToLocal(&contents)) {
+        Nan::ThrowError("Allocation failed");
+        return false;
+    }
+
+    if((error = BlockFrame::Read(buffer, byte_length, (uint8_t*) node::Buffer::Data(contents), message_length)) != nullptr) {
+        Nan::ThrowError(error);
+        return false;
+    }
+
+    SetDecompressed(contents);
+    return true;
+}
+
+void Decoder::Seek(size_t offset) {
+    decoder->offset = offset;
+}
+
+/**
+ * Messages of the first format have no header. A custom type using the header byte as it's code is
+ * still told apart, since it's followed by the type of it's length instead of a format version
+ */
+void Decoder::ReadHeader() {
+    size_t offset = Offset();
+
+    format = BO::Format::V1;
+
+    if(offset + 1 >= byte_length || buffer[offset] != BO::Format::Header || buffer[offset + 1] != BO::Format::V2)
+        return;
+
+    Consume(2);
+    format = BO::Format::V2;
+}
+
 void Decoder::ReadBytes(size_t length, uint8_t* buffer) {
     mff_deserializer_read_buffer(decoder, buffer, length);
 }
@@ -86,6 +229,16 @@ Local<Value> ReadNumberAsValue(Decoder* decoder, uint8_t type) {
             return Nan::New<Number>(decoder->ReadFloatLE());
         case BO::Double:
             return Nan::New<Number>(decoder->ReadDoubleLE());
+        case BO::VarInt:
+            return Nan::New<Number>((double) Varint::UnZigZag(decoder->ReadVarint()));
+        case BO::Int64:
+            if(decoder->IsInt64AsBigInt())
+                return BigInt::New(Isolate::GetCurrent(), decoder->ReadInt64LE());
+            return Nan::New<Number>((double) decoder->ReadInt64LE());
+        case BO::UInt64:
+            if(decoder->IsInt64AsBigInt())
+                return BigInt::NewFromUnsigned(Isolate::GetCurrent(), decoder->ReadUInt64LE());
+            return Nan::New<Number>((double) decoder->ReadUInt64LE());
     }
 
     Nan::ThrowError(
@@ -120,6 +273,18 @@ double ReadNumber(Decoder* decoder) {
         case BO::Float:
             n = decoder->ReadFloatLE();
             break;
+        case BO::Double:
+            n = decoder->ReadDoubleLE();
+            break;
+        case BO::VarInt:
+            n = (double) Varint::UnZigZag(decoder->ReadVarint());
+            break;
+        case BO::Int64:
+            n = (double) decoder->ReadInt64LE();
+            break;
+        case BO::UInt64:
+            n = (double) decoder->ReadUInt64LE();
+            break;
         default:
             Nan::ThrowError("Got invalid integer type");
     }
@@ -127,28 +292,347 @@ double ReadNumber(Decoder* decoder) {
     return n;
 }
 
-void ReadObject(Decoder* decoder, Local<Object> result) {
-    size_t properties_length = ReadNumber(decoder);
+size_t ReadLength(Decoder* decoder) {
+    if(decoder->GetFormat() == BO::Format::V2)
+        return decoder->ReadVarint();
+    return ReadNumber(decoder);
+}
+
+/**
+ * Keys which would not be plain properties of an object template
+ */
+static bool IsSpecialKey(const uint8_t* data, size_t length) {
+    if(length == 9 && memcmp(data, "__proto__", 9) == 0)
+        return true;
+
+    for(size_t i = 0; i < length; i++)
+        if(data[i] < '0' || data[i] > '9')
+            return false;
+
+    return true;
+}
+
+/**
+ * Checks an amount of items read from the input against what's left of it, since each item takes at least `item_size` bytes
+ */
+static bool CheckItemCount(Decoder* decoder, size_t count, size_t item_size) {
+    size_t offset = decoder->Offset();
+
+    if(count > SIZE_MAX / item_size) {
+        Nan::ThrowError("Exceeded maximum size of buffer, can't go any further");
+        return false;
+    }
+
+    if(decoder->Consume(count * item_size) == nullptr)
+        return false;
+
+    decoder->Seek(offset);
+    return true;
+}
+
+Local<Value> ReadObject(Decoder* decoder) {
+    size_t properties_length = ReadLength(decoder);
+
+    // Each property has a key and a value of at least one byte each
+    if(!CheckItemCount(decoder, properties_length, 2))
+        return Nan::Undefined();
+
+    std::vector<Local<Value>>& stack = decoder->GetStack();
+    size_t stack_offset = stack.size();
+    size_t shape_offset = decoder->ShapeOffset();
+    bool cacheable = true;
+    Nan::TryCatch try_catch;
 
     for(size_t i = 0; i < properties_length; i++) {
-        size_t string_length = ReadNumber(decoder);
-        uint8_t buffer[string_length];
+        size_t string_length = ReadLength(decoder);
+        const uint8_t* data = decoder->Consume(string_length);
 
-        decoder->ReadBytes(string_length, buffer);
+        if(data == nullptr)
+            break;
 
-        Local<String> name = Nan::NewOneByteString(buffer, string_length).ToLocalChecked();
-        Local<Value> value = ReadValue(decoder);
+        cacheable = decoder->AddShapeKey(data, string_length) && cacheable;
+
+        stack.push_back(decoder->NewKey(data, string_length));
+        stack.push_back(ReadValue(decoder));
+
+        if(try_catch.HasCaught())
+            break;
+    }
+
+    // The object also takes its keys and values off the stack, so it's made even when reading failed, but not cached
+    cacheable = cacheable && !try_catch.HasCaught();
+
+    Local<Object> object = decoder->NewObject(stack_offset, shape_offset, cacheable, (stack.size() - stack_offset) / 2);
+
+    if(try_catch.HasCaught()) {
+        try_catch.ReThrow();
+        return Nan::Undefined();
+    }
+
+    return object;
+}
+
+std::vector<Local<Value>>& Decoder::GetStack() {
+    return stack;
+}
+
+ReferenceTable& Decoder::GetReferences() {
+    return references;
+}
+
+size_t Decoder::ShapeOffset() {
+    return shape_keys.size();
+}
+
+bool Decoder::AddShapeKey(const uint8_t* data, size_t length) {
+    if(!shape_cache)
+        return false;
+
+    // Shapes store key lengths in 32 bits, so longer keys aren't cached
+    if(length > UINT32_MAX)
+        return false;
+
+    uint32_t key_length = length;
+
+    shape_keys.append((const char*) &key_length, sizeof(key_length));
+    shape_keys.append((const char*) data, length);
+
+    return !IsSpecialKey(data, length);
+}
+
+Local<Object> Decoder::NewObject(size_t stack_offset, size_t shape_offset, bool cacheable, size_t length) {
+    Local<Object> result;
+
+    if(shape_cache) {
+        result = shapes.NewObject(shape_keys.data() + shape_offset, shape_keys.size() - shape_offset, cacheable, stack.data() + stack_offset, length);
+        shape_keys.resize(shape_offset);
+    } else {
+        result = Nan::New<Object>();
+
+        for(size_t i = 0; i < length; i++)
+            Nan::Set(result, stack[stack_offset + i * 2], stack[stack_offset + i * 2 + 1]);
+    }
+
+    stack.resize(stack_offset);
+    return result;
+}
+
+#if V8_MAJOR_VERSION >= 8
+/**
+ * Latin-1 string which reads it's characters straight from the input. The
+ * input memory is kept alive by holding it's backing store
+ */
+class ExternalString : public String::ExternalOneByteStringResource {
+private:
+    std::shared_ptr<BackingStore> backing_store;
+    const char* contents;
+    size_t byte_length;
+public:
+    ExternalString(std::shared_ptr<BackingStore> backing_store, const char* contents, size_t byte_length):
+        backing_store(backing_store), contents(contents), byte_length(byte_length) {}
+    const char* data() const override {
+        return contents;
+    }
+    size_t length() const override {
+        return byte_length;
+    }
+};
+#endif
+
+Local<String> Decoder::NewString(uint8_t type, const uint8_t* data, size_t length) {
+    uint8_t kind = Scanner::AsciiString;
+
+    if(type == BO::OneByteString) {
+        kind = Scanner::Latin1String;
+    } else if(!Ascii::IsASCII(data, length)) {
+        bool valid;
+
+        // Strings are rejected rather than given replacement characters, just like tapes do
+        Utf8::Utf16Length(data, length, &valid);
+
+        if(!valid) {
+            Nan::ThrowError("Got invalid UTF-8 string");
+            return Nan::EmptyString();
+        }
+
+        kind = Scanner::Utf8String;
+    }
+
+    return NewScannedString(kind, data, length);
+}
+
+Local<String> Decoder::NewScannedString(uint8_t kind, const uint8_t* data, size_t length) {
+    Isolate* isolate = Isolate::GetCurrent();
+
+    if(kind == Scanner::Utf8String)
+        return String::NewFromUtf8(isolate, (const char*) data, NewStringType::kNormal, length).ToLocalChecked();
+
+#if V8_MAJOR_VERSION >= 8
+    if(external_strings > 0 && length >= external_strings) {
+        if(!backing_store)
+            backing_store = Nan::New(source)->GetBackingStore();
+
+        ExternalString* resource = new ExternalString(backing_store, (const char*) data, length);
+        return String::NewExternalOneByte(isolate, resource).ToLocalChecked();
+    }
+#endif
+
+    return String::NewFromOneByte(isolate, data, NewStringType::kNormal, length).ToLocalChecked();
+}
+
+/**
+ * Read length and contents of a string of `type`, which is either `BO::String` for UTF-8 or `BO::OneByteString`
+ */
+Local<Value> ReadString(Decoder* decoder, uint8_t type) {
+    size_t string_length = ReadLength(decoder);
+    const uint8_t* data = decoder->Consume(string_length);
+
+    if(data == nullptr)
+        return Nan::EmptyString();
+
+    return decoder->NewString(type, data, string_length);
+}
+
+Local<String> Decoder::NewKey(const uint8_t* data, size_t length) {
+    bool ascii = Ascii::IsASCII(data, length);
 
-        Nan::Set(result, name, value);
+    if(key_cache == KeyCacheLifetime::None) {
+        if(ascii)
+            return String::NewFromOneByte(Isolate::GetCurrent(), data, NewStringType::kInternalized, length).ToLocalChecked();
+        return String::NewFromUtf8(Isolate::GetCurrent(), (const char*) data, NewStringType::kInternalized, length).ToLocalChecked();
     }
+
+    return keys.Get(data, length, ascii);
+}
+
+/**
+ * Read length and UTF-8 contents of an object key
+ */
+Local<Value> ReadKey(Decoder* decoder) {
+    size_t string_length = ReadLength(decoder);
+    const uint8_t* data = decoder->Consume(string_length);
+
+    if(data == nullptr)
+        return Nan::EmptyString();
+
+    return decoder->NewKey(data, string_length);
 }
 
 Local<Value> ReadArray(Decoder* decoder) {
-    double array_length = ReadNumber(decoder);
-    Local<Array> list = Nan::New<Array>(array_length);
+    size_t array_length = ReadLength(decoder);
+
+    // Every item takes at least one byte, so length is checked against the input before it's trusted
+    if(!CheckItemCount(decoder, array_length, 1))
+        return Nan::Undefined();
+
+    std::vector<Local<Value>>& stack = decoder->GetStack();
+    size_t offset = stack.size();
+    Nan::TryCatch try_catch;
+
+    for(size_t i = 0; i < array_length; i++) {
+        stack.push_back(ReadValue(decoder));
+
+        if(try_catch.HasCaught()) {
+            stack.resize(offset);
+            try_catch.ReThrow();
+            return Nan::Undefined();
+        }
+    }
+
+    Local<Array> list = Array::New(Isolate::GetCurrent(), stack.data() + offset, array_length);
+    stack.resize(offset);
+
+    return list;
+}
+
+template<typename T>
+static void UnpackIntegers(const uint8_t* data, size_t length, Local<Value>* output) {
+    Isolate* isolate = Isolate::GetCurrent();
+
+    for(size_t i = 0; i < length; i++) {
+        T n;
+        memcpy(&n, data + i * sizeof(T), sizeof(T));
+        output[i] = Integer::New(isolate, n);
+    }
+}
+
+template<typename T>
+static void UnpackNumbers(const uint8_t* data, size_t length, Local<Value>* output) {
+    Isolate* isolate = Isolate::GetCurrent();
+
+    for(size_t i = 0; i < length; i++) {
+        T n;
+        memcpy(&n, data + i * sizeof(T), sizeof(T));
+        output[i] = Number::New(isolate, n);
+    }
+}
 
-    for(int i = 0; i < array_length; i++)
-        Nan::Set(list, Nan::New<Number>(i), ReadValue(decoder));
+static void UnpackValues(uint8_t type, const uint8_t* data, size_t length, Local<Value>* output) {
+    switch(type) {
+        case BO::UInt8:
+            UnpackIntegers<uint8_t>(data, length, output);
+            break;
+        case BO::Int8:
+            UnpackIntegers<int8_t>(data, length, output);
+            break;
+        case BO::UInt16:
+            UnpackIntegers<uint16_t>(data, length, output);
+            break;
+        case BO::Int16:
+            UnpackIntegers<int16_t>(data, length, output);
+            break;
+        case BO::Int32:
+            UnpackIntegers<int32_t>(data, length, output);
+            break;
+        case BO::Float:
+            UnpackNumbers<float>(data, length, output);
+            break;
+        default:
+            UnpackNumbers<double>(data, length, output);
+    }
+}
+
+/**
+ * Read number type and length of a packed array and give back it's contents. Throws and returns nullptr if it's not valid
+ */
+static const uint8_t* ReadPackedNumbers(Decoder* decoder, uint8_t* type, size_t* length) {
+    *type = decoder->ReadUInt8();
+    size_t width = NumberScan::Width(*type);
+    *length = ReadLength(decoder);
+
+    if(width == 0) {
+        Nan::ThrowError(std::string("Got invalid packed array type: " + std::to_string(*type)).c_str());
+        return nullptr;
+    }
+
+    if(*length > SIZE_MAX / width) {
+        Nan::ThrowError("Exceeded maximum size of buffer, can't go any further");
+        return nullptr;
+    }
+
+    return decoder->Consume(*length * width);
+}
+
+/**
+ * Read array of numbers of the same type. Values are converted in a single pass
+ * and the array is created at once out of them
+ */
+Local<Value> ReadPackedArray(Decoder* decoder) {
+    uint8_t type;
+    size_t array_length;
+    const uint8_t* data = ReadPackedNumbers(decoder, &type, &array_length);
+
+    if(data == nullptr)
+        return Nan::Undefined();
+
+    std::vector<Local<Value>>& stack = decoder->GetStack();
+    size_t offset = stack.size();
+
+    stack.resize(offset + array_length);
+    UnpackValues(type, data, array_length, stack.data() + offset);
+
+    Local<Array> list = Array::New(Isolate::GetCurrent(), stack.data() + offset, array_length);
+    stack.resize(offset);
 
     return list;
 }
@@ -156,128 +640,1361 @@ Local<Value> ReadArray(Decoder* decoder) {
 Local<Value> ReadMapNative(Decoder* decoder) {
     Local<Context> context = Nan::GetCurrentContext();
     Local<Map> map = Map::New(context->GetIsolate());
-    size_t map_length = ReadNumber(decoder);
+    size_t map_length = ReadLength(decoder);
+
+    // Each entry has a key and a value of at least one byte each
+    if(!CheckItemCount(decoder, map_length, 2))
+        return Nan::Undefined();
+
+    Nan::TryCatch try_catch;
 
     for(size_t i = 0; i < map_length; i++) {
         Local<Value> prop = ReadValue(decoder);
-        map = map->Set(context, prop, ReadValue(decoder)).ToLocalChecked();
+        Local<Value> value = ReadValue(decoder);
+
+        if(try_catch.HasCaught()) {
+            try_catch.ReThrow();
+            return Nan::Undefined();
+        }
+
+        map = map->Set(context, prop, value).ToLocalChecked();
     }
 
     return map;
 }
 
-bool CheckCustomType(Decoder* decoder, uint8_t type, Local<Object>& processor) {
-    Local<Object> holder = decoder->GetCurrentHolder();
-    Local<Array> instructions = Local<Array>::Cast(Nan::Get(holder, Nan::New("instructions").ToLocalChecked()).ToLocalChecked());
+bool CheckCustomType(Decoder* decoder, uint8_t type, CustomType::Entry** entry) {
+    *entry = decoder->GetCustomTypes()->Find(type);
+    return *entry != nullptr;
+}
 
-    uint32_t length = instructions->Length();
+Local<Value> ReadBuffer(Decoder* decoder) {
+    size_t byte_length = ReadLength(decoder);
 
-    for(uint32_t i = 0; i < length; i++) {
-        Local<Object> instruction = Nan::To<Object>(Nan::Get(instructions, i).ToLocalChecked()).ToLocalChecked();
-        Local<Uint32> value = Local<Uint32>::Cast(Nan::Get(instruction, Nan::New("value").ToLocalChecked()).ToLocalChecked());
+    if(decoder->IsZeroCopy()) {
+        size_t offset = decoder->Offset();
 
-        if(value->Value() != type)
-            continue;
+        if(decoder->Consume(byte_length) == nullptr)
+            return Nan::Undefined();
 
-        processor = Nan::To<Object>(Nan::Get(instruction, Nan::New("processor").ToLocalChecked()).ToLocalChecked()).ToLocalChecked();
-        return true;
+        return decoder->Slice(offset, byte_length);
     }
 
-    return false;
-}
+    // Length is checked against the input before it's trusted for an allocation
+    const uint8_t* data = decoder->Consume(byte_length);
+
+    if(data == nullptr)
+        return Nan::Undefined();
 
-Local<Object> ReadBuffer(Decoder* decoder) {
-    size_t byte_length = ReadNumber(decoder);
     // Allocation ownership is taken by `Nan::NewBuffer`
     uint8_t* buffer = (uint8_t*) malloc(byte_length);
 
-    decoder->ReadBytes(byte_length, buffer);
+    memcpy(buffer, data, byte_length);
 
     Local<Object> nodejs_buffer = Nan::NewBuffer((char*) buffer, byte_length).ToLocalChecked();
 
     return nodejs_buffer;
 }
 
-Local<Value> ReadValue(Decoder* decoder) {
-    uint8_t type = decoder->ReadUInt8();
+static Local<Value> NewTypedArray(uint8_t kind, Local<ArrayBuffer> array_buffer, size_t byte_offset, size_t length) {
+    switch(kind) {
+        case BO::ElementKind::Int8:
+            return Int8Array::New(array_buffer, byte_offset, length);
+        case BO::ElementKind::UInt8:
+            return Uint8Array::New(array_buffer, byte_offset, length);
+        case BO::ElementKind::UInt8Clamped:
+            return Uint8ClampedArray::New(array_buffer, byte_offset, length);
+        case BO::ElementKind::Int16:
+            return Int16Array::New(array_buffer, byte_offset, length);
+        case BO::ElementKind::UInt16:
+            return Uint16Array::New(array_buffer, byte_offset, length);
+        case BO::ElementKind::Int32:
+            return Int32Array::New(array_buffer, byte_offset, length);
+        case BO::ElementKind::UInt32:
+            return Uint32Array::New(array_buffer, byte_offset, length);
+        case BO::ElementKind::Float32:
+            return Float32Array::New(array_buffer, byte_offset, length);
+        case BO::ElementKind::Float64:
+            return Float64Array::New(array_buffer, byte_offset, length);
+        case BO::ElementKind::BigInt64:
+            return BigInt64Array::New(array_buffer, byte_offset, length);
+        case BO::ElementKind::BigUInt64:
+            return BigUint64Array::New(array_buffer, byte_offset, length);
+    }
 
-    if(type == BO::Buffer) {
-        return ReadBuffer(decoder);
-    } else if(type == BO::Boolean) {
-        bool value = decoder->ReadUInt8() == 0 ? false : true;
-        Local<Boolean> boolean = Nan::New(value);
+    return DataView::New(array_buffer, byte_offset, length);
+}
 
-        return boolean;
-    } else if(type == BO::Undefined) {
+/**
+ * Read typed array or `DataView`. With zero copy it's a view of the input when it's contents
+ * are aligned to the element size in memory, which is the case if the input buffer is too
+ */
+Local<Value> ReadTypedArray(Decoder* decoder) {
+    uint8_t kind = decoder->ReadUInt8();
+    size_t element_size = BO::ElementKind::ElementSize(kind);
+    size_t byte_length = ReadLength(decoder);
+    uint8_t padding = decoder->ReadUInt8();
+
+    if(element_size == 0 || byte_length % element_size != 0) {
+        Nan::ThrowError(std::string("Got invalid typed array of kind " + std::to_string(kind)).c_str());
         return Nan::Undefined();
-    } else if(type == BO::Null) {
-        return Nan::Null();
-    } else if(type == BO::Object){
-        Local<Object> result = Nan::New<Object>();
-        ReadObject(decoder, result);
+    }
 
-        return result;
-    } else if(type == BO::String){
-        uint32_t string_length = ReadNumber(decoder);
-        uint8_t buffer[string_length];
+    if(decoder->Consume(padding) == nullptr)
+        return Nan::Undefined();
 
-        decoder->ReadBytes(string_length, buffer);
+    size_t offset = decoder->Offset();
+    const uint8_t* data = decoder->Consume(byte_length);
 
-        Local<String> string = Nan::NewOneByteString(buffer, string_length).ToLocalChecked();
-        return string;
-    } else if(type == BO::Date) {
-        double date = decoder->ReadDoubleLE();
+    if(data == nullptr)
+        return Nan::Undefined();
 
-        return Nan::New<Date>(date).ToLocalChecked();
-    } else if(type == BO::Array) {
-        return ReadArray(decoder);
-    } else if(type == BO::Map) {
-        return ReadMapNative(decoder);
-    } else {
-        Local<Object> processor;
+    if(decoder->IsZeroCopy() && ((uintptr_t) data) % element_size == 0)
+        return NewTypedArray(kind, decoder->GetSource(), decoder->SourceOffset(offset), byte_length / element_size);
 
-        if(CheckCustomType(decoder, type, processor)) {
-            size_t byte_length = ReadNumber(decoder);
-            uint8_t* buffer = (uint8_t*) malloc(byte_length);
+    Local<ArrayBuffer> array_buffer = ArrayBuffer::New(Isolate::GetCurrent(), byte_length);
+    Local<Value> view = NewTypedArray(kind, array_buffer, 0, byte_length / element_size);
 
-            decoder->ReadBytes(byte_length, buffer);
+    memcpy(node::Buffer::Data(view), data, byte_length);
+    return view;
+}
 
-            return CustomType::Decode(byte_length, buffer, processor);
-        }
-    }
+Local<Value> ReadArrayBuffer(Decoder* decoder) {
+    size_t byte_length = ReadLength(decoder);
+    const uint8_t* data = decoder->Consume(byte_length);
 
-    Local<Value> v = ReadNumberAsValue(decoder, type);
-    // printf("Number type is %d. Number value is %.6f\n", type, v->NumberValue());
-    return v;
-}
+    if(data == nullptr)
+        return Nan::Undefined();
 
-void Decoder::SetCurrentHolder(Local<Object> holder) {
-    current_holder = holder;
-}
+    Local<ArrayBuffer> array_buffer = ArrayBuffer::New(Isolate::GetCurrent(), byte_length);
+    Local<Value> view = Uint8Array::New(array_buffer, 0, byte_length);
 
-Local<Object> Decoder::GetCurrentHolder() {
-    return current_holder;
+    memcpy(node::Buffer::Data(view), data, byte_length);
+    return array_buffer;
 }
 
-NAN_METHOD(Decoder::Decode) {
-    Decoder* decoder = ObjectWrap::Unwrap<Decoder>(info.Holder());
+Local<Value> ReadRecord(Decoder* decoder) {
+    uint8_t id = decoder->ReadUInt8();
+    ObjectSchema* schema = decoder->GetSchemas()->Find(id);
 
-    decoder->SetCurrentHolder(info.Holder());
+    if(schema == nullptr) {
+        Nan::ThrowError(std::string("Got record of unknown schema " + std::to_string(id)).c_str());
+        return Nan::Undefined();
+    }
 
-    Local<Value> result = ReadValue(decoder);
+    size_t byte_length = decoder->ReadUInt32LE();
+    size_t offset = decoder->Offset();
 
-    info.GetReturnValue().Set(result);
-}
+    // Fields are read knowing the whole record is within the input
+    if(decoder->Consume(byte_length) == nullptr)
+        return Nan::Undefined();
 
-NAN_METHOD(Decoder::New) {
-    Local<Object> instance = info.This();
-    Local<Value> value = info[0];
+    decoder->Seek(offset);
 
-    if(value->IsUndefined()){
-        Nan::ThrowError("Expected buffer but got undefined instead");
+    Local<Value> record = schema->Read(decoder);
+
+    if(decoder->Offset() != offset + byte_length) {
+        Nan::ThrowError(std::string("Record doesn't match schema " + std::to_string(id)).c_str());
+        return Nan::Undefined();
+    }
+
+    return record;
+}
+
+/**
+ * Read indices of a `BO::Dictionary` and look up each of them in `strings`
+ */
+static bool ReadDictionaryIndices(Decoder* decoder, const std::vector<Local<Value>>& strings, size_t rows, Local<Value>* output) {
+    uint8_t type;
+    size_t length;
+
+    if(decoder->ReadUInt8() != BO::PackedArray) {
+        Nan::ThrowError("Got invalid dictionary indices");
+        return false;
+    }
+
+    const uint8_t* data = ReadPackedNumbers(decoder, &type, &length);
+
+    if(data == nullptr)
+        return false;
+
+    if(length != rows) {
+        Nan::ThrowError("Got dictionary with wrong amount of items");
+        return false;
+    }
+
+    size_t width = NumberScan::Width(type);
+
+    for(size_t i = 0; i < length; i++) {
+        const uint8_t* item = data + i * width;
+        double index;
+
+        switch(type) {
+            case BO::UInt8:
+                index = *item;
+                break;
+            case BO::UInt16: {
+                uint16_t n;
+                memcpy(&n, item, sizeof(n));
+                index = n;
+                break;
+            }
+            case BO::Int32: {
+                int32_t n;
+                memcpy(&n, item, sizeof(n));
+                index = n;
+                break;
+            }
+            default:
+                // Indices are never negative nor fractional, so encoders don't pick other types
+                index = -1;
+        }
+
+        if(index < 0 || index >= strings.size()) {
+            Nan::ThrowError("Got invalid dictionary index");
+            return false;
+        }
+
+        output[i] = strings[(size_t) index];
+    }
+
+    return true;
+}
+
+/**
+ * Read distinct strings of a `BO::Dictionary`
+ */
+static bool ReadDictionaryStrings(Decoder* decoder, std::vector<Local<Value>>& strings) {
+    size_t count = ReadLength(decoder);
+    size_t offset = decoder->Offset();
+
+    // Each string takes at least one byte, so the amount is checked against the input before it's trusted
+    if(decoder->Consume(count) == nullptr)
+        return false;
+
+    decoder->Seek(offset);
+    strings.resize(count);
+
+    for(size_t i = 0; i < count; i++) {
+        uint8_t type = decoder->ReadUInt8();
+
+        if(type != BO::String && type != BO::OneByteString) {
+            Nan::ThrowError("Got invalid dictionary string");
+            return false;
+        }
+
+        strings[i] = ReadString(decoder, type);
+    }
+
+    return true;
+}
+
+Local<Value> ReadDictionary(Decoder* decoder) {
+    std::vector<Local<Value>> strings;
+
+    if(!ReadDictionaryStrings(decoder, strings))
+        return Nan::Undefined();
+
+    // Amount of items is only known after the strings, so indices are read twice
+    size_t offset = decoder->Offset();
+    uint8_t type;
+    size_t length;
+
+    if(decoder->ReadUInt8() != BO::PackedArray || ReadPackedNumbers(decoder, &type, &length) == nullptr) {
+        Nan::ThrowError("Got invalid dictionary indices");
+        return Nan::Undefined();
+    }
+
+    decoder->Seek(offset);
+
+    std::vector<Local<Value>>& stack = decoder->GetStack();
+    size_t stack_offset = stack.size();
+
+    stack.resize(stack_offset + length);
+
+    if(!ReadDictionaryIndices(decoder, strings, length, stack.data() + stack_offset)) {
+        stack.resize(stack_offset);
+        return Nan::Undefined();
+    }
+
+    Local<Array> list = Array::New(Isolate::GetCurrent(), stack.data() + stack_offset, length);
+    stack.resize(stack_offset);
+
+    return list;
+}
+
+/**
+ * Read column of `rows` cells of a `BO::Columns` value into `output`
+ */
+static bool ReadColumn(Decoder* decoder, size_t rows, Local<Value>* output) {
+    uint8_t type = decoder->ReadUInt8();
+
+    if(type == BO::PackedArray) {
+        uint8_t number_type;
+        size_t length;
+        const uint8_t* data = ReadPackedNumbers(decoder, &number_type, &length);
+
+        if(data == nullptr)
+            return false;
+
+        if(length != rows) {
+            Nan::ThrowError("Got column with wrong amount of rows");
+            return false;
+        }
+
+        UnpackValues(number_type, data, length, output);
+        return true;
+    }
+
+    if(type == BO::Dictionary) {
+        std::vector<Local<Value>> strings;
+
+        return ReadDictionaryStrings(decoder, strings) && ReadDictionaryIndices(decoder, strings, rows, output);
+    }
+
+    if(type == BO::Array) {
+        if(ReadLength(decoder) != rows) {
+            Nan::ThrowError("Got column with wrong amount of rows");
+            return false;
+        }
+
+        for(size_t i = 0; i < rows; i++)
+            output[i] = ReadValue(decoder);
+
+        return true;
+    }
+
+    Nan::ThrowError(std::string("Got invalid column type: " + std::to_string(type)).c_str());
+    return false;
+}
+
+/**
+ * Typed array kind which holds numbers of packed array `type`
+ */
+static uint8_t PackedElementKind(uint8_t type) {
+    switch(type) {
+        case BO::UInt8:
+            return BO::ElementKind::UInt8;
+        case BO::Int8:
+            return BO::ElementKind::Int8;
+        case BO::UInt16:
+            return BO::ElementKind::UInt16;
+        case BO::Int16:
+            return BO::ElementKind::Int16;
+        case BO::Int32:
+            return BO::ElementKind::Int32;
+        case BO::Float:
+            return BO::ElementKind::Float32;
+    }
+
+    return BO::ElementKind::Float64;
+}
+
+/**
+ * Read column as an array. Packed numbers are given back as a typed array
+ */
+static Local<Value> ReadColumnArray(Decoder* decoder, size_t rows) {
+    size_t offset = decoder->Offset();
+
+    if(decoder->ReadUInt8() == BO::PackedArray) {
+        uint8_t type;
+        size_t length;
+        const uint8_t* data = ReadPackedNumbers(decoder, &type, &length);
+
+        if(data == nullptr)
+            return Nan::Undefined();
+
+        if(length != rows) {
+            Nan::ThrowError("Got column with wrong amount of rows");
+            return Nan::Undefined();
+        }
+
+        size_t byte_length = length * NumberScan::Width(type);
+        Local<ArrayBuffer> array_buffer = ArrayBuffer::New(Isolate::GetCurrent(), byte_length);
+        Local<Value> view = NewTypedArray(PackedElementKind(type), array_buffer, 0, length);
+
+        memcpy(node::Buffer::Data(view), data, byte_length);
+        return view;
+    }
+
+    decoder->Seek(offset);
+
+    std::vector<Local<Value>>& stack = decoder->GetStack();
+    size_t stack_offset = stack.size();
+
+    stack.resize(stack_offset + rows);
+
+    if(!ReadColumn(decoder, rows, stack.data() + stack_offset)) {
+        stack.resize(stack_offset);
+        return Nan::Undefined();
+    }
+
+    Local<Array> list = Array::New(Isolate::GetCurrent(), stack.data() + stack_offset, rows);
+    stack.resize(stack_offset);
+
+    return list;
+}
+
+/**
+ * Read array of objects written as columns. Objects are created row by row out of the
+ * cells of every column, so they share the shape cache with objects read as usual
+ */
+Local<Value> ReadColumns(Decoder* decoder) {
+    size_t rows = ReadLength(decoder);
+    size_t key_count = ReadLength(decoder);
+    size_t offset = decoder->Offset();
+
+    // Rows can't be told apart without columns, so any amount of them could be claimed for free
+    if(key_count == 0) {
+        Nan::ThrowError("Columns must have at least one key");
+        return Nan::Undefined();
+    }
+
+    // Each key and each cell take at least one byte, so sizes are checked against the input before they're trusted
+    if(rows >= SIZE_MAX / 2 || rows + 1 > SIZE_MAX / key_count) {
+        Nan::ThrowError("Exceeded maximum size of buffer, can't go any further");
+        return Nan::Undefined();
+    }
+
+    if(decoder->Consume(key_count * (rows + 1)) == nullptr)
+        return Nan::Undefined();
+
+    decoder->Seek(offset);
+
+    std::vector<const uint8_t*> key_data(key_count);
+    std::vector<uint32_t> key_lengths(key_count);
+    std::vector<Local<Value>> keys(key_count);
+
+    for(size_t k = 0; k < key_count; k++) {
+        key_lengths[k] = ReadLength(decoder);
+        key_data[k] = decoder->Consume(key_lengths[k]);
+
+        if(key_data[k] == nullptr)
+            return Nan::Undefined();
+
+        keys[k] = decoder->NewKey(key_data[k], key_lengths[k]);
+    }
+
+    if(decoder->IsReadingColumnsAsArrays()) {
+        Local<Object> result = Nan::New<Object>();
+
+        for(size_t k = 0; k < key_count; k++) {
+            Local<Value> column = ReadColumnArray(decoder, rows);
+
+            if(column->IsUndefined())
+                return Nan::Undefined();
+
+            Nan::Set(result, keys[k], column);
+        }
+
+        return result;
+    }
+
+    std::vector<Local<Value>> cells(rows * key_count);
+
+    for(size_t k = 0; k < key_count; k++)
+        if(!ReadColumn(decoder, rows, cells.data() + k * rows))
+            return Nan::Undefined();
+
+    std::vector<Local<Value>>& stack = decoder->GetStack();
+    size_t stack_offset = stack.size();
+
+    for(size_t i = 0; i < rows; i++) {
+        size_t object_offset = stack.size();
+        size_t shape_offset = decoder->ShapeOffset();
+        bool cacheable = true;
+
+        for(size_t k = 0; k < key_count; k++) {
+            cacheable = decoder->AddShapeKey(key_data[k], key_lengths[k]) && cacheable;
+
+            stack.push_back(keys[k]);
+            stack.push_back(cells[k * rows + i]);
+        }
+
+        Local<Object> object = decoder->NewObject(object_offset, shape_offset, cacheable, key_count);
+        stack.push_back(object);
+    }
+
+    Local<Array> list = Array::New(Isolate::GetCurrent(), stack.data() + stack_offset, rows);
+    stack.resize(stack_offset);
+
+    return list;
+}
+
+/**
+ * Objects of shared values are created before their properties are read, so they can contain references to themselves
+ */
+static Local<Value> ReadSharedObject(Decoder* decoder) {
+    Local<Context> context = Nan::GetCurrentContext();
+    Local<Object> object = Nan::New<Object>();
+    size_t properties_length = ReadLength(decoder);
+
+    // Each property has a key and a value of at least one byte each
+    if(!CheckItemCount(decoder, properties_length, 2))
+        return Nan::Undefined();
+
+    decoder->GetReferences().values.push_back(object);
+
+    Nan::TryCatch try_catch;
+
+    for(size_t i = 0; i < properties_length; i++) {
+        size_t string_length = ReadLength(decoder);
+        const uint8_t* data = decoder->Consume(string_length);
+
+        if(data == nullptr)
+            break;
+
+        Local<String> key = decoder->NewKey(data, string_length);
+        Local<Value> value = ReadValue(decoder);
+
+        if(try_catch.HasCaught())
+            break;
+
+        // Keys such as `__proto__` are defined instead of assigned, just like objects created out of a shape
+        object->CreateDataProperty(context, key, value).FromJust();
+    }
+
+    if(try_catch.HasCaught()) {
+        try_catch.ReThrow();
+        return Nan::Undefined();
+    }
+
+    return object;
+}
+
+static Local<Value> ReadSharedArray(Decoder* decoder) {
+    size_t array_length = ReadLength(decoder);
+
+    // Every item takes at least one byte, so length is checked against the input before it's trusted
+    if(!CheckItemCount(decoder, array_length, 1))
+        return Nan::Undefined();
+
+    Local<Array> list = Array::New(Isolate::GetCurrent(), array_length);
+
+    decoder->GetReferences().values.push_back(list);
+
+    Nan::TryCatch try_catch;
+
+    for(size_t i = 0; i < array_length; i++) {
+        Local<Value> value = ReadValue(decoder);
+
+        if(try_catch.HasCaught()) {
+            try_catch.ReThrow();
+            return Nan::Undefined();
+        }
+
+        Nan::Set(list, i, value);
+    }
+
+    return list;
+}
+
+static Local<Value> ReadSharedMap(Decoder* decoder) {
+    Local<Context> context = Nan::GetCurrentContext();
+    Local<Map> map = Map::New(context->GetIsolate());
+    size_t map_length = ReadLength(decoder);
+
+    // Each entry has a key and a value of at least one byte each
+    if(!CheckItemCount(decoder, map_length, 2))
+        return Nan::Undefined();
+
+    decoder->GetReferences().values.push_back(map);
+
+    Nan::TryCatch try_catch;
+
+    for(size_t i = 0; i < map_length; i++) {
+        Local<Value> prop = ReadValue(decoder);
+        Local<Value> value = ReadValue(decoder);
+
+        if(try_catch.HasCaught()) {
+            try_catch.ReThrow();
+            return Nan::Undefined();
+        }
+
+        map->Set(context, prop, value).ToLocalChecked();
+    }
+
+    return map;
+}
+
+Local<Value> ReadShared(Decoder* decoder) {
+    ReferenceTable& references = decoder->GetReferences();
+    ReferenceTable outer;
+
+    // Shared values are not nested by encoders, but if they are each one has numbers of it's own
+    std::swap(outer, references);
+
+    references.active = true;
+    references.min_length = ReadLength(decoder);
+
+    Local<Value> value = ReadValue(decoder);
+
+    std::swap(outer, references);
+    return value;
+}
+
+Local<Value> ReadReference(Decoder* decoder) {
+    ReferenceTable& references = decoder->GetReferences();
+    size_t id = ReadLength(decoder);
+
+    if(!references.active) {
+        Nan::ThrowError("Got reference outside of a shared value");
+        return Nan::Undefined();
+    }
+
+    if(id >= references.values.size()) {
+        Nan::ThrowError(std::string("Got reference to unknown value " + std::to_string(id)).c_str());
+        return Nan::Undefined();
+    }
+
+    return references.values[id];
+}
+
+/**
+ * Value given back by a processor, or undefined if it threw, so the exception reaches the caller
+ */
+static Local<Value> DecodedOrUndefined(MaybeLocal<Value> value) {
+    Local<Value> result;
+
+    if(!value.ToLocal(&result))
+        return Nan::Undefined();
+
+    return result;
+}
+
+Local<Value> ReadValue(Decoder* decoder) {
+    uint8_t type = decoder->ReadUInt8();
+    ReferenceTable& references = decoder->GetReferences();
+
+    if(type == BO::Buffer) {
+        return ReadBuffer(decoder);
+    } else if(type == BO::TypedArray) {
+        return ReadTypedArray(decoder);
+    } else if(type == BO::ArrayBuffer) {
+        return ReadArrayBuffer(decoder);
+    } else if(type == BO::Boolean) {
+        bool value = decoder->ReadUInt8() == 0 ? false : true;
+        Local<Boolean> boolean = Nan::New(value);
+
+        return boolean;
+    } else if(type == BO::Undefined) {
+        return Nan::Undefined();
+    } else if(type == BO::Null) {
+        return Nan::Null();
+    } else if(type == BO::Sized) {
+        // Byte length is only needed by readers which step over values
+        if(decoder->Consume(4) == nullptr)
+            return Nan::Undefined();
+
+        return ReadValue(decoder);
+    } else if(type == BO::Object){
+        return references.active ? ReadSharedObject(decoder) : ReadObject(decoder);
+    } else if(type == BO::String || type == BO::OneByteString){
+        Local<Value> string = ReadString(decoder, type);
+
+        if(references.active && (size_t) Local<String>::Cast(string)->Length() >= references.min_length)
+            references.values.push_back(string);
+
+        return string;
+    } else if(type == BO::Date) {
+        double date = decoder->ReadDoubleLE();
+
+        return Nan::New<Date>(date).ToLocalChecked();
+    } else if(type == BO::Array) {
+        return references.active ? ReadSharedArray(decoder) : ReadArray(decoder);
+    } else if(type == BO::PackedArray) {
+        Local<Value> list = ReadPackedArray(decoder);
+
+        if(references.active)
+            references.values.push_back(list);
+
+        return list;
+    } else if(type == BO::Map) {
+        return references.active ? ReadSharedMap(decoder) : ReadMapNative(decoder);
+    } else if(type == BO::Record) {
+        return ReadRecord(decoder);
+    } else if(type == BO::Columns) {
+        return ReadColumns(decoder);
+    } else if(type == BO::Dictionary) {
+        return ReadDictionary(decoder);
+    } else if(type == BO::Shared) {
+        return ReadShared(decoder);
+    } else if(type == BO::Reference) {
+        return ReadReference(decoder);
+    } else {
+        CustomType::Entry* entry;
+
+        if(CheckCustomType(decoder, type, &entry)) {
+            size_t byte_length = ReadLength(decoder);
+
+            if(entry->native != CustomType::NoNative) {
+                const uint8_t* data = decoder->Consume(byte_length);
+
+                if(data == nullptr)
+                    return Nan::Undefined();
+
+                return CustomType::DecodeNative(entry, byte_length, data);
+            }
+
+            if(decoder->IsZeroCopy()) {
+                size_t offset = decoder->Offset();
+
+                if(decoder->Consume(byte_length) == nullptr)
+                    return Nan::Undefined();
+
+                return DecodedOrUndefined(CustomType::Decode(entry, decoder->Slice(offset, byte_length)));
+            }
+
+            const uint8_t* data = decoder->Consume(byte_length);
+
+            if(data == nullptr)
+                return Nan::Undefined();
+
+            uint8_t* buffer = (uint8_t*) malloc(byte_length);
+
+            memcpy(buffer, data, byte_length);
+
+            return DecodedOrUndefined(CustomType::Decode(entry, byte_length, buffer));
+        }
+    }
+
+    Local<Value> v = ReadNumberAsValue(decoder, type);
+    // printf("Number type is %d. Number value is %.6f\n", type, v->NumberValue());
+    return v;
+}
+
+void Decoder::SetCurrentHolder(Local<Object> holder) {
+    current_holder = holder;
+}
+
+Local<Object> Decoder::GetCurrentHolder() {
+    return current_holder;
+}
+
+CustomType::Table* Decoder::GetCustomTypes() {
+    return &types;
+}
+
+SchemaTable* Decoder::GetSchemas() {
+    return &schemas;
+}
+
+bool Decoder::IsZeroCopy() {
+    return zero_copy;
+}
+
+static Local<Value> ReadProjectedObject(Decoder* decoder, Projection* projection, size_t node) {
+    size_t properties_length = ReadLength(decoder);
+    std::vector<Local<Value>>& stack = decoder->GetStack();
+    size_t stack_offset = stack.size();
+    size_t shape_offset = decoder->ShapeOffset();
+    bool cacheable = true;
+
+    for(size_t i = 0; i < properties_length; i++) {
+        uint32_t string_length = ReadLength(decoder);
+        const uint8_t* data = decoder->Consume(string_length);
+
+        if(data == nullptr)
+            break;
+
+        size_t child = projection->FindKey(node, data, string_length);
+
+        if(child == Projection::none) {
+            if(!decoder->Skip())
+                break;
+            continue;
+        }
+
+        Local<Value> value = ReadProjected(decoder, projection, child);
+
+        if(value.IsEmpty())
+            continue;
+
+        cacheable = decoder->AddShapeKey(data, string_length) && cacheable;
+
+        stack.push_back(decoder->NewKey(data, string_length));
+        stack.push_back(value);
+    }
+
+    return decoder->NewObject(stack_offset, shape_offset, cacheable, (stack.size() - stack_offset) / 2);
+}
+
+/**
+ * Elements which are not wanted are left as holes, so the others keep their index
+ */
+static Local<Value> ReadProjectedArray(Decoder* decoder, Projection* projection, size_t node) {
+    size_t array_length = ReadLength(decoder);
+    Local<Array> list = Array::New(Isolate::GetCurrent(), (int) array_length);
+
+    for(size_t i = 0; i < array_length; i++) {
+        size_t child = projection->FindIndex(node, i);
+
+        if(child == Projection::none) {
+            if(!decoder->Skip())
+                break;
+            continue;
+        }
+
+        Local<Value> value = ReadProjected(decoder, projection, child);
+
+        if(!value.IsEmpty())
+            Nan::Set(list, i, value);
+    }
+
+    return list;
+}
+
+Local<Value> ReadProjected(Decoder* decoder, Projection* projection, size_t node) {
+    if(projection->IsLeaf(node))
+        return ReadValue(decoder);
+
+    size_t offset = decoder->Offset();
+    uint8_t type = decoder->ReadUInt8();
+
+    if(type == BO::Sized) {
+        if(decoder->Consume(4) == nullptr)
+            return Nan::Undefined();
+
+        return ReadProjected(decoder, projection, node);
+    } else if(type == BO::Object) {
+        return ReadProjectedObject(decoder, projection, node);
+    } else if(type == BO::Array) {
+        return ReadProjectedArray(decoder, projection, node);
+    } else if(type == BO::Columns || type == BO::Shared || type == BO::Record || type == BO::PackedArray ||
+        type == BO::TypedArray || type == BO::Dictionary || type == BO::Map) {
+        // Rows are only complete after every column was read, references can point anywhere in a shared value,
+        // and the others are created at once out of their contents, so they are read whole
+        decoder->Seek(offset);
+        return ReadValue(decoder);
+    }
+
+    decoder->Seek(offset);
+    decoder->Skip();
+    return Local<Value>();
+}
+
+/**
+ * Read the next value. With the `paths` option only the properties on those paths
+ * are read, and everything else is stepped over without creating values for it
+ */
+NAN_METHOD(Decoder::Decode) {
+    Decoder* decoder = ObjectWrap::Unwrap<Decoder>(info.Holder());
+    std::vector<std::string> paths;
+    Projection projection;
+
+    if(!decoder->Decompress())
+        return;
+
+    if(!Options::Check(info[0]) || !Options::GetStringList(info[0], "paths", &paths))
+        return;
+
+    if(!paths.empty() && !projection.Compile(paths))
+        return;
+
+    decoder->SetCurrentHolder(info.Holder());
+    decoder->ReadHeader();
+
+    Local<Value> result;
+
+    if(projection.IsEmpty()) {
+        result = ReadValue(decoder);
+    } else {
+        result = ReadProjected(decoder, &projection, 0);
+
+        if(result.IsEmpty())
+            result = Nan::Undefined();
+    }
+
+    if(decoder->key_cache == KeyCacheLifetime::Call)
+        decoder->keys.Clear();
+
+    info.GetReturnValue().Set(result);
+}
+
+bool Decoder::SkipAt(size_t offset, size_t* span) {
+    uint8_t result = Scanner::Skip(buffer + offset, byte_length - offset, format, &types, span);
+
+    if(result == Scanner::NeedMore) {
+        Nan::ThrowError("Exceeded maximum size of buffer, can't go any further");
+        return false;
+    }
+
+    if(result == Scanner::Invalid) {
+        Nan::ThrowError(std::string("Got invalid value at offset " + std::to_string(offset)).c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool Decoder::GetValueOffset(Local<Value> value, size_t* offset) {
+    if(!Decompress())
+        return false;
+
+    if(!value->IsNumber()) {
+        Nan::ThrowError("Offset must be a number");
+        return false;
+    }
+
+    double n = Nan::To<double>(value).FromJust();
+
+    if(!(n >= 0) || n >= byte_length) {
+        Nan::ThrowError("Offset is out of bounds");
+        return false;
+    }
+
+    *offset = (size_t) n;
+
+    while(buffer[*offset] == BO::Sized && byte_length - *offset > 5)
+        *offset += 5;
+
+    return true;
+}
+
+bool Decoder::Skip() {
+    size_t span;
+
+    if(!SkipAt(Offset(), &span))
+        return false;
+
+    return Consume(span) != nullptr;
+}
+
+/**
+ * Step over the next value without creating it. Gives back the offset where it starts
+ */
+NAN_METHOD(Decoder::SkipValue) {
+    Decoder* decoder = ObjectWrap::Unwrap<Decoder>(info.Holder());
+
+    if(!decoder->Decompress())
+        return;
+
+    decoder->ReadHeader();
+
+    size_t offset = decoder->Offset();
+
+    if(!decoder->Skip())
+        return;
+
+    info.GetReturnValue().Set(Nan::New<Number>(offset));
+}
+
+Local<Value> Decoder::ReadTape(const std::vector<Scanner::TapeEntry>& tape, size_t* index, size_t base) {
+    const Scanner::TapeEntry& entry = tape[(*index)++];
+    const uint8_t* data = buffer + base;
+
+    if(entry.type == BO::Object) {
+        size_t stack_offset = stack.size();
+        size_t shape_offset = ShapeOffset();
+        bool cacheable = true;
+
+        for(size_t i = 0; i < entry.length; i++) {
+            const Scanner::TapeEntry& key = tape[(*index)++];
+
+            cacheable = AddShapeKey(data + key.offset, key.length) && cacheable;
+
+            stack.push_back(NewKey(data + key.offset, key.length));
+            stack.push_back(ReadTape(tape, index, base));
+        }
+
+        return NewObject(stack_offset, shape_offset, cacheable, entry.length);
+    } else if(entry.type == BO::Array) {
+        size_t stack_offset = stack.size();
+
+        for(size_t i = 0; i < entry.length; i++)
+            stack.push_back(ReadTape(tape, index, base));
+
+        Local<Array> list = Array::New(Isolate::GetCurrent(), stack.data() + stack_offset, entry.length);
+        stack.resize(stack_offset);
+
+        return list;
+    } else if(entry.type == BO::Map) {
+        Local<Context> context = Nan::GetCurrentContext();
+        Local<Map> map = Map::New(context->GetIsolate());
+
+        for(size_t i = 0; i < entry.length; i++) {
+            Local<Value> key = ReadTape(tape, index, base);
+            map = map->Set(context, key, ReadTape(tape, index, base)).ToLocalChecked();
+        }
+
+        return map;
+    } else if(entry.type == BO::String || entry.type == BO::OneByteString) {
+        // Characters were checked while the tape was built, so they're not looked at again
+        return NewScannedString(entry.kind, data + entry.offset, entry.length);
+    }
+
+    Seek(base + entry.offset);
+    return ReadValue(this);
+}
+
+static const char* ValidationMessage(uint8_t result) {
+    switch(result) {
+        case Scanner::NeedMore:
+            return "Input ends before the value does";
+        case Scanner::TooDeep:
+            return "Containers are nested too deep";
+        case Scanner::InvalidString:
+            return "Got invalid UTF-8 string";
+    }
+
+    return "Got invalid value";
+}
+
+/**
+ * Check input holds exactly one well formed message without decoding it. Gives
+ * back null if it does, or the offset and reason of the first error otherwise
+ */
+NAN_METHOD(Decoder::Validate) {
+    Decoder* decoder = ObjectWrap::Unwrap<Decoder>(info.Holder());
+    size_t span = 0;
+    size_t error_offset = 0;
+
+    if(!decoder->Decompress())
+        return;
+
+    decoder->ReadHeader();
+
+    size_t offset = decoder->Offset();
+    uint8_t result = Scanner::Validate(decoder->buffer + offset, decoder->byte_length - offset, decoder->format,
+        &decoder->types, &decoder->schemas, decoder->max_depth, &span, &error_offset);
+    const char* message = ValidationMessage(result);
+
+    if(result == Scanner::Done) {
+        if(offset + span == decoder->byte_length) {
+            info.GetReturnValue().Set(Nan::Null());
+            return;
+        }
+
+        error_offset = span;
+        message = "Got unexpected bytes after the value";
+    }
+
+    Local<Object> error = Nan::New<Object>();
+
+    Nan::Set(error, Nan::New("offset").ToLocalChecked(), Nan::New<Number>(offset + error_offset));
+    Nan::Set(error, Nan::New("message").ToLocalChecked(), Nan::New(message).ToLocalChecked());
+    info.GetReturnValue().Set(error);
+}
+
+/**
+ * Tell if the value at `offset` is an object, an array or any other value
+ */
+NAN_METHOD(Decoder::TypeAt) {
+    Decoder* decoder = ObjectWrap::Unwrap<Decoder>(info.Holder());
+    size_t offset;
+
+    if(!decoder->GetValueOffset(info[0], &offset))
+        return;
+
+    const char* type = "value";
+
+    if(decoder->buffer[offset] == BO::Object)
+        type = "object";
+    else if(decoder->buffer[offset] == BO::Array)
+        type = "array";
+
+    info.GetReturnValue().Set(Nan::New(type).ToLocalChecked());
+}
+
+/**
+ * Offsets of the items of object or array at `offset`, without reading them. Objects give
+ * back `[key, offset, key, offset, ...]` and arrays give back `[offset, offset, ...]`
+ */
+NAN_METHOD(Decoder::Index) {
+    Decoder* decoder = ObjectWrap::Unwrap<Decoder>(info.Holder());
+    size_t offset;
+
+    if(!decoder->GetValueOffset(info[0], &offset))
+        return;
+
+    uint8_t type = decoder->buffer[offset];
+
+    if(type != BO::Object && type != BO::Array) {
+        Nan::ThrowError("Only objects and arrays can be indexed");
+        return;
+    }
+
+    const uint8_t* data = decoder->buffer;
+    size_t byte_length = decoder->byte_length;
+    size_t position = offset + 1;
+    size_t consumed;
+    size_t length;
+    size_t span;
+
+    if(Scanner::ParseLength(data + position, byte_length - position, decoder->format, &consumed, &length) != Scanner::Done) {
+        Nan::ThrowError("Got invalid container length");
+        return;
+    }
+
+    position += consumed;
+
+    Local<Array> index = Nan::New<Array>();
+    uint32_t index_length = 0;
+
+    for(size_t i = 0; i < length; i++) {
+        if(type == BO::Object) {
+            if(Scanner::ParseLength(data + position, byte_length - position, decoder->format, &consumed, &span) != Scanner::Done ||
+                span > byte_length - position - consumed) {
+                Nan::ThrowError("Got invalid object key length");
+                return;
+            }
+
+            Nan::Set(index, index_length++, decoder->NewKey(data + position + consumed, span));
+            position += consumed + span;
+        }
+
+        if(!decoder->SkipAt(position, &span))
+            return;
+
+        Nan::Set(index, index_length++, Nan::New<Number>(position));
+        position += span;
+    }
+
+    if(decoder->key_cache == KeyCacheLifetime::Call)
+        decoder->keys.Clear();
+
+    info.GetReturnValue().Set(index);
+}
+
+/**
+ * Read the value at `offset`, which was given by `skipValue()` or `index()`
+ */
+NAN_METHOD(Decoder::DecodeAt) {
+    Decoder* decoder = ObjectWrap::Unwrap<Decoder>(info.Holder());
+    size_t offset;
+
+    if(!decoder->GetValueOffset(info[0], &offset))
+        return;
+
+    // Lazy values are read at any time, so the position of the next value is kept
+    size_t next = decoder->Offset();
+
+    decoder->SetCurrentHolder(info.Holder());
+    decoder->Seek(offset);
+
+    Local<Value> result = ReadValue(decoder);
+
+    decoder->Seek(next);
+
+    if(decoder->key_cache == KeyCacheLifetime::Call)
+        decoder->keys.Clear();
+
+    info.GetReturnValue().Set(result);
+}
+
+/**
+ * Decode every message in the input, such as the ones written by `encodeMany()`. Keys are
+ * cached across all of them, as they are for a single call to `decode()`
+ */
+NAN_METHOD(Decoder::DecodeMany) {
+    Decoder* decoder = ObjectWrap::Unwrap<Decoder>(info.Holder());
+    Local<Array> results = Nan::New<Array>();
+    uint32_t results_length = 0;
+
+    if(!decoder->Decompress())
+        return;
+
+    Nan::TryCatch try_catch;
+
+    decoder->SetCurrentHolder(info.Holder());
+
+    while(decoder->Offset() < decoder->byte_length) {
+        decoder->ReadHeader();
+
+        Local<Value> value = ReadValue(decoder);
+
+        if(try_catch.HasCaught())
+            break;
+
+        Nan::Set(results, results_length++, value);
+    }
+
+    if(decoder->key_cache == KeyCacheLifetime::Call)
+        decoder->keys.Clear();
+
+    if(try_catch.HasCaught()) {
+        try_catch.ReThrow();
+        return;
+    }
+
+    info.GetReturnValue().Set(results);
+}
+
+/**
+ * Validates a message and builds it's tape on a worker thread, then creates it's value out of the
+ * tape on the main thread. Input must not be changed until the callback is called
+ */
+class DecodeWorker : public Nan::AsyncWorker {
+private:
+    Decoder* decoder;
+    size_t offset;
+    size_t end = 0;
+    uint8_t format;
+    uint32_t max_depth;
+    std::vector<Scanner::TapeEntry> tape;
+    /**
+     * Input being read, which is the message decompressed out of the frame `frame` when `contents` is set
+     */
+    const uint8_t* input;
+    size_t input_length;
+    const uint8_t* frame = nullptr;
+    size_t frame_length = 0;
+public:
+    DecodeWorker(Nan::Callback* callback, Decoder* decoder, Local<Object> holder, Local<Object> contents):
+        Nan::AsyncWorker(callback, "binobject:DecodeWorker"), decoder(decoder), offset(decoder->Offset()),
+        format(decoder->format), max_depth(decoder->max_depth), input(decoder->buffer), input_length(decoder->byte_length) {
+        SaveToPersistent("decoder", holder);
+
+        if(contents.IsEmpty())
+            return;
+
+        // Frame is kept alive on it's own, in case the decoder moves on to the message before the worker is done
+        SaveToPersistent("frame", decoder->GetSource());
+        SaveToPersistent("contents", contents);
+        frame = decoder->buffer;
+        frame_length = decoder->byte_length;
+        input = (const uint8_t*) node::Buffer::Data(contents);
+        input_length = node::Buffer::Length(contents);
+        offset = 0;
+    }
+
+    void Execute() override {
+        size_t span;
+        size_t error_offset;
+
+        if(frame != nullptr) {
+            const char* error = BlockFrame::Read(frame, frame_length, (uint8_t*) input, input_length);
+
+            if(error != nullptr) {
+                SetErrorMessage(error);
+                return;
+            }
+
+            // Header of the message is only known once it was decompressed
+            format = BO::Format::V1;
+
+            if(input_length >= 2 && input[0] == BO::Format::Header && input[1] == BO::Format::V2) {
+                format = BO::Format::V2;
+                offset = 2;
+            }
+        }
+
+        uint8_t result = Scanner::BuildTape(input + offset, input_length - offset, format,
+            &decoder->types, &decoder->schemas, max_depth, &tape, &span, &error_offset);
+
+        if(result != Scanner::Done) {
+            SetErrorMessage(std::string(ValidationMessage(result) + std::string(" at offset ") + std::to_string(offset + error_offset)).c_str());
+            return;
+        }
+
+        end = offset + span;
+    }
+
+    void HandleOKCallback() override {
+        Nan::TryCatch try_catch;
+        size_t index = 0;
+
+        decoder->SetCurrentHolder(Local<Object>::Cast(GetFromPersistent("decoder")));
+
+        if(frame != nullptr && decoder->compressed)
+            decoder->SetDecompressed(Local<Object>::Cast(GetFromPersistent("contents")));
+
+        decoder->SetFormat(format);
+
+        Local<Value> result = decoder->ReadTape(tape, &index, offset);
+
+        decoder->Seek(end);
+
+        if(decoder->key_cache == KeyCacheLifetime::Call)
+            decoder->keys.Clear();
+
+        if(try_catch.HasCaught()) {
+            Local<Value> argv[] = { try_catch.Exception() };
+            callback->Call(1, argv, async_resource);
+            return;
+        }
+
+        Local<Value> argv[] = { Nan::Null(), result };
+        callback->Call(2, argv, async_resource);
+    }
+};
+
+/**
+ * Decode the next value without blocking on most of the work. Input is checked and it's items are found
+ * on the thread pool, then `callback` gets the value created out of them as it's second argument
+ */
+NAN_METHOD(Decoder::DecodeAsync) {
+    Decoder* decoder = ObjectWrap::Unwrap<Decoder>(info.Holder());
+
+    if(!info[0]->IsFunction()) {
+        Nan::ThrowError("Expected callback function");
+        return;
+    }
+
+    Local<Object> contents;
+
+    // Compressed frames are decompressed on the thread pool as well, into a buffer which becomes the input once they are
+    if(decoder->compressed) {
+        if(!Nan::NewBuffer(decoder->message_length).ToLocal(&contents)) {
+            Nan::ThrowError("Allocation failed");
+            return;
+        }
+    } else {
+        decoder->ReadHeader();
+    }
+
+    Nan::Callback* callback = new Nan::Callback(Local<Function>::Cast(info[0]));
+    Nan::AsyncQueueWorker(new DecodeWorker(callback, decoder, info.Holder(), contents));
+}
+
+static const char* const key_cache_lifetimes[] = { "none", "call", "decoder" };
+static const char* const int64_modes[] = { "bigint", "number" };
+static const char* const columns_modes[] = { "rows", "arrays" };
+
+bool Decoder::ReadOptions(Local<Value> options) {
+    return Options::GetBoolean(options, "zeroCopy", &zero_copy) &&
+        Options::GetUint32(options, "externalStrings", &external_strings) &&
+        Options::GetEnum(options, "keyCache", key_cache_lifetimes, 3, &key_cache) &&
+        Options::GetBoolean(options, "shapeCache", &shape_cache) &&
+        Options::GetEnum(options, "int64", int64_modes, 2, &int64) &&
+        Options::GetUint32(options, "maxDepth", &max_depth) &&
+        Options::GetEnum(options, "columns", columns_modes, 2, &columns) &&
+        schemas.Read(options);
+}
+
+NAN_METHOD(Decoder::New) {
+    Local<Object> instance = info.This();
+    Local<Value> value = info[0];
+
+    if(value->IsUndefined()){
+        Nan::ThrowError("Expected buffer but got undefined instead");
+        return;
+    }
+
+    if(!value->IsArrayBufferView()) {
+        Nan::ThrowError("Expected buffer");
+        return;
+    }
+
+    if(!Options::Check(info[2]))
         return;
+
+    size_t message_length = 0;
+    bool compressed = BlockFrame::IsFrame((uint8_t*) node::Buffer::Data(value), node::Buffer::Length(value));
+
+    // Block table of compressed frames is checked upfront, but blocks are only decompressed when the message is read
+    if(compressed) {
+        const char* error = BlockFrame::Measure((const uint8_t*) node::Buffer::Data(value), node::Buffer::Length(value), &message_length);
+
+        if(error != nullptr) {
+            Nan::ThrowError(error);
+            return;
+        }
     }
 
+    Local<ArrayBufferView> view = Local<ArrayBufferView>::Cast(value);
+    // Makes sure the contents are not moved by the garbage collector
+    Local<ArrayBuffer> array_buffer = view->Buffer();
     size_t byte_length = node::Buffer::Length(value);
     uint8_t* buffer = (uint8_t*) node::Buffer::Data(value);
 
@@ -285,6 +2002,13 @@ NAN_METHOD(Decoder::New) {
 
     Decoder* decoder = new Decoder(byte_length, buffer);
     decoder->Wrap(instance);
+    decoder->source.Reset(array_buffer);
+    decoder->source_offset = view->ByteOffset();
+    decoder->compressed = compressed;
+    decoder->message_length = message_length;
+
+    if(!decoder->GetCustomTypes()->Compile(info[1], CustomType::ForDecoding) || !decoder->ReadOptions(info[2]))
+        return;
 
     info.GetReturnValue().Set(instance);
 }
@@ -295,6 +2019,13 @@ void Decoder::Init(Local<Object> exports) {
     tpl->InstanceTemplate()->SetInternalFieldCount(1);
 
     Nan::SetPrototypeMethod(tpl, "decode", Decode);
+    Nan::SetPrototypeMethod(tpl, "decodeAsync", DecodeAsync);
+    Nan::SetPrototypeMethod(tpl, "decodeMany", DecodeMany);
+    Nan::SetPrototypeMethod(tpl, "validate", Validate);
+    Nan::SetPrototypeMethod(tpl, "skipValue", SkipValue);
+    Nan::SetPrototypeMethod(tpl, "typeAt", TypeAt);
+    Nan::SetPrototypeMethod(tpl, "index", Index);
+    Nan::SetPrototypeMethod(tpl, "decodeAt", DecodeAt);
 
     Nan::Set(exports, Nan::New("ObjectDecoder").ToLocalChecked(), Nan::GetFunction(tpl).ToLocalChecked());
 }
\ No newline at end of file
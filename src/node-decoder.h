@@ -2,6 +2,15 @@
 #define NODE_DECODER_H_
 
 #include <nan.h>
+#include <memory>
+#include "custom-type.h"
+#include "key-cache.h"
+#include "shape-cache.h"
+#include "projection.h"
+#include "value-scanner.h"
+#include "object-schema.h"
+#include <vector>
+#include <string>
 
 #ifdef __cplusplus
 extern "C" {
@@ -13,19 +22,176 @@ extern "C" {
 
 using namespace v8;
 
+namespace Int64Mode {
+    enum Int64Mode {
+        /**
+         * 64-bit integers are given back as BigInt
+         */
+        BigInt = 0,
+        /**
+         * 64-bit integers are given back as Number, which is not exact above 2^53
+         */
+        Number = 1
+    };
+}
+
+namespace ColumnsMode {
+    enum ColumnsMode {
+        /**
+         * Arrays written as columns are given back as arrays of objects, just like they were encoded
+         */
+        Rows = 0,
+        /**
+         * Arrays written as columns are given back as an object of arrays, one for each key. Numbers are typed arrays
+         */
+        Arrays = 1
+    };
+}
+
+namespace KeyCacheLifetime {
+    enum KeyCacheLifetime {
+        None = 0,
+        Call = 1,
+        Decoder = 2
+    };
+}
+
+/**
+ * Values of the `BO::Shared` value being read which can be referenced, in the order they were read
+ */
+struct ReferenceTable {
+    bool active = false;
+    /**
+     * Strings with fewer characters are not numbered
+     */
+    size_t min_length = 0;
+    std::vector<Local<Value>> values;
+};
+
 class Decoder : public Nan::ObjectWrap {
+    friend class StreamDecoder;
+    friend class DecodeWorker;
+    friend class RecordReader;
 private:
     mff_deserializer* decoder;
     Local<Object> current_holder;
+    CustomType::Table types;
+    SchemaTable schemas;
+    /**
+     * Input memory is owned by `source`, which is kept alive as long as this decoder is
+     */
+    uint8_t* buffer;
+    size_t byte_length;
+    Nan::Persistent<ArrayBuffer> source;
+    size_t source_offset;
+    /**
+     * Input is a compressed frame holding a message of `message_length` bytes, which is
+     * decompressed on the thread pool by `decodeAsync()` or on first use by other methods
+     */
+    bool compressed = false;
+    size_t message_length = 0;
+    /**
+     * Give back buffers as views of the input instead of copies
+     */
+    bool zero_copy = false;
+    /**
+     * Strings with at least this amount of characters are created as external strings
+     * backed by the input, when it has only Latin-1 characters. Zero means never
+     */
+    uint32_t external_strings = 0;
+#if V8_MAJOR_VERSION >= 8
+    std::shared_ptr<BackingStore> backing_store;
+#endif
+    KeyCache keys;
+    /**
+     * For how long object keys are kept in the cache
+     */
+    uint8_t key_cache = KeyCacheLifetime::Call;
+    ShapeCache shapes;
+    bool shape_cache = true;
+    uint8_t int64 = Int64Mode::BigInt;
+    uint8_t columns = ColumnsMode::Rows;
+    /**
+     * Containers nested deeper than this make `validate()` fail
+     */
+    uint32_t max_depth = 512;
+    /**
+     * Format of the message being read, as told by it's header
+     */
+    uint8_t format;
+    /**
+     * Values and keys of arrays and objects being read, so they are created at once when
+     * all of it's contents are known. Nested containers use it as a stack
+     */
+    std::vector<Local<Value>> stack;
+    std::string shape_keys;
+    ReferenceTable references;
     Decoder(size_t byte_length, uint8_t* buffer);
     ~Decoder();
     static Nan::Persistent<Function> constructor;
     static NAN_METHOD(Decode);
+    static NAN_METHOD(DecodeAsync);
+    static NAN_METHOD(DecodeMany);
+    static NAN_METHOD(Validate);
+    static NAN_METHOD(SkipValue);
+    static NAN_METHOD(TypeAt);
+    static NAN_METHOD(Index);
+    static NAN_METHOD(DecodeAt);
     static NAN_METHOD(New);
+    /**
+     * Read input offset given to a method, moving it past `BO::Sized` prefixes. Throws and returns false if it's out of bounds
+     */
+    bool GetValueOffset(Local<Value> value, size_t* offset);
+    /**
+     * Find out how many bytes the value at input `offset` takes. Throws and returns false if it's not valid
+     */
+    bool SkipAt(size_t offset, size_t* span);
+    /**
+     * Create value out of the tape items starting at `index`, which is moved past them. Tape offsets are relative to input `base`
+     */
+    Local<Value> ReadTape(const std::vector<Scanner::TapeEntry>& tape, size_t* index, size_t base);
+    /**
+     * Read options shared by every kind of decoder. Throws and returns false if any of them is invalid
+     */
+    bool ReadOptions(Local<Value> options);
+    /**
+     * Replace compressed input with the message it holds, once it was decompressed into `contents`
+     */
+    void SetDecompressed(Local<Object> contents);
+    /**
+     * Decompress input if it's a compressed frame. Throws and returns false if the frame is not valid
+     */
+    bool Decompress();
 public:
     static void Init(Local<Object> exports);
     void SetCurrentHolder(Local<Object> holder);
     Local<Object> GetCurrentHolder();
+    CustomType::Table* GetCustomTypes();
+    SchemaTable* GetSchemas();
+    bool IsZeroCopy();
+    /**
+     * Create string out of `length` bytes of input starting at `data`. Throws if it's UTF-8 which is not well formed
+     */
+    Local<String> NewString(uint8_t type, const uint8_t* data, size_t length);
+    /**
+     * Create string out of characters already found to be of `Scanner::StringKind` `kind`
+     */
+    Local<String> NewScannedString(uint8_t kind, const uint8_t* data, size_t length);
+    /**
+     * Create internalized object key out of `length` bytes of input starting at `data`
+     */
+    Local<String> NewKey(const uint8_t* data, size_t length);
+    std::vector<Local<Value>>& GetStack();
+    ReferenceTable& GetReferences();
+    size_t ShapeOffset();
+    /**
+     * Add key to the shape of the object being read. Returns false if the key prevents the shape from being cached
+     */
+    bool AddShapeKey(const uint8_t* data, size_t length);
+    /**
+     * Create object out of the last `length` keys and values pushed to stack
+     */
+    Local<Object> NewObject(size_t stack_offset, size_t shape_offset, bool cacheable, size_t length);
 
     uint8_t ReadUInt8();
     int8_t ReadInt8();
@@ -35,13 +201,83 @@ public:
     int32_t ReadInt32LE();
     double ReadDoubleLE();
     float ReadFloatLE();
+    int64_t ReadInt64LE();
+    uint64_t ReadUInt64LE();
+    uint64_t ReadVarint();
+    bool IsInt64AsBigInt();
+    bool IsReadingColumnsAsArrays();
+    uint8_t GetFormat();
+    /**
+     * Read format header, if there is one
+     */
+    void ReadHeader();
+    void SetFormat(uint8_t format);
+    /**
+     * Read from `byte_length` bytes of `buffer` instead, starting at it's beginning. Memory is not owned
+     * by the decoder, so it must not give back views of it. Used to read values out of stream chunks
+     */
+    void SetInput(uint8_t* buffer, size_t byte_length);
+    /**
+     * Move position to `offset`
+     */
+    void Seek(size_t offset);
     void ReadBytes(size_t length, uint8_t* buffer);
+    /**
+     * Move past the next value without reading it. Throws and returns false if it's not valid
+     */
+    bool Skip();
+    /**
+     * Current position in the input buffer
+     */
+    size_t Offset();
+    /**
+     * Move position `length` bytes ahead and give back the memory that was skipped. If
+     * input has less than `length` bytes left it throws and nullptr is returned
+     */
+    const uint8_t* Consume(size_t length);
+    /**
+     * Create buffer which shares memory with the input
+     */
+    Local<Object> Slice(size_t offset, size_t length);
+    /**
+     * Array buffer which holds the input
+     */
+    Local<ArrayBuffer> GetSource();
+    /**
+     * Position in the source array buffer of input `offset`
+     */
+    size_t SourceOffset(size_t offset);
 };
 
+/**
+ * Read length of a string or container
+ */
+size_t ReadLength(Decoder* decoder);
 Local<Value> ReadArray(Decoder* decoder);
+Local<Value> ReadPackedArray(Decoder* decoder);
+Local<Value> ReadString(Decoder* decoder, uint8_t type);
+Local<Value> ReadKey(Decoder* decoder);
 Local<Value> ReadValue(Decoder* decoder);
-void ReadObject(Decoder* decoder, Local<Object> result);
+Local<Value> ReadObject(Decoder* decoder);
 Local<Value> ReadMapNative(Decoder* decoder);
-Local<Object> ReadBuffer(Decoder* decoder);
+Local<Value> ReadBuffer(Decoder* decoder);
+Local<Value> ReadTypedArray(Decoder* decoder);
+Local<Value> ReadArrayBuffer(Decoder* decoder);
+/**
+ * Read record of one of the schemas given to the decoder
+ */
+Local<Value> ReadRecord(Decoder* decoder);
+Local<Value> ReadColumns(Decoder* decoder);
+/**
+ * Read value whose objects and long strings can be referenced by the values after them
+ */
+Local<Value> ReadShared(Decoder* decoder);
+Local<Value> ReadReference(Decoder* decoder);
+Local<Value> ReadDictionary(Decoder* decoder);
+/**
+ * Read only the parts of the next value wanted by `node` of `projection`, stepping over the rest.
+ * Gives back an empty handle if the value is not a container and the paths go past it
+ */
+Local<Value> ReadProjected(Decoder* decoder, Projection* projection, size_t node);
 
 #endif
\ No newline at end of file
@@ -1,9 +1,14 @@
 #include <iostream>
 #include <nan.h>
 #include <cmath>
+#include <algorithm>
 #include "custom-type.h"
 #include "node-encoder.h"
 #include "node-binobject.h"
+#include "node-options.h"
+#include "number-scan.h"
+#include "varint.h"
+#include "block-frame.h"
 
 using namespace v8;
 
@@ -15,6 +20,8 @@ Encoder::Encoder() {
 
 Encoder::~Encoder() {
     mff_serializer_destroy(encoder);
+    arena.Reset();
+    buffer_prototype.Reset();
 }
 
 int WriteInteger(Encoder* encoder, size_t byte_length, double number, bool _unsigned) {
@@ -59,58 +66,339 @@ int WriteInteger(Encoder* encoder, size_t byte_length, double number, bool _unsi
     return BO::NumberErrors::Ok;
 }
 
+/**
+ * Target memory is written in host byte order, which is little
+ * endian on every platform this module is built for
+ */
+void Encoder::WriteTarget(const void* data, size_t length) {
+    if(target_offset + length <= target_length)
+        memcpy(target + target_offset, data, length);
+
+    target_offset += length;
+}
+
 void Encoder::WriteUInt8(uint8_t n) {
+    if(target != nullptr)
+        return WriteTarget(&n, sizeof(n));
     mff_serializer_write_uint8(encoder, n);
 }
 
 void Encoder::WriteFloatLE(float n) {
+    if(target != nullptr)
+        return WriteTarget(&n, sizeof(n));
     mff_serializer_write_float(encoder, n);
 }
 
 void Encoder::WriteDoubleLE(double n){
+    if(target != nullptr)
+        return WriteTarget(&n, sizeof(n));
     mff_serializer_write_double(encoder, n);
 }
 
 void Encoder::WriteInt8(int8_t n) {
+    if(target != nullptr)
+        return WriteTarget(&n, sizeof(n));
     mff_serializer_write_int8(encoder, n);
 }
 
 void Encoder::WriteInt16LE(int16_t n) {
+    if(target != nullptr)
+        return WriteTarget(&n, sizeof(n));
     mff_serializer_write_int16(encoder, n);
 }
 
 void Encoder::WriteUInt16LE(uint16_t n) {
+    if(target != nullptr)
+        return WriteTarget(&n, sizeof(n));
     mff_serializer_write_uint16(encoder, n);
 }
 
 void Encoder::WriteUInt32LE(uint32_t n) {
+    if(target != nullptr)
+        return WriteTarget(&n, sizeof(n));
     mff_serializer_write_uint32(encoder, n);
 }
 
 void Encoder::WriteInt32LE(int32_t n) {
+    if(target != nullptr)
+        return WriteTarget(&n, sizeof(n));
     mff_serializer_write_int32(encoder, n);
 }
 
+void Encoder::WriteInt64LE(int64_t n) {
+    PushBuffer(sizeof(n), (uint8_t*) &n);
+}
+
+void Encoder::WriteUInt64LE(uint64_t n) {
+    PushBuffer(sizeof(n), (uint8_t*) &n);
+}
+
+void Encoder::WriteVarint(uint64_t n) {
+    uint8_t output[Varint::max_length];
+
+    PushBuffer(Varint::Encode(n, output), output);
+}
+
+size_t Encoder::ReserveUInt32LE() {
+    size_t offset = Length();
+
+    WriteUInt32LE(0);
+    return offset;
+}
+
+void Encoder::PatchUInt32LE(size_t offset, uint32_t n) {
+    if(target != nullptr) {
+        if(offset + sizeof(n) <= target_length)
+            memcpy(target + offset, &n, sizeof(n));
+        return;
+    }
+
+    memcpy((uint8_t*) encoder->buffer + offset, &n, sizeof(n));
+}
+
 void Encoder::PushBuffer(size_t string_length, uint8_t* buffer){
+    if(target != nullptr)
+        return WriteTarget(buffer, string_length);
     mff_serializer_write_buffer(encoder, buffer, (uint32_t) string_length);
 }
 
+uint8_t* Encoder::Claim(size_t length) {
+    if(target != nullptr) {
+        uint8_t* memory = target_offset + length <= target_length ? target + target_offset : nullptr;
+
+        target_offset += length;
+        return memory;
+    }
+
+    if(encoder->offset + length > capacity)
+        Reserve(std::max(encoder->offset + length, capacity * 2));
+
+    uint8_t* memory = (uint8_t*) encoder->buffer + encoder->offset;
+
+    encoder->offset += length;
+    return memory;
+}
+
+void Encoder::BeginTarget(uint8_t* memory, size_t length) {
+    target = memory;
+    target_length = length;
+    target_offset = 0;
+}
+
+void Encoder::BeginMeasure() {
+    static uint8_t nothing;
+    BeginTarget(&nothing, 0);
+}
+
+size_t Encoder::EndTarget() {
+    size_t byte_length = target_offset;
+
+    target = nullptr;
+    target_length = 0;
+    target_offset = 0;
+
+    return byte_length;
+}
+
+void Encoder::PushPayload(Local<Value> view, size_t byte_length, const uint8_t* buffer) {
+    if(target != nullptr || zero_copy_threshold == 0 || byte_length < zero_copy_threshold) {
+        PushBuffer(byte_length, (uint8_t*) buffer);
+        return;
+    }
+
+    EncoderSegment segment;
+    segment.offset = Length();
+    segment.view = view;
+    segment.data = buffer;
+    segment.byte_length = byte_length;
+    segments.push_back(segment);
+    segments_length += byte_length;
+}
+
+void Encoder::Reset() {
+    segments.clear();
+    segments_length = 0;
+    encoder->offset = 0;
+    target = nullptr;
+}
+
+void Encoder::Reserve(size_t capacity) {
+    static const uint8_t zeros[4096] = { 0 };
+    size_t offset = encoder->offset;
+
+    // Serializer grows by itself as it is written, so writing
+    // is the only way to have it allocated upfront
+    for(size_t i = offset; i < capacity; i += sizeof(zeros))
+        mff_serializer_write_buffer(encoder, (uint8_t*) zeros, (uint32_t) std::min(sizeof(zeros), capacity - i));
+
+    encoder->offset = offset;
+    this->capacity = std::max(this->capacity, capacity);
+}
+
+void Encoder::Shrink() {
+    if(shrink_threshold == 0 || high_water <= shrink_threshold)
+        return;
+
+    mff_serializer_destroy(encoder);
+    mff_serializer_init(&encoder);
+    capacity = 0;
+    Reserve(initial_capacity);
+    high_water = 0;
+}
+
+uint8_t* Encoder::AllocateOutput(size_t byte_length, Local<Object>* result) {
+    // Outputs too big for the arena would waste most of it
+    if(arena_size == 0 || byte_length > arena_size / 8) {
+        char* buffer = (char*) malloc(byte_length);
+
+        if(buffer == nullptr)
+            return nullptr;
+
+        *result = Nan::NewBuffer(buffer, byte_length).ToLocalChecked();
+        return (uint8_t*) buffer;
+    }
+
+    // Arena is replaced if an earlier output had it's `ArrayBuffer` transferred, which detaches it and frees it's memory
+    if(arena_data != nullptr && Local<Uint8Array>::Cast(Nan::New(arena))->Buffer()->ByteLength() == 0)
+        arena_data = nullptr;
+
+    if(arena_data == nullptr || arena_offset + byte_length > arena_size) {
+        Local<Object> buffer = Nan::NewBuffer(arena_size).ToLocalChecked();
+
+        arena.Reset(buffer);
+        arena_data = (uint8_t*) node::Buffer::Data(buffer);
+        arena_offset = 0;
+    }
+
+    Local<Uint8Array> view = Local<Uint8Array>::Cast(Nan::New(arena));
+    uint8_t* memory = arena_data + arena_offset;
+
+    *result = node::Buffer::New(Isolate::GetCurrent(), view->Buffer(), view->ByteOffset() + arena_offset, byte_length).ToLocalChecked();
+    // Keep slices aligned, so typed arrays can be created on top of them
+    arena_offset += (byte_length + 7) & ~((size_t) 7);
+
+    return memory;
+}
+
 void Encoder::FlushContents(void* target) {
     memcpy(target, encoder->buffer, Length());
     encoder->offset = 0;
 }
 
+size_t Encoder::OutputLength() {
+    return Length() + segments_length;
+}
+
+size_t Encoder::OutputOffset() {
+    if(target != nullptr)
+        return target_offset;
+    return encoder->offset + segments_length;
+}
+
+void Encoder::FlushSegments(void* target) {
+    uint8_t* output = (uint8_t*) target;
+    size_t offset = 0;
+
+    for(const EncoderSegment& segment : segments) {
+        memcpy(output, (uint8_t*) encoder->buffer + offset, segment.offset - offset);
+        output += segment.offset - offset;
+        offset = segment.offset;
+
+        memcpy(output, segment.data, segment.byte_length);
+        output += segment.byte_length;
+    }
+
+    memcpy(output, (uint8_t*) encoder->buffer + offset, Length() - offset);
+    segments.clear();
+    segments_length = 0;
+    encoder->offset = 0;
+}
+
+/**
+ * Create a buffer which shares memory with the typed array `view`
+ */
+static Local<Value> SliceView(Local<Value> view) {
+    if(view->IsArrayBuffer()) {
+        Local<ArrayBuffer> array_buffer = Local<ArrayBuffer>::Cast(view);
+        return node::Buffer::New(Isolate::GetCurrent(), array_buffer, 0, array_buffer->ByteLength()).ToLocalChecked();
+    }
+
+    Local<ArrayBufferView> array = Local<ArrayBufferView>::Cast(view);
+    Local<ArrayBuffer> array_buffer = array->Buffer();
+
+    return node::Buffer::New(Isolate::GetCurrent(), array_buffer, array->ByteOffset(), array->ByteLength()).ToLocalChecked();
+}
+
+Local<Array> Encoder::FlushVectored() {
+    Local<Array> list = Nan::New<Array>();
+    uint32_t index = 0;
+    size_t offset = 0;
+
+    for(const EncoderSegment& segment : segments) {
+        if(segment.offset > offset)
+            Nan::Set(list, index++, Nan::CopyBuffer((const char*) encoder->buffer + offset, segment.offset - offset).ToLocalChecked());
+
+        Nan::Set(list, index++, SliceView(segment.view));
+        offset = segment.offset;
+    }
+
+    if(Length() > offset)
+        Nan::Set(list, index++, Nan::CopyBuffer((const char*) encoder->buffer + offset, Length() - offset).ToLocalChecked());
+
+    segments.clear();
+    segments_length = 0;
+    encoder->offset = 0;
+    return list;
+}
+
 size_t Encoder::Length() {
+    if(target != nullptr)
+        return target_offset;
     return encoder->offset;
 }
 
+/**
+ * Write length and contents of string straight into the output. Strings are written as UTF-8, or as Latin-1
+ * when `one_byte` is true and they only have Latin-1 characters, some of them outside of ASCII. ASCII strings
+ * are written as they are, since they are valid UTF-8. With `typed` the type they were written as comes first
+ */
+static void WriteStringContents(Encoder* encoder, Local<String> value, bool one_byte, bool typed) {
+    Isolate* isolate = Isolate::GetCurrent();
+    size_t length = value->Length();
+    size_t utf8_length = value->Utf8Length(isolate);
+    // Latin-1 strings take as many bytes in UTF-8 as they have characters only if they are ASCII
+    bool ascii = value->IsOneByte() && utf8_length == length;
+    bool latin1 = value->IsOneByte() && (ascii || one_byte);
+    size_t byte_length = latin1 ? length : utf8_length;
+
+    if(typed)
+        encoder->WriteUInt8(latin1 && !ascii ? (uint8_t) BO::OneByteString : (uint8_t) BO::String);
+
+    WriteLength(encoder, byte_length);
+
+    uint8_t* memory = encoder->Claim(byte_length);
+
+    if(memory == nullptr)
+        return;
+
+    if(latin1)
+        value->WriteOneByte(isolate, memory, 0, (int) length, String::NO_NULL_TERMINATION);
+    else
+        value->WriteUtf8(isolate, (char*) memory, (int) byte_length, nullptr, String::NO_NULL_TERMINATION | String::REPLACE_INVALID_UTF8);
+}
+
+/**
+ * Write length and UTF-8 contents of string, without type
+ */
 void WriteString(Encoder* encoder, Local<String> value) {
-    int length = value->Length();
-    char buffer[length];
-    Nan::DecodeWrite(buffer, length, value);
+    WriteStringContents(encoder, value, false, false);
+}
 
-    WriteCompressedNumber(encoder, length);
-    encoder->PushBuffer(length, (uint8_t*) buffer);
+/**
+ * Write string value using the cheapest representation for it
+ */
+void WriteStringValue(Encoder* encoder, Local<String> value) {
+    WriteStringContents(encoder, value, true, true);
 }
 
 void WriteCompressedNumber(Encoder* encoder, double number) {
@@ -128,7 +416,11 @@ void WriteCompressedNumber(Encoder* encoder, double number) {
         result = WriteInteger(encoder, 4, number, false);
     else if((number >= 0) && number <= 0xffffffff)
         result = WriteInteger(encoder, 4, number, true);
-    else {
+    else if(number >= -9007199254740991.0 && number <= 9007199254740991.0 && number == std::trunc(number)) {
+        encoder->WriteUInt8(BO::VarInt);
+        encoder->WriteVarint(Varint::ZigZag((int64_t) number));
+        result = BO::NumberErrors::Ok;
+    } else {
         encoder->WriteUInt8(BO::Double);
         encoder->WriteDoubleLE(number);
         result = BO::NumberErrors::Ok;
@@ -143,8 +435,32 @@ void WriteCompressedNumber(Encoder* encoder, double number) {
     }
 }
 
+void WriteLength(Encoder* encoder, size_t length, bool wide) {
+    if(encoder->GetFormat() == BO::Format::V2)
+        encoder->WriteVarint(length);
+    else if(wide)
+        WriteInteger(encoder, 4, length, true);
+    else
+        WriteCompressedNumber(encoder, length);
+}
+
 void WriteNumber(Encoder* encoder, Local<Number> value) {
     double n = Nan::To<double>(value).FromJust();
+
+    if(encoder->GetFormat() == BO::Format::V2) {
+        if(n >= -9007199254740991.0 && n <= 9007199254740991.0 && n == std::trunc(n)) {
+            encoder->WriteUInt8(BO::VarInt);
+            encoder->WriteVarint(Varint::ZigZag((int64_t) n));
+        } else if(NumberScan::IsFloat(n)) {
+            encoder->WriteUInt8(BO::Float);
+            encoder->WriteFloatLE((float) n);
+        } else {
+            encoder->WriteUInt8(BO::Double);
+            encoder->WriteDoubleLE(n);
+        }
+        return;
+    }
+
     if(std::isnan(n)) {
         encoder->WriteUInt8(BO::Float);
         encoder->WriteFloatLE(NAN);
@@ -153,194 +469,1094 @@ void WriteNumber(Encoder* encoder, Local<Number> value) {
     WriteCompressedNumber(encoder, n);
 }
 
-void WriteArray(Encoder* encoder, Local<Array> array) {
-    uint32_t length = array->Length();
+/**
+ * Arrays shorter than this are not worth scanning, their header would take most of the output anyway
+ */
+static const uint32_t packed_array_min_length = 4;
 
-    encoder->WriteUInt8(BO::Array);
+template<typename T>
+static void PackNumbers(const double* values, size_t length, uint8_t* output) {
+    for(size_t i = 0; i < length; i++) {
+        T n = (T) values[i];
+        memcpy(output + i * sizeof(T), &n, sizeof(T));
+    }
+}
 
-    WriteInteger(encoder, 4, length, true);
+/**
+ * Write `length` numbers as `BO::PackedArray`, using the narrowest type which keeps all of them
+ */
+static void WritePackedNumbers(Encoder* encoder, const double* numbers, size_t length) {
+    uint8_t type = NumberScan::Classify(numbers, length);
+    size_t byte_length = NumberScan::Width(type) * length;
+    std::vector<uint8_t>& scratch = encoder->GetScratch();
 
-    for(uint32_t i = 0; i < length; i++)
-        WriteValue(encoder, Nan::Get(array, i).ToLocalChecked());
+    scratch.resize(byte_length);
+
+    switch(type) {
+        case BO::UInt8:
+            PackNumbers<uint8_t>(numbers, length, scratch.data());
+            break;
+        case BO::Int8:
+            PackNumbers<int8_t>(numbers, length, scratch.data());
+            break;
+        case BO::UInt16:
+            PackNumbers<uint16_t>(numbers, length, scratch.data());
+            break;
+        case BO::Int16:
+            PackNumbers<int16_t>(numbers, length, scratch.data());
+            break;
+        case BO::Int32:
+            PackNumbers<int32_t>(numbers, length, scratch.data());
+            break;
+        case BO::Float:
+            PackNumbers<float>(numbers, length, scratch.data());
+            break;
+        default:
+            PackNumbers<double>(numbers, length, scratch.data());
+    }
+
+    encoder->WriteUInt8(BO::PackedArray);
+    encoder->WriteUInt8(type);
+    WriteLength(encoder, length);
+    encoder->PushBuffer(byte_length, scratch.data());
 }
 
-void WriteNativeMap(Encoder* encoder, Local<Map> map) {
-    Local<Array> array = map->AsArray();
-    size_t array_length = map->Size() * 2;
+/**
+ * Write array as `BO::PackedArray` if every element is a number. Returns false
+ * without writing anything otherwise
+ */
+static bool WritePackedArray(Encoder* encoder, Local<Array> array, uint32_t length) {
+    std::vector<double>& numbers = encoder->GetNumbers();
 
-    WriteCompressedNumber(encoder, array_length / 2);
+    numbers.resize(length);
 
-    for(size_t i = 0; i < array_length;) {
-        Local<Value> prop = Nan::Get(array, Nan::New<Number>(i++)).ToLocalChecked();
-        Local<Value> value = Nan::Get(array, Nan::New<Number>(i++)).ToLocalChecked();
+    for(uint32_t i = 0; i < length; i++) {
+        Local<Value> value = Nan::Get(array, i).ToLocalChecked();
 
-        WriteValue(encoder, prop);
-        WriteValue(encoder, value);
+        if(!value->IsNumber())
+            return false;
+
+        numbers[i] = Local<Number>::Cast(value)->Value();
     }
+
+    WritePackedNumbers(encoder, numbers.data(), length);
+    return true;
 }
 
 /**
- * Check if this value can be written using a type defined by the user
+ * Arrays of objects with fewer rows than this are written as usual
  */
-bool CheckCustomType(Encoder* encoder, Local<Value> value) {
-    Local<Array> instructions = Local<Array>::Cast(Nan::Get(
-        encoder->GetHolder(),
-        Nan::New("instructions").ToLocalChecked()
-    ).ToLocalChecked());
-    uint32_t length = instructions->Length();
+static const uint32_t columns_min_length = 8;
 
-    for(uint32_t i = 0; i < length; i++) {
-        Local<Number> index = Nan::New<Number>(i);
-        Local<Object> instruction = Nan::To<Object>(Nan::Get(instructions, index).ToLocalChecked()).ToLocalChecked();
+/**
+ * Write strings as `BO::Dictionary` if at most half of them are distinct. Returns false without writing anything otherwise
+ */
+static bool WriteDictionary(Encoder* encoder, const std::vector<Local<Value>>& cells) {
+    Local<Context> context = Nan::GetCurrentContext();
+    Local<Map> indices = Map::New(context->GetIsolate());
+    std::vector<Local<Value>> distinct;
+    std::vector<double>& numbers = encoder->GetNumbers();
 
-        if(!Nan::Get(instructions, index).ToLocalChecked()->IsObject()) {
-            Nan::ThrowError("Instruction item should be plain objects");
-            return true;
+    numbers.resize(cells.size());
+
+    for(size_t i = 0; i < cells.size(); i++) {
+        Local<Value> index = indices->Get(context, cells[i]).ToLocalChecked();
+
+        if(index->IsUndefined()) {
+            index = Nan::New<Number>(distinct.size());
+            indices->Set(context, cells[i], index).ToLocalChecked();
+            distinct.push_back(cells[i]);
+
+            if(distinct.size() * 2 > cells.size())
+                return false;
         }
 
-        Local<Object> processor = Nan::To<Object>(
-            Nan::Get(instruction, Nan::New("processor").ToLocalChecked()).ToLocalChecked()
-        ).ToLocalChecked();
-        uint8_t validationResult = CustomType::Validate(processor, value);
-        
-        if(validationResult == 2)
-            return true;
-        else if(validationResult == 0)
-            continue;
+        numbers[i] = Local<Number>::Cast(index)->Value();
+    }
 
-        size_t buffer_length;
-        uint8_t* result;
+    encoder->WriteUInt8(BO::Dictionary);
+    WriteLength(encoder, distinct.size());
 
-        if(CustomType::Encode(processor, value, &result, &buffer_length) != 0)
-            return true;
+    for(Local<Value> string : distinct)
+        WriteStringValue(encoder, Local<String>::Cast(string));
+
+    // Strings were written with the scratch buffer, so indices are packed only now
+    WritePackedNumbers(encoder, numbers.data(), cells.size());
+    return true;
+}
 
-        uint8_t type = Local<Number>::Cast(Nan::Get(instruction, Nan::New("value").ToLocalChecked()).ToLocalChecked())->Value();
+static void WriteColumn(Encoder* encoder, const std::vector<Local<Value>>& cells) {
+    bool numbers_only = true;
+    bool strings_only = true;
 
-        encoder->WriteUInt8(type);
-        WriteInteger(encoder, 4, buffer_length, true);
-        encoder->PushBuffer(buffer_length, result);
-        return true;
+    for(Local<Value> cell : cells) {
+        numbers_only = numbers_only && cell->IsNumber();
+        strings_only = strings_only && cell->IsString();
     }
 
-    return false;
+    if(numbers_only) {
+        std::vector<double>& numbers = encoder->GetNumbers();
+
+        numbers.resize(cells.size());
+
+        for(size_t i = 0; i < cells.size(); i++)
+            numbers[i] = Local<Number>::Cast(cells[i])->Value();
+
+        WritePackedNumbers(encoder, numbers.data(), cells.size());
+        return;
+    }
+
+    // Strings of a dictionary are written as they are, so they can't be claimed by a built-in processor
+    if(strings_only && !encoder->GetCustomTypes()->ClaimsStrings() && WriteDictionary(encoder, cells))
+        return;
+
+    encoder->WriteUInt8(BO::Array);
+    WriteLength(encoder, cells.size(), true);
+
+    for(Local<Value> cell : cells)
+        WriteValue(encoder, cell);
 }
 
-void WriteValue(Encoder* encoder, Local<Value> value) {
+/**
+ * Write array as `BO::Columns` if every element is a plain object and all of them have the
+ * same keys in the same order. Returns false without writing anything otherwise
+ */
+static bool WriteColumns(Encoder* encoder, Local<Array> array, uint32_t length) {
     Local<Context> context = Nan::GetCurrentContext();
-    if(CheckCustomType(encoder, value))
-        return;
+    Local<Value> object_prototype = Nan::New<Object>()->GetPrototype();
+    std::vector<Local<Object>> rows(length);
+    std::vector<Local<String>> keys;
 
-    if(value->IsTypedArray()) {
-        size_t byte_length = node::Buffer::Length(value);
-        uint8_t buffer[byte_length];
+    for(uint32_t i = 0; i < length; i++) {
+        Local<Value> value = Nan::Get(array, i).ToLocalChecked();
 
-        memcpy(buffer, node::Buffer::Data(value), byte_length);
+        if(!value->IsObject() || !Local<Object>::Cast(value)->GetPrototype()->StrictEquals(object_prototype))
+            return false;
 
-        encoder->WriteUInt8(BO::Buffer);
-        WriteInteger(encoder, 4, byte_length, true);
-        encoder->PushBuffer(byte_length, buffer);
-    } else if(value->IsBoolean()) {
-        Local<Boolean> boolean = Local<Boolean>::Cast(value);
+        rows[i] = Local<Object>::Cast(value);
 
-        encoder->WriteUInt8(BO::Boolean);
+        Local<Array> names = Nan::GetOwnPropertyNames(rows[i]).ToLocalChecked();
+        uint32_t names_length = names->Length();
 
-        if(boolean->Value())
-            encoder->WriteUInt8(1);
-        else
-            encoder->WriteUInt8(0);
-    } else if(value->IsUndefined()) {
-        encoder->WriteUInt8(BO::Undefined);
-    } else if(value->IsNull()) {
-        encoder->WriteUInt8(BO::Null);
-    } else if(value->IsMap()) {
-        encoder->WriteUInt8(BO::Map);
-        WriteNativeMap(encoder, Local<Map>::Cast(value));
-    } else if(value->IsDate()) {
-        Local<Date> date = Local<Date>::Cast(value);
+        if(i == 0) {
+            if(names_length == 0)
+                return false;
 
-        encoder->WriteUInt8(BO::Date);
-        encoder->WriteDoubleLE(date->ValueOf());
-    } else if(value->IsArray()) {
-        Local<Array> list = Local<Array>::Cast(value);
-        WriteArray(encoder, list);
-    } else if(value->IsNumber()) {
-        WriteNumber(encoder, value->ToNumber(context).ToLocalChecked());
-    } else if(value->IsString()) {
-        Local<String> string = value->ToString(context).ToLocalChecked();
+            // Integer-like keys are given as numbers
+            for(uint32_t k = 0; k < names_length; k++)
+                keys.push_back(Nan::Get(names, k).ToLocalChecked()->ToString(context).ToLocalChecked());
+        } else {
+            if(names_length != keys.size())
+                return false;
 
-        encoder->WriteUInt8(BO::String);
-        WriteString(encoder, string);
-    } else if(value->IsObject()) {
-        WriteObject(encoder, value->ToObject(context).ToLocalChecked());
-    } else {
-        Nan::ThrowError("Invalid value type");
+            for(uint32_t k = 0; k < names_length; k++)
+                if(!Nan::Get(names, k).ToLocalChecked()->ToString(context).ToLocalChecked()->StrictEquals(keys[k]))
+                    return false;
+        }
     }
-}
 
-void WriteObject(Encoder* encoder, Local<Object> object) {
-    Local<Array> properties = Nan::GetOwnPropertyNames(object).ToLocalChecked();
-    Local<Context> context = Nan::GetCurrentContext();
-    uint32_t length = properties->Length();
-    
-    encoder->WriteUInt8(BO::Object);
-    WriteCompressedNumber(encoder, length);
+    encoder->WriteUInt8(BO::Columns);
+    WriteLength(encoder, length);
+    WriteLength(encoder, keys.size());
 
-    for(uint32_t i = 0; i < length; i++){
-        Local<String> name = Nan::Get(properties, i).ToLocalChecked()->ToString(context).ToLocalChecked();
+    for(Local<String> key : keys)
+        WriteString(encoder, key);
 
-        WriteString(encoder, name);
-        WriteValue(encoder, Nan::Get(object, name).ToLocalChecked());
-    }
-}
+    std::vector<Local<Value>> cells(length);
 
-void Encoder::SetCurrentHolder(Local<Object> n) {
-    holder = n;
-}
+    for(Local<String> key : keys) {
+        for(uint32_t i = 0; i < length; i++)
+            cells[i] = Nan::Get(rows[i], key).ToLocalChecked();
 
-Local<Object> Encoder::GetHolder() {
-    return holder;
+        WriteColumn(encoder, cells);
+    }
+
+    return true;
 }
 
-NAN_METHOD(Encoder::Encode) {
-    Local<Value> value = info[0];
-    Encoder* encoder = Nan::ObjectWrap::Unwrap<Encoder>(info.Holder());
+/**
+ * Write BigInt as a 64-bit integer. Throws if it does not fit in one
+ */
+void WriteBigInt(Encoder* encoder, Local<BigInt> value) {
+    bool lossless;
+    int64_t n = value->Int64Value(&lossless);
 
-    encoder->SetCurrentHolder(info.Holder());
+    if(lossless && n < 0) {
+        encoder->WriteUInt8(BO::Int64);
+        encoder->WriteInt64LE(n);
+        return;
+    }
 
-    WriteValue(encoder, value);
+    uint64_t u = value->Uint64Value(&lossless);
 
-    size_t byte_length = encoder->Length();
-    char* buffer = (char*) malloc(byte_length);
-    if(buffer == nullptr) {
-        Nan::ThrowError("Allocation failed");
+    if(!lossless) {
+        Nan::ThrowError("BigInt does not fit in 64 bits");
         return;
     }
 
-    encoder->FlushContents(buffer);
-    Local<Object> result = Nan::NewBuffer((char*)buffer, byte_length).ToLocalChecked();
-    info.GetReturnValue().Set(result);
+    encoder->WriteUInt8(BO::UInt64);
+    encoder->WriteUInt64LE(u);
 }
 
-void Encoder::Init(Local<Object> exports) {
-    Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
-    tpl->SetClassName(Nan::New("ObjectEncoder").ToLocalChecked());
-    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+/**
+ * Container whose byte length is written once all of it's contents are
+ */
+struct SizedContainer {
+    /**
+     * Serializer offset of the byte length, or `SIZE_MAX` if containers are not sized
+     */
+    size_t patch;
+    size_t start;
+};
+
+static void BeginSized(Encoder* encoder, SizedContainer* sized) {
+    sized->patch = SIZE_MAX;
+
+    if(!encoder->IsSizingContainers())
+        return;
+
+    encoder->WriteUInt8(BO::Sized);
+    sized->patch = encoder->ReserveUInt32LE();
+    sized->start = encoder->OutputOffset();
+}
+
+static void EndSized(Encoder* encoder, SizedContainer* sized) {
+    if(sized->patch == SIZE_MAX)
+        return;
+
+    size_t byte_length = encoder->OutputOffset() - sized->start;
+
+    if(byte_length > UINT32_MAX) {
+        Nan::ThrowError("Container is too big to be sized");
+        return;
+    }
+
+    encoder->PatchUInt32LE(sized->patch, (uint32_t) byte_length);
+}
+
+void WriteArray(Encoder* encoder, Local<Array> array) {
+    uint32_t length = array->Length();
+
+    // Numbers could be claimed by a custom type, so they are only packed when that can't happen
+    if(length >= packed_array_min_length && encoder->IsPackingArrays() && encoder->GetCustomTypes()->IsObjectsAndStringsOnly() &&
+        WritePackedArray(encoder, array, length))
+        return;
+
+    // Objects could be claimed by a custom type with a `validate()` function, so they are only written as columns when that can't
+    // happen. Rows are not numbered either, so references would not find them
+    if(length >= columns_min_length && encoder->IsColumnar() && encoder->GetCustomTypes()->IsObjectsAndStringsOnly() &&
+        !encoder->IsReferencing() && WriteColumns(encoder, array, length))
+        return;
+
+    SizedContainer sized;
+    BeginSized(encoder, &sized);
+
+    encoder->WriteUInt8(BO::Array);
+
+    WriteLength(encoder, length, true);
+
+    for(uint32_t i = 0; i < length; i++)
+        WriteValue(encoder, Nan::Get(array, i).ToLocalChecked());
+
+    EndSized(encoder, &sized);
+}
+
+void WriteNativeMap(Encoder* encoder, Local<Map> map) {
+    Local<Array> array = map->AsArray();
+    size_t array_length = map->Size() * 2;
+
+    WriteLength(encoder, array_length / 2);
+
+    for(size_t i = 0; i < array_length;) {
+        Local<Value> prop = Nan::Get(array, Nan::New<Number>(i++)).ToLocalChecked();
+        Local<Value> value = Nan::Get(array, Nan::New<Number>(i++)).ToLocalChecked();
+
+        WriteValue(encoder, prop);
+        WriteValue(encoder, value);
+    }
+}
+
+/**
+ * Check if this value can be written using a type defined by the user
+ */
+bool CheckCustomType(Encoder* encoder, Local<Value> value) {
+    bool failed;
+    CustomType::Entry* entry = encoder->GetCustomTypes()->Match(value, &failed);
+
+    if(failed)
+        return true;
+    else if(entry == nullptr)
+        return false;
+
+    size_t buffer_length;
+    const uint8_t* result;
+
+    if(entry->native != CustomType::NoNative) {
+        if(CustomType::EncodeNative(entry, value, encoder->GetScratch(), &result, &buffer_length) != 0)
+            return true;
+    } else {
+        Local<Value> buffer;
+
+        if(CustomType::Encode(entry, value, &buffer) != 0)
+            return true;
+
+        encoder->WriteUInt8(entry->type);
+        WriteLength(encoder, node::Buffer::Length(buffer), true);
+        encoder->PushPayload(buffer, node::Buffer::Length(buffer), (const uint8_t*) node::Buffer::Data(buffer));
+        return true;
+    }
+
+    encoder->WriteUInt8(entry->type);
+    WriteLength(encoder, buffer_length, true);
+    encoder->PushBuffer(buffer_length, (uint8_t*) result);
+    return true;
+}
+
+static uint8_t GetElementKind(Local<Value> value) {
+    if(value->IsInt8Array())
+        return BO::ElementKind::Int8;
+    else if(value->IsUint8Array())
+        return BO::ElementKind::UInt8;
+    else if(value->IsUint8ClampedArray())
+        return BO::ElementKind::UInt8Clamped;
+    else if(value->IsInt16Array())
+        return BO::ElementKind::Int16;
+    else if(value->IsUint16Array())
+        return BO::ElementKind::UInt16;
+    else if(value->IsInt32Array())
+        return BO::ElementKind::Int32;
+    else if(value->IsUint32Array())
+        return BO::ElementKind::UInt32;
+    else if(value->IsFloat32Array())
+        return BO::ElementKind::Float32;
+    else if(value->IsFloat64Array())
+        return BO::ElementKind::Float64;
+    else if(value->IsBigInt64Array())
+        return BO::ElementKind::BigInt64;
+    else if(value->IsBigUint64Array())
+        return BO::ElementKind::BigUInt64;
+    return BO::ElementKind::DataView;
+}
+
+/**
+ * Write typed array or `DataView` keeping it's element kind. Contents are padded to
+ * start at a multiple of the element size counting from the start of the output
+ */
+void WriteTypedArray(Encoder* encoder, Local<Value> value) {
+    size_t byte_length = node::Buffer::Length(value);
+    const uint8_t* data = (const uint8_t*) node::Buffer::Data(value);
+
+    if(encoder->IsNodeBuffer(value)) {
+        encoder->WriteUInt8(BO::Buffer);
+        WriteLength(encoder, byte_length, true);
+        encoder->PushPayload(value, byte_length, data);
+        return;
+    }
+
+    uint8_t kind = GetElementKind(value);
+    size_t element_size = BO::ElementKind::ElementSize(kind);
+
+    encoder->WriteUInt8(BO::TypedArray);
+    encoder->WriteUInt8(kind);
+    WriteLength(encoder, byte_length);
+
+    // Padding length itself takes one byte
+    uint8_t padding = (element_size - (encoder->OutputOffset() + 1) % element_size) % element_size;
+
+    encoder->WriteUInt8(padding);
+    for(uint8_t i = 0; i < padding; i++)
+        encoder->WriteUInt8(0);
+
+    encoder->PushPayload(value, byte_length, data);
+}
+
+void WriteArrayBuffer(Encoder* encoder, Local<ArrayBuffer> array_buffer) {
+    size_t byte_length = array_buffer->ByteLength();
+#if V8_MAJOR_VERSION >= 8
+    const uint8_t* data = (const uint8_t*) array_buffer->GetBackingStore()->Data();
+#else
+    const uint8_t* data = (const uint8_t*) array_buffer->GetContents().Data();
+#endif
+
+    encoder->WriteUInt8(BO::ArrayBuffer);
+    WriteLength(encoder, byte_length, true);
+    encoder->PushPayload(array_buffer, byte_length, data);
+}
+
+/**
+ * Write `BO::Reference` if `value` was already written in the message. Otherwise it's
+ * numbered, so it's later occurrences can refer to it. Records are never referenced
+ */
+static bool WriteReference(Encoder* encoder, Local<Value> value) {
+    uint32_t id;
+
+    if(!encoder->IsReferencing() || !encoder->FindReference(value, &id))
+        return false;
+
+    encoder->WriteUInt8(BO::Reference);
+    WriteLength(encoder, id);
+    return true;
+}
+
+void WriteValue(Encoder* encoder, Local<Value> value) {
+    Local<Context> context = Nan::GetCurrentContext();
+    if(CheckCustomType(encoder, value))
+        return;
+
+    if(value->IsArrayBufferView()) {
+        WriteTypedArray(encoder, value);
+    } else if(value->IsArrayBuffer()) {
+        WriteArrayBuffer(encoder, Local<ArrayBuffer>::Cast(value));
+    } else if(value->IsBoolean()) {
+        Local<Boolean> boolean = Local<Boolean>::Cast(value);
+
+        encoder->WriteUInt8(BO::Boolean);
+
+        if(boolean->Value())
+            encoder->WriteUInt8(1);
+        else
+            encoder->WriteUInt8(0);
+    } else if(value->IsUndefined()) {
+        encoder->WriteUInt8(BO::Undefined);
+    } else if(value->IsNull()) {
+        encoder->WriteUInt8(BO::Null);
+    } else if(value->IsMap()) {
+        if(WriteReference(encoder, value))
+            return;
+
+        SizedContainer sized;
+        BeginSized(encoder, &sized);
+
+        encoder->WriteUInt8(BO::Map);
+        WriteNativeMap(encoder, Local<Map>::Cast(value));
+
+        EndSized(encoder, &sized);
+    } else if(value->IsDate()) {
+        Local<Date> date = Local<Date>::Cast(value);
+
+        encoder->WriteUInt8(BO::Date);
+        encoder->WriteDoubleLE(date->ValueOf());
+    } else if(value->IsArray()) {
+        Local<Array> list = Local<Array>::Cast(value);
+
+        if(!WriteReference(encoder, list))
+            WriteArray(encoder, list);
+    } else if(value->IsNumber()) {
+        WriteNumber(encoder, value->ToNumber(context).ToLocalChecked());
+    } else if(value->IsBigInt()) {
+        WriteBigInt(encoder, Local<BigInt>::Cast(value));
+    } else if(value->IsString()) {
+        Local<String> string = value->ToString(context).ToLocalChecked();
+
+        if(string->Length() >= (int) encoder->GetReferenceMinLength() && WriteReference(encoder, string))
+            return;
+
+        WriteStringValue(encoder, string);
+    } else if(value->IsObject()) {
+        Local<Object> object = value->ToObject(context).ToLocalChecked();
+        ObjectSchema* schema = encoder->GetSchemas()->Match(object);
+
+        if(schema != nullptr)
+            WriteRecord(encoder, schema, object);
+        else if(!WriteReference(encoder, object))
+            WriteObject(encoder, object);
+    } else {
+        Nan::ThrowError("Invalid value type");
+    }
+}
+
+void WriteHeader(Encoder* encoder) {
+    if(encoder->GetFormat() != BO::Format::V1) {
+        encoder->WriteUInt8(BO::Format::Header);
+        encoder->WriteUInt8(encoder->GetFormat());
+    }
+}
+
+void WriteMessage(Encoder* encoder, Local<Value> value, ObjectSchema* schema) {
+    WriteHeader(encoder);
+
+    if(encoder->IsUsingReferences()) {
+        encoder->WriteUInt8(BO::Shared);
+        WriteLength(encoder, encoder->GetReferenceMinLength());
+        encoder->BeginReferences();
+    }
+
+    if(schema != nullptr)
+        WriteRecord(encoder, schema, value);
+    else
+        WriteValue(encoder, value);
+
+    encoder->EndReferences();
+}
+
+/**
+ * Records are written with their byte length, so readers can step over them without their schema
+ */
+void WriteRecord(Encoder* encoder, ObjectSchema* schema, Local<Value> value) {
+    if(!encoder->BeginRecord(value, schema->GetId()))
+        return;
+
+    encoder->WriteUInt8(BO::Record);
+    encoder->WriteUInt8(schema->GetId());
+
+    size_t patch = encoder->ReserveUInt32LE();
+    size_t start = encoder->OutputOffset();
+    bool written = schema->Write(encoder, value);
+
+    encoder->EndRecord();
+
+    if(!written)
+        return;
+
+    size_t byte_length = encoder->OutputOffset() - start;
+
+    if(byte_length > UINT32_MAX) {
+        Nan::ThrowError("Record is too big");
+        return;
+    }
+
+    encoder->PatchUInt32LE(patch, (uint32_t) byte_length);
+}
+
+void WriteObject(Encoder* encoder, Local<Object> object) {
+    Local<Array> properties = Nan::GetOwnPropertyNames(object).ToLocalChecked();
+    Local<Context> context = Nan::GetCurrentContext();
+    uint32_t length = properties->Length();
+    SizedContainer sized;
+
+    BeginSized(encoder, &sized);
+    
+    encoder->WriteUInt8(BO::Object);
+    WriteLength(encoder, length);
+
+    for(uint32_t i = 0; i < length; i++){
+        Local<String> name = Nan::Get(properties, i).ToLocalChecked()->ToString(context).ToLocalChecked();
+
+        WriteString(encoder, name);
+        WriteValue(encoder, Nan::Get(object, name).ToLocalChecked());
+    }
+
+    EndSized(encoder, &sized);
+}
+
+void Encoder::SetCurrentHolder(Local<Object> n) {
+    holder = n;
+}
+
+Local<Object> Encoder::GetHolder() {
+    return holder;
+}
+
+bool Encoder::IsNodeBuffer(Local<Value> value) {
+    return value->IsUint8Array() && Local<Object>::Cast(value)->GetPrototype()->StrictEquals(Nan::New(buffer_prototype));
+}
+
+CustomType::Table* Encoder::GetCustomTypes() {
+    return &types;
+}
+
+std::vector<uint8_t>& Encoder::GetScratch() {
+    return scratch;
+}
+
+std::vector<double>& Encoder::GetNumbers() {
+    return numbers;
+}
+
+SchemaTable* Encoder::GetSchemas() {
+    return &schemas;
+}
+
+bool Encoder::IsPackingArrays() {
+    return packed_arrays;
+}
+
+bool Encoder::IsSizingContainers() {
+    return sized_containers;
+}
+
+bool Encoder::IsColumnar() {
+    return columnar;
+}
+
+bool Encoder::IsUsingReferences() {
+    return references;
+}
+
+uint32_t Encoder::GetReferenceMinLength() {
+    return reference_min_length;
+}
+
+void Encoder::BeginReferences() {
+    reference_ids = Map::New(Isolate::GetCurrent());
+    reference_count = 0;
+}
+
+void Encoder::EndReferences() {
+    reference_ids.Clear();
+}
+
+bool Encoder::IsReferencing() {
+    return !reference_ids.IsEmpty();
+}
+
+bool Encoder::FindReference(Local<Value> value, uint32_t* id) {
+    Local<Context> context = Nan::GetCurrentContext();
+    Local<Value> found = reference_ids->Get(context, value).ToLocalChecked();
+
+    if(found->IsUint32()) {
+        *id = Local<Uint32>::Cast(found)->Value();
+        return true;
+    }
+
+    reference_ids->Set(context, value, Nan::New<Uint32>(reference_count++)).ToLocalChecked();
+    return false;
+}
+
+bool Encoder::BeginRecord(Local<Value> value, uint8_t schema_id) {
+    for(Local<Value> record : open_records) {
+        if(record->StrictEquals(value)) {
+            Nan::ThrowError(std::string("Record of schema " + std::to_string(schema_id) + " contains itself, which can't be written since records are never referenced").c_str());
+            return false;
+        }
+    }
+
+    open_records.push_back(value);
+    return true;
+}
+
+void Encoder::EndRecord() {
+    open_records.pop_back();
+}
+
+uint32_t Encoder::GetFormat() {
+    return format;
+}
+
+/**
+ * Encode value. When a schema is given as second argument value is written as a record of it
+ */
+NAN_METHOD(Encoder::Encode) {
+    Local<Value> value = info[0];
+    Encoder* encoder = Nan::ObjectWrap::Unwrap<Encoder>(info.Holder());
+    ObjectSchema* schema = nullptr;
+
+    if(!info[1]->IsUndefined() && (schema = ObjectSchema::From(info[1])) == nullptr) {
+        Nan::ThrowError("Second argument must be a schema or undefined");
+        return;
+    }
+
+    encoder->SetCurrentHolder(info.Holder());
+    encoder->Reset();
+
+    if(encoder->exact_size) {
+        Nan::TryCatch try_catch;
+        encoder->BeginMeasure();
+        WriteMessage(encoder, value, schema);
+
+        size_t byte_length = encoder->EndTarget();
+
+        if(try_catch.HasCaught()) {
+            try_catch.ReThrow();
+            return;
+        }
+
+        Local<Object> result;
+        uint8_t* buffer = encoder->AllocateOutput(byte_length, &result);
+        if(buffer == nullptr) {
+            Nan::ThrowError("Allocation failed");
+            return;
+        }
+
+        encoder->BeginTarget(buffer, byte_length);
+        WriteMessage(encoder, value, schema);
+
+        if(encoder->EndTarget() != byte_length && !try_catch.HasCaught()) {
+            Nan::ThrowError("Value changed while it was being encoded");
+            return;
+        }
+
+        if(try_catch.HasCaught()) {
+            try_catch.ReThrow();
+            return;
+        }
+
+        info.GetReturnValue().Set(result);
+        return;
+    }
+
+    WriteMessage(encoder, value, schema);
+
+    size_t byte_length = encoder->OutputLength();
+    Local<Object> result;
+
+    if(encoder->compress) {
+        if(byte_length > UINT32_MAX) {
+            encoder->Reset();
+            Nan::ThrowError("Message is too big to be compressed");
+            return;
+        }
+
+        std::vector<uint8_t>& contents = encoder->GetScratch();
+        std::vector<uint8_t> frame;
+
+        contents.resize(byte_length);
+        encoder->high_water = std::max(encoder->high_water, encoder->Length());
+        encoder->FlushSegments(contents.data());
+        BlockFrame::Write(contents.data(), byte_length, encoder->block_size, frame);
+
+        uint8_t* buffer = encoder->AllocateOutput(frame.size(), &result);
+        if(buffer == nullptr) {
+            Nan::ThrowError("Allocation failed");
+            return;
+        }
+
+        memcpy(buffer, frame.data(), frame.size());
+        encoder->Shrink();
+
+        // Messages are kept in scratch memory only while they are compressed
+        if(encoder->shrink_threshold > 0 && contents.capacity() > encoder->shrink_threshold)
+            std::vector<uint8_t>().swap(contents);
+
+        info.GetReturnValue().Set(result);
+        return;
+    }
+
+    uint8_t* buffer = encoder->AllocateOutput(byte_length, &result);
+    if(buffer == nullptr) {
+        Nan::ThrowError("Allocation failed");
+        return;
+    }
+
+    encoder->high_water = std::max(encoder->high_water, encoder->Length());
+    encoder->FlushSegments(buffer);
+    encoder->Shrink();
+    info.GetReturnValue().Set(result);
+}
+
+/**
+ * Compresses a message written by `encodeAsync()` on the thread pool, then gives it back in a buffer
+ */
+class EncodeWorker : public Nan::AsyncWorker {
+private:
+    Encoder* encoder;
+    bool compress;
+    uint32_t block_size;
+    std::vector<uint8_t> contents;
+    std::vector<uint8_t> frame;
+public:
+    EncodeWorker(Nan::Callback* callback, Encoder* encoder, Local<Object> holder, std::vector<uint8_t>& message):
+        Nan::AsyncWorker(callback, "binobject:EncodeWorker"), encoder(encoder), compress(encoder->compress),
+        block_size(encoder->block_size) {
+        SaveToPersistent("encoder", holder);
+        contents.swap(message);
+    }
+
+    void Execute() override {
+        if(compress)
+            BlockFrame::Write(contents.data(), contents.size(), block_size, frame);
+        else
+            frame.swap(contents);
+    }
+
+    void HandleOKCallback() override {
+        Local<Object> result;
+
+        encoder->SetCurrentHolder(Local<Object>::Cast(GetFromPersistent("encoder")));
+
+        uint8_t* buffer = encoder->AllocateOutput(frame.size(), &result);
+        if(buffer == nullptr) {
+            Local<Value> argv[] = { Nan::Error("Allocation failed") };
+            callback->Call(1, argv, async_resource);
+            return;
+        }
+
+        memcpy(buffer, frame.data(), frame.size());
+
+        Local<Value> argv[] = { Nan::Null(), result };
+        callback->Call(2, argv, async_resource);
+    }
+};
+
+/**
+ * Encode value like `encode()`, but compress it on the thread pool. Value is written right away, since
+ * it can't be read off the main thread, then `callback` gets the buffer as it's second argument
+ */
+NAN_METHOD(Encoder::EncodeAsync) {
+    Local<Value> value = info[0];
+    Encoder* encoder = Nan::ObjectWrap::Unwrap<Encoder>(info.Holder());
+    ObjectSchema* schema = nullptr;
+
+    if(!info[1]->IsUndefined() && (schema = ObjectSchema::From(info[1])) == nullptr) {
+        Nan::ThrowError("Second argument must be a schema or undefined");
+        return;
+    }
+
+    if(!info[2]->IsFunction()) {
+        Nan::ThrowError("Expected callback function");
+        return;
+    }
+
+    Nan::TryCatch try_catch;
+
+    encoder->SetCurrentHolder(info.Holder());
+    encoder->Reset();
+    WriteMessage(encoder, value, schema);
+
+    if(try_catch.HasCaught()) {
+        encoder->Reset();
+        try_catch.ReThrow();
+        return;
+    }
+
+    size_t byte_length = encoder->OutputLength();
+
+    if(encoder->compress && byte_length > UINT32_MAX) {
+        encoder->Reset();
+        Nan::ThrowError("Message is too big to be compressed");
+        return;
+    }
+
+    // Message gets a copy of it's own, since the encoder is free to write the next one before the worker is done
+    std::vector<uint8_t> message(byte_length);
+
+    encoder->high_water = std::max(encoder->high_water, encoder->Length());
+    encoder->FlushSegments(message.data());
+    encoder->Shrink();
+
+    Nan::Callback* callback = new Nan::Callback(Local<Function>::Cast(info[2]));
+    Nan::AsyncQueueWorker(new EncodeWorker(callback, encoder, info.Holder(), message));
+}
+
+/**
+ * Encode every element of `values` as a message of it's own, one after the other in a single buffer.
+ * Gives back `{ buffer, offsets }`, where message `i` takes the bytes from `offsets[i]` to `offsets[i + 1]`
+ */
+NAN_METHOD(Encoder::EncodeMany) {
+    Encoder* encoder = Nan::ObjectWrap::Unwrap<Encoder>(info.Holder());
+
+    if(!encoder->CheckUncompressed("encodeMany()"))
+        return;
+
+    if(!info[0]->IsArray()) {
+        Nan::ThrowError("First argument must be an array");
+        return;
+    }
+
+    Local<Array> values = Local<Array>::Cast(info[0]);
+    uint32_t length = values->Length();
+    Local<ArrayBuffer> offsets_buffer = ArrayBuffer::New(Isolate::GetCurrent(), ((size_t) length + 1) * sizeof(uint32_t));
+    Local<Value> offsets = Uint32Array::New(offsets_buffer, 0, (size_t) length + 1);
+    uint32_t* offsets_data = (uint32_t*) node::Buffer::Data(offsets);
+    Nan::TryCatch try_catch;
+
+    encoder->SetCurrentHolder(info.Holder());
+    encoder->Reset();
+
+    for(uint32_t i = 0; i < length; i++) {
+        offsets_data[i] = (uint32_t) encoder->OutputOffset();
+        WriteMessage(encoder, Nan::Get(values, i).ToLocalChecked());
+
+        if(try_catch.HasCaught()) {
+            encoder->Reset();
+            try_catch.ReThrow();
+            return;
+        }
+    }
+
+    size_t byte_length = encoder->OutputLength();
+
+    if(byte_length > UINT32_MAX) {
+        encoder->Reset();
+        Nan::ThrowError("Messages take more than 4 GiB");
+        return;
+    }
+
+    offsets_data[length] = (uint32_t) byte_length;
+
+    Local<Object> buffer;
+    uint8_t* output = encoder->AllocateOutput(byte_length, &buffer);
+    if(output == nullptr) {
+        Nan::ThrowError("Allocation failed");
+        return;
+    }
+
+    encoder->high_water = std::max(encoder->high_water, encoder->Length());
+    encoder->FlushSegments(output);
+    encoder->Shrink();
+
+    Local<Object> result = Nan::New<Object>();
+
+    Nan::Set(result, Nan::New("buffer").ToLocalChecked(), buffer);
+    Nan::Set(result, Nan::New("offsets").ToLocalChecked(), offsets);
+    info.GetReturnValue().Set(result);
+}
+
+/**
+ * Encode value straight into `buffer` starting at `offset`. Returns the amount of bytes written or, if
+ * value does not fit, a negative number telling how many more bytes are needed. In that case contents
+ * of `buffer` after `offset` are undefined
+ */
+NAN_METHOD(Encoder::EncodeInto) {
+    Local<Value> value = info[0];
+    Local<Value> buffer = info[1];
+    Encoder* encoder = Nan::ObjectWrap::Unwrap<Encoder>(info.Holder());
+
+    if(!encoder->CheckUncompressed("encodeInto()"))
+        return;
+
+    if(!buffer->IsArrayBufferView()) {
+        Nan::ThrowError("Second argument must be a buffer");
+        return;
+    }
+
+    size_t byte_length = node::Buffer::Length(buffer);
+    size_t offset = 0;
+
+    if(!info[2]->IsUndefined()) {
+        if(!info[2]->IsUint32() || Nan::To<uint32_t>(info[2]).FromJust() > byte_length) {
+            Nan::ThrowError("Offset must be a positive integer within buffer length");
+            return;
+        }
+        offset = Nan::To<uint32_t>(info[2]).FromJust();
+    }
+
+    encoder->SetCurrentHolder(info.Holder());
+    encoder->Reset();
+    encoder->BeginTarget((uint8_t*) node::Buffer::Data(buffer) + offset, byte_length - offset);
+
+    WriteMessage(encoder, value);
+
+    size_t written = encoder->EndTarget();
+
+    if(written > byte_length - offset)
+        info.GetReturnValue().Set(-((double) (written - (byte_length - offset))));
+    else
+        info.GetReturnValue().Set((double) written);
+}
+
+/**
+ * Get the exact amount of bytes `encode()` would give back for value, without writing it
+ */
+NAN_METHOD(Encoder::Measure) {
+    Local<Value> value = info[0];
+    Encoder* encoder = Nan::ObjectWrap::Unwrap<Encoder>(info.Holder());
+
+    // Compressed size is only known by compressing
+    if(!encoder->CheckUncompressed("measure()"))
+        return;
+
+    encoder->SetCurrentHolder(info.Holder());
+    encoder->Reset();
+    encoder->BeginMeasure();
+
+    WriteMessage(encoder, value);
+
+    info.GetReturnValue().Set((double) encoder->EndTarget());
+}
+
+/**
+ * Encode value into a list of buffers. Payloads above `zeroCopyThreshold` are given back as
+ * slices of the original memory, so they must not be changed until the list is written
+ */
+NAN_METHOD(Encoder::EncodeVectored) {
+    Local<Value> value = info[0];
+    Encoder* encoder = Nan::ObjectWrap::Unwrap<Encoder>(info.Holder());
+
+    if(!encoder->CheckUncompressed("encodeVectored()"))
+        return;
+
+    encoder->SetCurrentHolder(info.Holder());
+    encoder->Reset();
+
+    WriteMessage(encoder, value);
+
+    encoder->high_water = std::max(encoder->high_water, encoder->Length());
+    info.GetReturnValue().Set(encoder->FlushVectored());
+    encoder->Shrink();
+}
+
+void Encoder::Init(Local<Object> exports) {
+    Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+    tpl->SetClassName(Nan::New("ObjectEncoder").ToLocalChecked());
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
 
     Nan::SetPrototypeMethod(tpl, "encode", Encode);
+    Nan::SetPrototypeMethod(tpl, "encodeAsync", EncodeAsync);
+    Nan::SetPrototypeMethod(tpl, "encodeMany", EncodeMany);
+    Nan::SetPrototypeMethod(tpl, "encodeVectored", EncodeVectored);
+    Nan::SetPrototypeMethod(tpl, "encodeInto", EncodeInto);
+    Nan::SetPrototypeMethod(tpl, "measure", Measure);
 
     Nan::Set(exports, Nan::New("ObjectEncoder").ToLocalChecked(), Nan::GetFunction(tpl).ToLocalChecked());
 }
 
+bool Encoder::ReadOptions(Local<Value> options) {
+    if(!Options::GetUint32(options, "zeroCopyThreshold", &zero_copy_threshold) ||
+        !Options::GetUint32(options, "initialCapacity", &initial_capacity) ||
+        !Options::GetUint32(options, "shrinkThreshold", &shrink_threshold) ||
+        !Options::GetUint32(options, "arenaSize", &arena_size) ||
+        !Options::GetBoolean(options, "exactSize", &exact_size) ||
+        !Options::GetBoolean(options, "packedArrays", &packed_arrays) ||
+        !Options::GetBoolean(options, "sizedContainers", &sized_containers) ||
+        !Options::GetBoolean(options, "columnar", &columnar) ||
+        !Options::GetBoolean(options, "references", &references) ||
+        !Options::GetUint32(options, "referenceMinLength", &reference_min_length) ||
+        !Options::GetBoolean(options, "compress", &compress) ||
+        !Options::GetUint32(options, "blockSize", &block_size) ||
+        !schemas.Read(options) ||
+        !Options::GetUint32(options, "format", &format))
+        return false;
+
+    if(block_size == 0) {
+        Nan::ThrowError("Block size must be greater than zero");
+        return false;
+    }
+
+    // Messages are compressed out of their complete contents, so they can't be measured first
+    if(compress && exact_size) {
+        Nan::ThrowError("Options `compress` and `exactSize` can't be used together");
+        return false;
+    }
+
+    if(format != BO::Format::V1 && format != BO::Format::V2) {
+        Nan::ThrowError("Format must be either 1 or 2");
+        return false;
+    }
+
+    return true;
+}
+
+bool Encoder::CheckUncompressed(const char* method) {
+    if(compress) {
+        Nan::ThrowError(std::string("Option `compress` only applies to encode() and encodeAsync(), not to " + std::string(method)).c_str());
+        return false;
+    }
+
+    return true;
+}
+
 NAN_METHOD(Encoder::New) {
     Local<Value> value = info[0];
 
-    if(info.Length() > 0 && !value->IsArray())
+    if(info.Length() > 0 && !value->IsArray() && !value->IsUndefined()) {
         Nan::ThrowError("First argument must be an array or undefined");
-    else if(value->IsArray())
+        return;
+    } else if(value->IsArray()) {
         Nan::Set(info.This(), Nan::New<String>("instructions").ToLocalChecked(), info[0]);
+    }
+
+    if(!Options::Check(info[1]))
+        return;
 
     Encoder* encoder = new Encoder();
     encoder->Wrap(info.This());
+    encoder->buffer_prototype.Reset(Nan::NewBuffer(0).ToLocalChecked()->GetPrototype());
+
+    if(!encoder->GetCustomTypes()->Compile(value, CustomType::ForEncoding) || !encoder->ReadOptions(info[1]))
+        return;
+
+    encoder->Reserve(encoder->initial_capacity);
 
     info.GetReturnValue().Set(info.This());
 }
@@ -2,6 +2,10 @@
 #define NODE_ENCODER_H_
 
 #include <nan.h>
+#include <vector>
+#include "custom-type.h"
+#include "node-binobject.h"
+#include "object-schema.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -13,7 +17,23 @@ extern "C" {
 
 using namespace v8;
 
+/**
+ * Binary payload which is referenced instead of being copied into the serializer
+ */
+struct EncoderSegment {
+    /**
+     * Serializer offset where the payload belongs
+     */
+    size_t offset;
+    Local<Value> view;
+    const uint8_t* data;
+    size_t byte_length;
+};
+
 class Encoder : public Nan::ObjectWrap {
+    friend class StreamEncoder;
+    friend class RecordWriter;
+    friend class EncodeWorker;
 private:
     mff_serializer* encoder = nullptr;
     Encoder();
@@ -22,7 +42,108 @@ private:
     static Nan::Persistent<Function> constructor;
     static NAN_METHOD(New);
     static NAN_METHOD(Encode);
+    static NAN_METHOD(EncodeAsync);
+    static NAN_METHOD(EncodeMany);
+    static NAN_METHOD(EncodeVectored);
+    static NAN_METHOD(EncodeInto);
+    static NAN_METHOD(Measure);
+    /**
+     * Read options shared by every kind of encoder. Throws and returns false if any of them is invalid
+     */
+    bool ReadOptions(Local<Value> options);
+    /**
+     * Throw and return false if messages are compressed, which only `encode()` and `encodeAsync()` do. `method` is named in the error
+     */
+    bool CheckUncompressed(const char* method);
     Local<Object> holder;
+    CustomType::Table types;
+    SchemaTable schemas;
+    std::vector<uint8_t> scratch;
+    std::vector<double> numbers;
+    std::vector<EncoderSegment> segments;
+    /**
+     * Total length of the payloads in `segments`
+     */
+    size_t segments_length = 0;
+    /**
+     * Payloads with at least this amount of bytes are referenced
+     * instead of copied. Zero means payloads are always copied
+     */
+    uint32_t zero_copy_threshold = 16384;
+    /**
+     * When set, values are written straight into this memory instead of the serializer. Writes
+     * past `target_length` are only counted, so the missing amount of bytes is known
+     */
+    uint8_t* target = nullptr;
+    size_t target_length = 0;
+    size_t target_offset = 0;
+    /**
+     * Serializer storage reserved when the encoder is created and after it is shrunk
+     */
+    uint32_t initial_capacity = 0;
+    /**
+     * Serializer storage is released after a call which needed more than this
+     * amount of bytes. Zero means storage is never released
+     */
+    uint32_t shrink_threshold = 4194304;
+    size_t high_water = 0;
+    /**
+     * Bytes serializer storage is known to have room for, so they can be written in place
+     */
+    size_t capacity = 0;
+    /**
+     * Small outputs are slices of a shared buffer of `arena_size` bytes, so
+     * they don't need an allocation each. Zero means arena is not used, which
+     * is the default as every output then has an `ArrayBuffer` of it's own
+     */
+    uint32_t arena_size = 0;
+    /**
+     * Measure values before encoding them, so output is allocated
+     * once and written directly, without going through the serializer
+     */
+    bool exact_size = false;
+    /**
+     * Write arrays of numbers as `BO::PackedArray`. Off by default, so output stays readable by
+     * versions which don't know about it
+     */
+    bool packed_arrays = false;
+    /**
+     * Write objects, arrays and maps as `BO::Sized`, so they can be skipped without being read
+     */
+    bool sized_containers = false;
+    /**
+     * Write arrays of objects with the same keys as `BO::Columns`
+     */
+    bool columnar = false;
+    /**
+     * Write objects, arrays, maps and strings of at least `reference_min_length` characters
+     * which were already written in the same message as `BO::Reference`
+     */
+    bool references = false;
+    uint32_t reference_min_length = 8;
+    /**
+     * Number of each value which can be referenced in the message being written. Empty when references are not in use
+     */
+    Local<Map> reference_ids;
+    uint32_t reference_count = 0;
+    /**
+     * Records being written, outermost first, so records which contain themselves are found
+     */
+    std::vector<Local<Value>> open_records;
+    /**
+     * Give back messages of `encode()` and `encodeAsync()` as compressed frames of blocks of `block_size` bytes
+     */
+    bool compress = false;
+    uint32_t block_size = 131072;
+    uint32_t format = BO::Format::V1;
+    Nan::Persistent<Object> arena;
+    /**
+     * `Buffer.prototype`, so Node buffers can be told apart from plain `Uint8Array`
+     */
+    Nan::Persistent<Value> buffer_prototype;
+    uint8_t* arena_data = nullptr;
+    size_t arena_offset = 0;
+    void WriteTarget(const void* data, size_t length);
 
 public:
     static void Init(Local<Object> exports);
@@ -31,12 +152,85 @@ public:
 
     void SetCurrentHolder(Local<Object> holder);
     Local<Object> GetHolder();
+    CustomType::Table* GetCustomTypes();
+    SchemaTable* GetSchemas();
+    std::vector<uint8_t>& GetScratch();
+    std::vector<double>& GetNumbers();
+    bool IsPackingArrays();
+    bool IsSizingContainers();
+    bool IsColumnar();
+    bool IsUsingReferences();
+    uint32_t GetReferenceMinLength();
+    /**
+     * Start numbering the values of a message, so they can be referenced
+     */
+    void BeginReferences();
+    void EndReferences();
+    bool IsReferencing();
+    /**
+     * Find out the number of `value` if it was already written. Otherwise it's given the next number and false is returned
+     */
+    bool FindReference(Local<Value> value, uint32_t* id);
+    /**
+     * Start writing `value` as a record. Records are never referenced, so one which contains itself
+     * would be written endlessly: it throws and returns false if `value` is already being written
+     */
+    bool BeginRecord(Local<Value> value, uint8_t schema_id);
+    void EndRecord();
+    uint32_t GetFormat();
 
+    /**
+     * Discard anything written by a previous call which failed
+     */
+    void Reset();
+    /**
+     * Make sure serializer storage has room for at least `capacity` bytes
+     */
+    void Reserve(size_t capacity);
+    /**
+     * Release serializer storage if the last call went beyond the shrink threshold
+     */
+    void Shrink();
+    /**
+     * Write into `length` bytes of `memory` instead of the serializer until `EndTarget` is called
+     */
+    void BeginTarget(uint8_t* memory, size_t length);
+    /**
+     * Count bytes of the values written until `EndTarget` is called without writing them anywhere
+     */
+    void BeginMeasure();
+    /**
+     * Stop writing into target memory and return how many bytes were needed
+     */
+    size_t EndTarget();
+    /**
+     * Create output buffer of `byte_length` bytes. Returns the memory behind it
+     */
+    uint8_t* AllocateOutput(size_t byte_length, Local<Object>* result);
     /**
      * Copy current serializer contents to buffer and move
      * offset to zero
      */
     void FlushContents(void*);
+    /**
+     * Copy serializer contents and referenced payloads to
+     * buffer and move offset to zero
+     */
+    void FlushSegments(void*);
+    /**
+     * Total length of the output including referenced payloads
+     */
+    size_t OutputLength();
+    /**
+     * Position of the next byte written in the final output
+     */
+    size_t OutputOffset();
+    bool IsNodeBuffer(Local<Value> value);
+    /**
+     * Build a list of buffers with serializer contents and slices of
+     * the referenced payloads, in order, and move offset to zero
+     */
+    Local<Array> FlushVectored();
     void WriteInt8(int8_t n);
     void WriteDoubleLE(double n);
     void WriteFloatLE(float n);
@@ -45,14 +239,52 @@ public:
     void WriteUInt32LE(uint32_t n);
     void WriteInt16LE(int16_t n);
     void WriteInt32LE(int32_t n);
+    void WriteInt64LE(int64_t n);
+    void WriteUInt64LE(uint64_t n);
+    void WriteVarint(uint64_t n);
+    /**
+     * Write 4 bytes which are filled in later by `PatchUInt32LE`. Returns where they are
+     */
+    size_t ReserveUInt32LE();
+    void PatchUInt32LE(size_t offset, uint32_t n);
     void PushBuffer(size_t string_length, uint8_t* buffer);
+    /**
+     * Make room for `length` bytes at the end of the output and give back where they are, so they are
+     * written in place. Gives back nullptr if they only count, because target memory has no room for them
+     */
+    uint8_t* Claim(size_t length);
+    /**
+     * Write binary payload owned by `view`. Large payloads are referenced
+     * and only copied when the final output is built
+     */
+    void PushPayload(Local<Value> view, size_t byte_length, const uint8_t* buffer);
 };
 
 void WriteCompressedNumber(Encoder*, double);
+/**
+ * Write string without it's type, as object keys are
+ */
+void WriteString(Encoder* encoder, Local<String> value);
+/**
+ * Write length of a string or container. Format 1 wrote some of them as 32-bit integers, which `wide` keeps
+ */
+void WriteLength(Encoder* encoder, size_t length, bool wide = false);
+/**
+ * Write format header, if the format has one
+ */
+void WriteHeader(Encoder* encoder);
+/**
+ * Write format header, if there is one, and value. If `schema` is given value is written as a record of it
+ */
+void WriteMessage(Encoder* encoder, Local<Value> value, ObjectSchema* schema = nullptr);
 void WriteNumber(Encoder* encoder, Local<Number> value);
+void WriteBigInt(Encoder* encoder, Local<BigInt> value);
 
 void WriteValue(Encoder* encoder, Local<Value> value);
 void WriteObject(Encoder* encoder, Local<Object> object);
+void WriteRecord(Encoder* encoder, ObjectSchema* schema, Local<Value> value);
+void WriteTypedArray(Encoder* encoder, Local<Value> value);
+void WriteArrayBuffer(Encoder* encoder, Local<ArrayBuffer> array_buffer);
 
 bool CheckCustomType(Encoder* encoder, Local<Value> value);
 
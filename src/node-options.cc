@@ -0,0 +1,123 @@
+#include "node-options.h"
+
+static Local<Value> GetOption(Local<Value> options, const char* name) {
+    if(!options->IsObject())
+        return Nan::Undefined();
+
+    return Nan::Get(Local<Object>::Cast(options), Nan::New(name).ToLocalChecked()).ToLocalChecked();
+}
+
+bool Options::Check(Local<Value> options) {
+    if(!options->IsUndefined() && !options->IsObject()) {
+        Nan::ThrowError("Options must be an object or undefined");
+        return false;
+    }
+    return true;
+}
+
+bool Options::GetUint32(Local<Value> options, const char* name, uint32_t* result) {
+    Local<Value> value = GetOption(options, name);
+
+    if(value->IsUndefined())
+        return true;
+
+    if(!value->IsUint32()) {
+        Nan::ThrowError(std::string("Option `" + std::string(name) + "` must be a positive integer").c_str());
+        return false;
+    }
+
+    *result = Nan::To<uint32_t>(value).FromJust();
+    return true;
+}
+
+bool Options::GetBoolean(Local<Value> options, const char* name, bool* result) {
+    Local<Value> value = GetOption(options, name);
+
+    if(value->IsUndefined())
+        return true;
+
+    if(!value->IsBoolean()) {
+        Nan::ThrowError(std::string("Option `" + std::string(name) + "` must be a boolean").c_str());
+        return false;
+    }
+
+    *result = Nan::To<bool>(value).FromJust();
+    return true;
+}
+
+bool Options::GetEnum(Local<Value> options, const char* name, const char* const* names, uint8_t count, uint8_t* result) {
+    Local<Value> value = GetOption(options, name);
+
+    if(value->IsUndefined())
+        return true;
+
+    std::string expected;
+
+    if(value->IsString()) {
+        std::string string = *Nan::Utf8String(value);
+
+        for(uint8_t i = 0; i < count; i++) {
+            if(string == names[i]) {
+                *result = i;
+                return true;
+            }
+        }
+    }
+
+    for(uint8_t i = 0; i < count; i++)
+        expected += std::string(i > 0 ? ", " : "") + names[i];
+
+    Nan::ThrowError(std::string("Option `" + std::string(name) + "` must be one of: " + expected).c_str());
+    return false;
+}
+
+bool Options::GetFunction(Local<Value> options, const char* name, Local<Function>* result) {
+    Local<Value> value = GetOption(options, name);
+
+    if(value->IsUndefined())
+        return true;
+
+    if(!value->IsFunction()) {
+        Nan::ThrowError(std::string("Option `" + std::string(name) + "` must be a function").c_str());
+        return false;
+    }
+
+    *result = Local<Function>::Cast(value);
+    return true;
+}
+
+bool Options::GetStringList(Local<Value> options, const char* name, std::vector<std::string>* result) {
+    Local<Value> value = GetOption(options, name);
+
+    if(value->IsUndefined())
+        return true;
+
+    std::string message = "Option `" + std::string(name) + "` must be an array of strings";
+
+    if(!value->IsArray()) {
+        Nan::ThrowError(message.c_str());
+        return false;
+    }
+
+    Local<Array> list = Local<Array>::Cast(value);
+    std::vector<std::string> strings;
+
+    if(list->Length() == 0) {
+        Nan::ThrowError(std::string("Option `" + std::string(name) + "` must not be empty").c_str());
+        return false;
+    }
+
+    for(uint32_t i = 0; i < list->Length(); i++) {
+        Local<Value> item = Nan::Get(list, i).ToLocalChecked();
+
+        if(!item->IsString()) {
+            Nan::ThrowError(message.c_str());
+            return false;
+        }
+
+        strings.push_back(*Nan::Utf8String(item));
+    }
+
+    result->swap(strings);
+    return true;
+}
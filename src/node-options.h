@@ -0,0 +1,30 @@
+#ifndef NODE_OPTIONS_H_
+#define NODE_OPTIONS_H_
+
+#include <nan.h>
+#include <string>
+#include <vector>
+
+using namespace v8;
+
+/**
+ * Helpers to read the options object given to encoder and decoder constructors.
+ * All of them keep `result` untouched when the option is not defined, and throw
+ * returning false when it has an invalid value
+ */
+namespace Options {
+    bool Check(Local<Value> options);
+    bool GetUint32(Local<Value> options, const char* name, uint32_t* result);
+    bool GetBoolean(Local<Value> options, const char* name, bool* result);
+    /**
+     * Read string option which must be one of `count` `names`. `result` is set to it's index
+     */
+    bool GetEnum(Local<Value> options, const char* name, const char* const* names, uint8_t count, uint8_t* result);
+    bool GetFunction(Local<Value> options, const char* name, Local<Function>* result);
+    /**
+     * Read array of strings option. `result` is only changed when it's defined, and empty arrays are rejected
+     */
+    bool GetStringList(Local<Value> options, const char* name, std::vector<std::string>* result);
+}
+
+#endif
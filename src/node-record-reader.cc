@@ -0,0 +1,216 @@
+#include "node-record-reader.h"
+#include "node-binobject.h"
+#include "node-options.h"
+#include "block-codec.h"
+
+#include <nan.h>
+
+using namespace v8;
+
+RecordReader::RecordReader(): values(new Decoder(0, nullptr)) {}
+
+RecordReader::~RecordReader() {
+    Unmap();
+    delete values;
+}
+
+/**
+ * Drop a reference to the mapping, unmapping it after the last one
+ */
+static void ReleaseMapping(char*, void* hint) {
+    SharedMapping* shared = (SharedMapping*) hint;
+
+    if(--shared->references > 0)
+        return;
+
+    RecordLog::Unmap(shared->mapping.data, shared->mapping.length);
+    delete shared;
+}
+
+void RecordReader::Unmap() {
+    values->source.Reset();
+#if V8_MAJOR_VERSION >= 8
+    values->backing_store.reset();
+#endif
+
+    if(data != nullptr) {
+        ReleaseMapping(nullptr, data);
+        data = nullptr;
+    }
+
+    RecordLog::Unmap(index.data, index.length);
+    index.data = nullptr;
+    index.length = 0;
+}
+
+size_t RecordReader::Count() {
+    return layout.indexed + layout.tail.size();
+}
+
+Local<Object> RecordReader::NewView(const uint8_t* message, size_t length) {
+    data->references++;
+    return Nan::NewBuffer((char*) message, length, ReleaseMapping, data).ToLocalChecked();
+}
+
+const uint8_t* RecordReader::GetMessage(Local<Value> number, size_t* length) {
+    if(data == nullptr) {
+        Nan::ThrowError("Record log was closed");
+        return nullptr;
+    }
+
+    if(!number->IsUint32() || Nan::To<uint32_t>(number).FromJust() >= Count()) {
+        Nan::ThrowError("Record number is out of range");
+        return nullptr;
+    }
+
+    size_t i = Nan::To<uint32_t>(number).FromJust();
+    uint64_t offset = i < layout.indexed ? RecordLog::ReadUInt64LE(index.data + i * 8) : layout.tail[i - layout.indexed];
+    const uint8_t* log = data->mapping.data;
+    size_t log_length = data->mapping.length;
+
+    // Only the end of the index is checked when the log is opened, so entries before it could point anywhere
+    if(offset < RecordLog::header_length || offset > log_length || log_length - offset < RecordLog::prefix_length ||
+        RecordLog::RecordLength(RecordLog::ReadUInt32LE(log + offset)) > log_length - offset) {
+        Nan::ThrowError("Record index points outside of the log");
+        return nullptr;
+    }
+
+    const uint8_t* message = log + offset + RecordLog::prefix_length;
+
+    *length = RecordLog::ReadUInt32LE(log + offset);
+
+    if(verify_checksums && BlockCodec::Checksum(message, *length) != RecordLog::ReadUInt32LE(log + offset + 4)) {
+        Nan::ThrowError("Record doesn't match it's checksum");
+        return nullptr;
+    }
+
+    return message;
+}
+
+/**
+ * Amount of records in the log
+ */
+NAN_METHOD(RecordReader::Count) {
+    RecordReader* reader = Nan::ObjectWrap::Unwrap<RecordReader>(info.Holder());
+
+    info.GetReturnValue().Set(Nan::New<Number>((double) reader->Count()));
+}
+
+/**
+ * Give back the encoded message of a record, as a view of the mapped log
+ */
+NAN_METHOD(RecordReader::Record) {
+    RecordReader* reader = Nan::ObjectWrap::Unwrap<RecordReader>(info.Holder());
+    size_t length;
+    const uint8_t* message = reader->GetMessage(info[0], &length);
+
+    if(message == nullptr)
+        return;
+
+    info.GetReturnValue().Set(reader->NewView(message, length));
+}
+
+/**
+ * Read value of a record. With the `zeroCopy` and `externalStrings` options it's buffers
+ * and strings are backed by the mapped log, which stays mapped as long as they are used
+ */
+NAN_METHOD(RecordReader::Decode) {
+    RecordReader* reader = Nan::ObjectWrap::Unwrap<RecordReader>(info.Holder());
+    Decoder* values = reader->values;
+    size_t length;
+    const uint8_t* message = reader->GetMessage(info[0], &length);
+
+    if(message == nullptr)
+        return;
+
+    values->SetInput((uint8_t*) message, length);
+
+    // Views are only made when something could be backed by the log, as every one of them is tracked by the garbage collector
+    if(values->zero_copy || values->external_strings > 0) {
+        Local<ArrayBufferView> view = Local<ArrayBufferView>::Cast(reader->NewView(message, length));
+
+        values->source.Reset(view->Buffer());
+        values->source_offset = view->ByteOffset();
+#if V8_MAJOR_VERSION >= 8
+        values->backing_store.reset();
+#endif
+    }
+
+    values->SetCurrentHolder(info.Holder());
+    values->ReadHeader();
+
+    Local<Value> result = ReadValue(values);
+
+    if(values->key_cache == KeyCacheLifetime::Call)
+        values->keys.Clear();
+
+    info.GetReturnValue().Set(result);
+}
+
+/**
+ * Stop reading the log. It's unmapped once buffers and strings backed by it are gone too
+ */
+NAN_METHOD(RecordReader::Close) {
+    RecordReader* reader = Nan::ObjectWrap::Unwrap<RecordReader>(info.Holder());
+
+    reader->Unmap();
+}
+
+NAN_METHOD(RecordReader::New) {
+    Local<Value> instructions = info[1];
+
+    if(!info[0]->IsString()) {
+        Nan::ThrowError("First argument must be a path");
+        return;
+    }
+
+    if(!instructions->IsUndefined() && !instructions->IsArray()) {
+        Nan::ThrowError("Second argument must be an array or undefined");
+        return;
+    }
+
+    if(!Options::Check(info[2]))
+        return;
+
+    RecordReader* reader = new RecordReader();
+    reader->Wrap(info.This());
+
+    Nan::Set(info.This(), Nan::New("instructions").ToLocalChecked(), instructions);
+
+    if(!reader->values->GetCustomTypes()->Compile(instructions, CustomType::ForDecoding) ||
+        !reader->values->ReadOptions(info[2]) ||
+        !Options::GetBoolean(info[2], "verifyChecksums", &reader->verify_checksums))
+        return;
+
+    std::string path = *Nan::Utf8String(info[0]);
+    reader->data = new SharedMapping();
+
+    RecordLog::Mapping& contents = reader->data->mapping;
+    const char* error = RecordLog::Map(path, false, &contents);
+
+    if(error == nullptr && (error = RecordLog::Map(RecordLog::IndexPath(path), true, &reader->index)) == nullptr)
+        error = contents.length == 0 ? "File is not a record log" :
+            RecordLog::Recover(contents.data, contents.length, reader->index.data, reader->index.length, &reader->layout);
+
+    if(error != nullptr) {
+        reader->Unmap();
+        reader->layout = RecordLog::Layout();
+        Nan::ThrowError(error);
+        return;
+    }
+
+    info.GetReturnValue().Set(info.This());
+}
+
+void RecordReader::Init(Local<Object> exports) {
+    Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+    tpl->SetClassName(Nan::New("RecordLogReader").ToLocalChecked());
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+    Nan::SetPrototypeMethod(tpl, "count", Count);
+    Nan::SetPrototypeMethod(tpl, "record", Record);
+    Nan::SetPrototypeMethod(tpl, "decode", Decode);
+    Nan::SetPrototypeMethod(tpl, "close", Close);
+
+    Nan::Set(exports, Nan::New("RecordLogReader").ToLocalChecked(), Nan::GetFunction(tpl).ToLocalChecked());
+}
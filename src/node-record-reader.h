@@ -0,0 +1,53 @@
+#ifndef NODE_RECORD_READER_H_
+#define NODE_RECORD_READER_H_
+
+#include <nan.h>
+#include "node-decoder.h"
+#include "record-log.h"
+
+using namespace v8;
+
+/**
+ * Mapped log which is shared by the reader and the buffers given back by it, and is unmapped once all of them are gone
+ */
+struct SharedMapping {
+    RecordLog::Mapping mapping;
+    size_t references = 1;
+};
+
+/**
+ * Reads records of a log which is mapped into memory. Records are found by their number through the index, so any
+ * of them is read without going through the ones before it. Records appended after the reader was opened are not seen
+ */
+class RecordReader : public Nan::ObjectWrap {
+private:
+    Decoder* values;
+    SharedMapping* data = nullptr;
+    RecordLog::Mapping index;
+    RecordLog::Layout layout;
+    /**
+     * Check records against their checksum before reading them
+     */
+    bool verify_checksums = false;
+    RecordReader();
+    ~RecordReader();
+    static NAN_METHOD(New);
+    static NAN_METHOD(Count);
+    static NAN_METHOD(Record);
+    static NAN_METHOD(Decode);
+    static NAN_METHOD(Close);
+    /**
+     * Find message of the record whose number was given to a method. Throws and returns nullptr if there is no such record
+     */
+    const uint8_t* GetMessage(Local<Value> number, size_t* length);
+    /**
+     * Create buffer over `length` bytes of the mapping at `data`, which keeps the mapping alive
+     */
+    Local<Object> NewView(const uint8_t* message, size_t length);
+    size_t Count();
+    void Unmap();
+public:
+    static void Init(Local<Object> exports);
+};
+
+#endif
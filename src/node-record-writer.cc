@@ -0,0 +1,334 @@
+#include "node-record-writer.h"
+#include "node-binobject.h"
+#include "node-options.h"
+#include "record-log.h"
+#include "block-codec.h"
+
+#include <nan.h>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace v8;
+
+RecordWriter::RecordWriter(): values(new Encoder()) {}
+
+RecordWriter::~RecordWriter() {
+    // Records are kept if the writer is collected without being closed, but errors can't be reported anymore
+    if(fd != -1) {
+        WritePending();
+        close(fd);
+        close(index_fd);
+    }
+
+    delete values;
+}
+
+/**
+ * Write `length` bytes of `data` at `offset` of the file, however many calls it takes
+ */
+static bool WriteAll(int fd, const uint8_t* data, size_t length, uint64_t offset) {
+    while(length > 0) {
+        ssize_t written = pwrite(fd, data, length, (off_t) offset);
+
+        if(written < 0) {
+            if(errno == EINTR)
+                continue;
+
+            return false;
+        }
+
+        data += written;
+        length -= (size_t) written;
+        offset += (uint64_t) written;
+    }
+
+    return true;
+}
+
+bool RecordWriter::Open(const std::string& path) {
+    std::string index_path = RecordLog::IndexPath(path);
+    RecordLog::Mapping data;
+    RecordLog::Mapping index;
+    RecordLog::Layout layout;
+    const char* error = RecordLog::Map(path, true, &data);
+
+    if(error == nullptr && (error = RecordLog::Map(index_path, true, &index)) == nullptr)
+        error = RecordLog::Recover(data.data, data.length, index.data, index.length, &layout);
+
+    RecordLog::Unmap(data.data, data.length);
+    RecordLog::Unmap(index.data, index.length);
+
+    if(error != nullptr) {
+        Nan::ThrowError(error);
+        return false;
+    }
+
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    index_fd = open(index_path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+
+    if(fd == -1 || index_fd == -1) {
+        if(fd != -1)
+            close(fd);
+        if(index_fd != -1)
+            close(index_fd);
+
+        fd = index_fd = -1;
+        Nan::ThrowError("Failed to open record log");
+        return false;
+    }
+
+    std::vector<uint8_t> tail(layout.tail.size() * 8);
+
+    for(size_t i = 0; i < layout.tail.size(); i++)
+        RecordLog::WriteUInt64LE(tail.data() + i * 8, layout.tail[i]);
+
+    // Anything after the last complete record was cut short, and so are index entries pointing past it
+    if(ftruncate(fd, (off_t) layout.end) != 0 || ftruncate(index_fd, (off_t) (layout.indexed * 8)) != 0 ||
+        (data.length == 0 && !WriteAll(fd, RecordLog::header, RecordLog::header_length, 0)) ||
+        !WriteAll(index_fd, tail.data(), tail.size(), layout.indexed * 8)) {
+        Nan::ThrowError("Failed to recover record log");
+        return false;
+    }
+
+    file_length = layout.end;
+    index_length = (layout.indexed + layout.tail.size()) * 8;
+    count = layout.indexed + layout.tail.size();
+    return true;
+}
+
+bool RecordWriter::IsOpen() {
+    if(fd == -1) {
+        Nan::ThrowError("Record log was closed");
+        return false;
+    }
+
+    return true;
+}
+
+bool RecordWriter::Add(Local<Value> value) {
+    size_t start = values->Length();
+    Nan::TryCatch try_catch;
+    size_t length_offset = values->ReserveUInt32LE();
+    size_t checksum_offset = values->ReserveUInt32LE();
+
+    WriteMessage(values, value);
+
+    if(try_catch.HasCaught()) {
+        // Leave out whatever was written of the record
+        values->encoder->offset = start;
+        try_catch.ReThrow();
+        return false;
+    }
+
+    size_t message_length = values->Length() - start - RecordLog::prefix_length;
+
+    if(message_length > UINT32_MAX) {
+        values->encoder->offset = start;
+        Nan::ThrowError("Record is too big");
+        return false;
+    }
+
+    const uint8_t* message = (const uint8_t*) values->encoder->buffer + start + RecordLog::prefix_length;
+
+    values->PatchUInt32LE(length_offset, (uint32_t) message_length);
+    values->PatchUInt32LE(checksum_offset, BlockCodec::Checksum(message, message_length));
+
+    while(values->Length() % 8 != 0)
+        values->WriteUInt8(0);
+
+    uint8_t entry[8];
+
+    RecordLog::WriteUInt64LE(entry, file_length + start);
+    pending.insert(pending.end(), entry, entry + 8);
+    count++;
+    return true;
+}
+
+const char* RecordWriter::WritePending() {
+    size_t length = values->Length();
+
+    if(length == 0)
+        return nullptr;
+
+    // Writes start where the last flush ended, so a failed flush is simply repeated by the next one
+    if(!WriteAll(fd, (const uint8_t*) values->encoder->buffer, length, file_length) || (sync && fsync(fd) != 0))
+        return "Failed to write record log";
+
+    // Index entries go after their records, so they never point to records which are not in the log
+    if(!WriteAll(index_fd, pending.data(), pending.size(), index_length) || (sync && fsync(index_fd) != 0))
+        return "Failed to write record log index";
+
+    file_length += length;
+    index_length += pending.size();
+    pending.clear();
+
+    values->encoder->offset = 0;
+    values->high_water = std::max(values->high_water, length);
+    values->Shrink();
+    return nullptr;
+}
+
+/**
+ * Append record holding `value`, and write buffered records if they reached `flushThreshold`. Returns the number of the record
+ */
+NAN_METHOD(RecordWriter::Append) {
+    RecordWriter* writer = Nan::ObjectWrap::Unwrap<RecordWriter>(info.Holder());
+
+    if(!writer->IsOpen())
+        return;
+
+    writer->values->SetCurrentHolder(info.Holder());
+
+    if(!writer->Add(info[0]))
+        return;
+
+    size_t record = writer->count - 1;
+
+    if(writer->values->Length() >= writer->flush_threshold) {
+        const char* error = writer->WritePending();
+
+        if(error != nullptr) {
+            Nan::ThrowError(error);
+            return;
+        }
+    }
+
+    info.GetReturnValue().Set(Nan::New<Number>((double) record));
+}
+
+/**
+ * Append a record for each element of an array. Returns the number of the first one. If an
+ * element can't be written, the records before it stay in the log
+ */
+NAN_METHOD(RecordWriter::AppendMany) {
+    RecordWriter* writer = Nan::ObjectWrap::Unwrap<RecordWriter>(info.Holder());
+
+    if(!writer->IsOpen())
+        return;
+
+    if(!info[0]->IsArray()) {
+        Nan::ThrowError("Expected array of values");
+        return;
+    }
+
+    Local<Array> elements = Local<Array>::Cast(info[0]);
+    uint32_t length = elements->Length();
+    size_t first = writer->count;
+
+    writer->values->SetCurrentHolder(info.Holder());
+
+    for(uint32_t i = 0; i < length; i++) {
+        if(!writer->Add(Nan::Get(elements, i).ToLocalChecked()))
+            return;
+
+        if(writer->values->Length() >= writer->flush_threshold) {
+            const char* error = writer->WritePending();
+
+            if(error != nullptr) {
+                Nan::ThrowError(error);
+                return;
+            }
+        }
+    }
+
+    info.GetReturnValue().Set(Nan::New<Number>((double) first));
+}
+
+/**
+ * Write buffered records to the log
+ */
+NAN_METHOD(RecordWriter::Flush) {
+    RecordWriter* writer = Nan::ObjectWrap::Unwrap<RecordWriter>(info.Holder());
+
+    if(!writer->IsOpen())
+        return;
+
+    const char* error = writer->WritePending();
+
+    if(error != nullptr)
+        Nan::ThrowError(error);
+}
+
+/**
+ * Amount of records in the log, including buffered ones
+ */
+NAN_METHOD(RecordWriter::Count) {
+    RecordWriter* writer = Nan::ObjectWrap::Unwrap<RecordWriter>(info.Holder());
+
+    info.GetReturnValue().Set(Nan::New<Number>((double) writer->count));
+}
+
+/**
+ * Write buffered records and close the log. Closing it again does nothing
+ */
+NAN_METHOD(RecordWriter::Close) {
+    RecordWriter* writer = Nan::ObjectWrap::Unwrap<RecordWriter>(info.Holder());
+
+    if(writer->fd == -1)
+        return;
+
+    const char* error = writer->WritePending();
+
+    close(writer->fd);
+    close(writer->index_fd);
+    writer->fd = writer->index_fd = -1;
+
+    if(error != nullptr)
+        Nan::ThrowError(error);
+}
+
+NAN_METHOD(RecordWriter::New) {
+    Local<Value> instructions = info[1];
+
+    if(!info[0]->IsString()) {
+        Nan::ThrowError("First argument must be a path");
+        return;
+    }
+
+    if(!instructions->IsUndefined() && !instructions->IsArray()) {
+        Nan::ThrowError("Second argument must be an array or undefined");
+        return;
+    }
+
+    if(!Options::Check(info[2]))
+        return;
+
+    RecordWriter* writer = new RecordWriter();
+    writer->Wrap(info.This());
+
+    Nan::Set(info.This(), Nan::New("instructions").ToLocalChecked(), instructions);
+    writer->values->buffer_prototype.Reset(Nan::NewBuffer(0).ToLocalChecked()->GetPrototype());
+
+    if(!writer->values->GetCustomTypes()->Compile(instructions, CustomType::ForEncoding) ||
+        !writer->values->ReadOptions(info[2]) ||
+        !Options::GetUint32(info[2], "flushThreshold", &writer->flush_threshold) ||
+        !Options::GetBoolean(info[2], "sync", &writer->sync))
+        return;
+
+    if(!writer->values->CheckUncompressed("record logs"))
+        return;
+
+    // Records are copied to the file anyway, so payloads are never referenced
+    writer->values->zero_copy_threshold = 0;
+
+    if(!writer->Open(*Nan::Utf8String(info[0])))
+        return;
+
+    info.GetReturnValue().Set(info.This());
+}
+
+void RecordWriter::Init(Local<Object> exports) {
+    Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+    tpl->SetClassName(Nan::New("RecordLogWriter").ToLocalChecked());
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+    Nan::SetPrototypeMethod(tpl, "append", Append);
+    Nan::SetPrototypeMethod(tpl, "appendMany", AppendMany);
+    Nan::SetPrototypeMethod(tpl, "flush", Flush);
+    Nan::SetPrototypeMethod(tpl, "count", Count);
+    Nan::SetPrototypeMethod(tpl, "close", Close);
+
+    Nan::Set(exports, Nan::New("RecordLogWriter").ToLocalChecked(), Nan::GetFunction(tpl).ToLocalChecked());
+}
@@ -0,0 +1,65 @@
+#ifndef NODE_RECORD_WRITER_H_
+#define NODE_RECORD_WRITER_H_
+
+#include <nan.h>
+#include <string>
+#include <vector>
+#include "node-encoder.h"
+
+using namespace v8;
+
+/**
+ * Appends messages to a record log. Records are written into the serializer one after the other and
+ * go to the file, followed by their index entries, when enough of them are buffered or on `flush()`.
+ * Opening an existing log carries on after it's last complete record, and adds records which are
+ * missing from the index. Only one writer may have a log open at a time
+ */
+class RecordWriter : public Nan::ObjectWrap {
+private:
+    Encoder* values;
+    int fd = -1;
+    int index_fd = -1;
+    /**
+     * Bytes of the log and it's index which are in the files
+     */
+    uint64_t file_length = 0;
+    uint64_t index_length = 0;
+    /**
+     * Index entries of the buffered records
+     */
+    std::vector<uint8_t> pending;
+    size_t count = 0;
+    /**
+     * Buffered records are written once they take at least this amount of bytes
+     */
+    uint32_t flush_threshold = 1048576;
+    /**
+     * Wait for the files to reach the disk on every flush
+     */
+    bool sync = false;
+    RecordWriter();
+    ~RecordWriter();
+    static NAN_METHOD(New);
+    static NAN_METHOD(Append);
+    static NAN_METHOD(AppendMany);
+    static NAN_METHOD(Flush);
+    static NAN_METHOD(Count);
+    static NAN_METHOD(Close);
+    /**
+     * Open log at `path`, creating it if needed. Throws and returns false if it can't be opened
+     */
+    bool Open(const std::string& path);
+    /**
+     * Add record holding `value` to the buffered ones. Throws and returns false if it can't be written
+     */
+    bool Add(Local<Value> value);
+    /**
+     * Write buffered records and their index entries. Returns an error message or nullptr
+     */
+    const char* WritePending();
+    bool IsOpen();
+public:
+    static void Init(Local<Object> exports);
+};
+
+#endif
@@ -0,0 +1,364 @@
+#include "node-stream-decoder.h"
+#include "node-binobject.h"
+#include "node-options.h"
+#include "value-scanner.h"
+
+#include <nan.h>
+
+using namespace v8;
+
+StreamFrame::~StreamFrame() {
+    container.Reset();
+    key.Reset();
+}
+
+StreamDecoder::StreamDecoder(): values(new Decoder(0, nullptr)), format(BO::Format::V1) {}
+
+StreamDecoder::~StreamDecoder() {
+    for(StreamFrame* frame : frames)
+        delete frame;
+
+    on_element.Reset();
+    delete values;
+}
+
+bool StreamDecoder::Fail(const char* message) {
+    failed = true;
+    Nan::ThrowError(message);
+    return false;
+}
+
+bool StreamDecoder::Open(uint8_t type, size_t length) {
+    Local<Object> container;
+
+    // Elements of top-level arrays given to `on_element` are not kept anywhere
+    bool keep = !(type == BO::Array && frames.empty() && !on_element.IsEmpty());
+
+    if(keep) {
+        if(type == BO::Object)
+            container = Nan::New<Object>();
+        else if(type == BO::Array)
+            container = Nan::New<Array>();
+        else
+            container = Map::New(Isolate::GetCurrent());
+    }
+
+    if(length == 0) {
+        if(keep)
+            return Complete(container);
+
+        in_value = false;
+        return true;
+    }
+
+    StreamFrame* frame = new StreamFrame();
+    frame->type = type;
+    frame->length = length;
+    if(keep)
+        frame->container.Reset(container);
+    frames.push_back(frame);
+
+    return true;
+}
+
+bool StreamDecoder::Complete(Local<Value> value) {
+    Local<Context> context = Nan::GetCurrentContext();
+
+    while(true) {
+        if(frames.empty()) {
+            Nan::Set(results, results_length++, value);
+            in_value = false;
+            return true;
+        }
+
+        StreamFrame* frame = frames.back();
+
+        if(frame->type == BO::Array) {
+            if(frame->container.IsEmpty()) {
+                Local<Value> argv[] = { value, Nan::New<Number>(frame->index) };
+
+                if(Nan::Call(Nan::New(on_element), context->Global(), 2, argv).IsEmpty()) {
+                    failed = true;
+                    return false;
+                }
+            } else {
+                Nan::Set(Nan::New(frame->container), frame->index, value);
+            }
+        } else if(frame->type == BO::Object) {
+            Nan::Set(Nan::New(frame->container), Nan::New(frame->key), value);
+            frame->has_key = false;
+            frame->key.Reset();
+        } else {
+            if(!frame->has_key) {
+                frame->key.Reset(value);
+                frame->has_key = true;
+                return true;
+            }
+
+            Local<Map> map = Local<Map>::Cast(Nan::New(frame->container));
+
+            map->Set(context, Nan::New(frame->key), value).ToLocalChecked();
+            frame->has_key = false;
+            frame->key.Reset();
+        }
+
+        if(++frame->index < frame->length)
+            return true;
+
+        bool kept = !frame->container.IsEmpty();
+
+        if(kept)
+            value = Nan::New(frame->container);
+
+        frames.pop_back();
+        delete frame;
+
+        if(!kept) {
+            in_value = false;
+            return true;
+        }
+    }
+}
+
+size_t StreamDecoder::Parse(uint8_t* data, size_t length) {
+    size_t position = 0;
+
+    values->SetInput(data, length);
+
+    while(!failed) {
+        uint8_t* current = data + position;
+        size_t available = length - position;
+        size_t consumed;
+        size_t item_length;
+        uint8_t result;
+
+        if(!in_value) {
+            if(available == 0)
+                break;
+
+            if(current[0] == BO::Format::Header) {
+                // Could still be a custom type using the header byte as it's code
+                if(available < 2)
+                    break;
+
+                if(current[1] == BO::Format::V2) {
+                    format = BO::Format::V2;
+                    position += 2;
+                    in_value = true;
+                    continue;
+                }
+
+                // Blocks are checked and decompressed as a whole, so frames are given to `ObjectDecoder` instead
+                if(current[1] == BO::Format::Compressed) {
+                    Fail("Compressed frames can't be read as a stream");
+                    break;
+                }
+            }
+
+            format = BO::Format::V1;
+            in_value = true;
+        }
+
+        StreamFrame* frame = frames.empty() ? nullptr : frames.back();
+
+        if(frame != nullptr && frame->type == BO::Object && !frame->has_key) {
+            result = Scanner::ParseLength(current, available, format, &consumed, &item_length);
+
+            if(result == Scanner::Invalid) {
+                Fail("Got invalid object key length");
+                break;
+            }
+
+            if(result == Scanner::NeedMore || item_length > available - consumed)
+                break;
+
+            frame->key.Reset(values->NewKey(current + consumed, item_length));
+            frame->has_key = true;
+            position += consumed + item_length;
+            continue;
+        }
+
+        if(available == 0)
+            break;
+
+        uint8_t type = current[0];
+
+        // Containers are read as they arrive, so their byte length is not needed
+        if(type == BO::Sized) {
+            if(available < 5)
+                break;
+
+            position += 5;
+            continue;
+        }
+
+        if(type == BO::Object || type == BO::Array || type == BO::Map) {
+            result = Scanner::ParseLength(current + 1, available - 1, format, &consumed, &item_length);
+
+            if(result == Scanner::Invalid) {
+                Fail("Got invalid container length");
+                break;
+            }
+
+            if(result == Scanner::NeedMore)
+                break;
+
+            position += 1 + consumed;
+
+            if(!Open(type, item_length))
+                break;
+            continue;
+        }
+
+        // Columns are only read once all of them arrived, as objects need a cell out of each of them. Shared
+        // values are read whole too, as references can point to anything read before them
+        if(type == BO::Columns || type == BO::Dictionary || type == BO::Shared)
+            result = Scanner::Skip(current, available, format, values->GetCustomTypes(), &item_length);
+        else
+            result = Scanner::ParseLeaf(current, available, format, values->GetCustomTypes()->Find(type) != nullptr, &item_length);
+
+        if(result == Scanner::Invalid) {
+            Fail(std::string("Got invalid value type: " + std::to_string(type)).c_str());
+            break;
+        }
+
+        if(result == Scanner::NeedMore)
+            break;
+
+        Local<Value> value;
+
+        {
+            Nan::TryCatch try_catch;
+
+            values->SetFormat(format);
+            values->Seek(position);
+            value = ReadValue(values);
+
+            if(try_catch.HasCaught()) {
+                failed = true;
+                try_catch.ReThrow();
+                break;
+            }
+        }
+
+        position += item_length;
+
+        if(!Complete(value))
+            break;
+    }
+
+    return position;
+}
+
+/**
+ * Read `chunk` and give back a list of the top-level values completed by it. Bytes of
+ * a value which is not complete yet are kept until the next chunk arrives
+ */
+NAN_METHOD(StreamDecoder::Write) {
+    StreamDecoder* stream = Nan::ObjectWrap::Unwrap<StreamDecoder>(info.Holder());
+    Local<Value> chunk = info[0];
+
+    if(stream->failed) {
+        Nan::ThrowError("Decoder can't be used after it failed to read input");
+        return;
+    }
+
+    if(!chunk->IsArrayBufferView()) {
+        Nan::ThrowError("Expected buffer");
+        return;
+    }
+
+    uint8_t* data = (uint8_t*) node::Buffer::Data(chunk);
+    size_t length = node::Buffer::Length(chunk);
+    std::vector<uint8_t>& pending = stream->pending;
+    bool direct = pending.size() == stream->pending_offset;
+
+    stream->results = Nan::New<Array>();
+    stream->results_length = 0;
+
+    if(direct) {
+        pending.clear();
+        stream->pending_offset = 0;
+    } else {
+        // Only move what is left when something was read, so a big value arriving
+        // in many chunks is appended to instead of being moved every time
+        if(stream->pending_offset > 0) {
+            pending.erase(pending.begin(), pending.begin() + stream->pending_offset);
+            stream->pending_offset = 0;
+        }
+
+        pending.insert(pending.end(), data, data + length);
+        data = pending.data();
+        length = pending.size();
+    }
+
+    size_t consumed = stream->Parse(data, length);
+
+    if(direct)
+        pending.assign(data + consumed, data + length);
+    else
+        stream->pending_offset = consumed;
+
+    if(stream->values->key_cache == KeyCacheLifetime::Call)
+        stream->values->keys.Clear();
+
+    if(stream->failed)
+        return;
+
+    info.GetReturnValue().Set(stream->results);
+}
+
+/**
+ * Tell there is no more input. Throws if the last value is not complete
+ */
+NAN_METHOD(StreamDecoder::End) {
+    StreamDecoder* stream = Nan::ObjectWrap::Unwrap<StreamDecoder>(info.Holder());
+
+    if(stream->in_value || !stream->frames.empty() || stream->pending.size() > stream->pending_offset) {
+        Nan::ThrowError("Input ended before the last value was complete");
+        return;
+    }
+}
+
+NAN_METHOD(StreamDecoder::New) {
+    Local<Value> instructions = info[0];
+    Local<Function> on_element;
+
+    if(!instructions->IsUndefined() && !instructions->IsArray()) {
+        Nan::ThrowError("First argument must be an array or undefined");
+        return;
+    }
+
+    if(!Options::Check(info[1]))
+        return;
+
+    StreamDecoder* stream = new StreamDecoder();
+    stream->Wrap(info.This());
+
+    Nan::Set(info.This(), Nan::New("instructions").ToLocalChecked(), instructions);
+
+    if(!stream->values->GetCustomTypes()->Compile(instructions, CustomType::ForDecoding) ||
+        !stream->values->ReadOptions(info[1]) ||
+        !Options::GetFunction(info[1], "onElement", &on_element))
+        return;
+
+    // Chunks are only around while they are read, so nothing can point to them
+    stream->values->zero_copy = false;
+    stream->values->external_strings = 0;
+
+    if(!on_element.IsEmpty())
+        stream->on_element.Reset(on_element);
+
+    info.GetReturnValue().Set(info.This());
+}
+
+void StreamDecoder::Init(Local<Object> exports) {
+    Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+    tpl->SetClassName(Nan::New("ObjectStreamDecoder").ToLocalChecked());
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+    Nan::SetPrototypeMethod(tpl, "write", Write);
+    Nan::SetPrototypeMethod(tpl, "end", End);
+
+    Nan::Set(exports, Nan::New("ObjectStreamDecoder").ToLocalChecked(), Nan::GetFunction(tpl).ToLocalChecked());
+}
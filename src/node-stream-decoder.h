@@ -0,0 +1,75 @@
+#ifndef NODE_STREAM_DECODER_H_
+#define NODE_STREAM_DECODER_H_
+
+#include <nan.h>
+#include <vector>
+#include "node-decoder.h"
+
+using namespace v8;
+
+/**
+ * Object, array or map whose contents are still being read
+ */
+struct StreamFrame {
+    uint8_t type;
+    size_t length;
+    size_t index = 0;
+    /**
+     * Object key or map key which is waiting for it's value
+     */
+    bool has_key = false;
+    Nan::Persistent<Object> container;
+    Nan::Persistent<Value> key;
+    ~StreamFrame();
+};
+
+/**
+ * Decoder which is fed with chunks of input as they arrive. Containers being read are kept in
+ * a list of frames instead of the call stack, so reading can stop at the end of any chunk and
+ * carry on with the next one. Only the bytes of the value being read when a chunk ends are kept
+ */
+class StreamDecoder : public Nan::ObjectWrap {
+private:
+    /**
+     * Reads values which are complete in the input, such as numbers and strings
+     */
+    Decoder* values;
+    std::vector<StreamFrame*> frames;
+    std::vector<uint8_t> pending;
+    size_t pending_offset = 0;
+    /**
+     * True after the header of the top-level value being read is known
+     */
+    bool in_value = false;
+    uint8_t format;
+    bool failed = false;
+    /**
+     * Elements of top-level arrays are given to this function instead of being kept
+     */
+    Nan::Persistent<Function> on_element;
+    Local<Array> results;
+    uint32_t results_length;
+    StreamDecoder();
+    ~StreamDecoder();
+    static NAN_METHOD(New);
+    static NAN_METHOD(Write);
+    static NAN_METHOD(End);
+    /**
+     * Read as many values as possible out of `length` bytes of `data`. Returns
+     * how many bytes were used. Throws and sets `failed` if input is not valid
+     */
+    size_t Parse(uint8_t* data, size_t length);
+    /**
+     * Start reading container of `type` with `length` items
+     */
+    bool Open(uint8_t type, size_t length);
+    /**
+     * Add value to the container being read, closing every container which is complete after it
+     */
+    bool Complete(Local<Value> value);
+    bool Fail(const char* message);
+public:
+    static void Init(Local<Object> exports);
+};
+
+#endif
@@ -0,0 +1,157 @@
+#include "node-stream-encoder.h"
+#include "node-binobject.h"
+#include "node-options.h"
+
+#include <nan.h>
+#include <algorithm>
+
+using namespace v8;
+
+StreamEncoder::StreamEncoder(): values(new Encoder()) {}
+
+StreamEncoder::~StreamEncoder() {
+    delete values;
+}
+
+Local<Array> StreamEncoder::TakeChunks(bool all) {
+    Local<Array> chunks = Nan::New<Array>();
+    uint8_t* data = (uint8_t*) values->encoder->buffer;
+    size_t length = values->Length();
+    size_t offset = 0;
+    uint32_t index = 0;
+
+    for(; length - offset >= chunk_size; offset += chunk_size)
+        Nan::Set(chunks, index++, Nan::CopyBuffer((const char*) data + offset, chunk_size).ToLocalChecked());
+
+    if(all && length > offset) {
+        Nan::Set(chunks, index++, Nan::CopyBuffer((const char*) data + offset, length - offset).ToLocalChecked());
+        offset = length;
+    }
+
+    if(offset > 0) {
+        memmove(data, data + offset, length - offset);
+        values->encoder->offset = length - offset;
+    }
+
+    values->high_water = std::max(values->high_water, length);
+    return chunks;
+}
+
+/**
+ * Write header of an array of `length` elements. It's elements are written by the next calls to `write()`
+ */
+NAN_METHOD(StreamEncoder::WriteArrayHeader) {
+    StreamEncoder* stream = Nan::ObjectWrap::Unwrap<StreamEncoder>(info.Holder());
+
+    if(stream->remaining > 0) {
+        Nan::ThrowError("Previous array has elements which were not written yet");
+        return;
+    }
+
+    if(!info[0]->IsUint32()) {
+        Nan::ThrowError("Array length must be a positive integer");
+        return;
+    }
+
+    stream->remaining = Nan::To<uint32_t>(info[0]).FromJust();
+
+    WriteHeader(stream->values);
+    stream->values->WriteUInt8(BO::Array);
+    WriteLength(stream->values, stream->remaining, true);
+
+    info.GetReturnValue().Set(stream->TakeChunks(false));
+}
+
+/**
+ * Write value, either as an element of the array being written or as a top-level value
+ * of it's own. Gives back the chunks which were completed by it
+ */
+NAN_METHOD(StreamEncoder::Write) {
+    StreamEncoder* stream = Nan::ObjectWrap::Unwrap<StreamEncoder>(info.Holder());
+    Encoder* encoder = stream->values;
+    size_t offset = encoder->Length();
+    Nan::TryCatch try_catch;
+
+    encoder->SetCurrentHolder(info.Holder());
+
+    if(stream->remaining > 0)
+        WriteValue(encoder, info[0]);
+    else
+        WriteMessage(encoder, info[0]);
+
+    if(try_catch.HasCaught()) {
+        // Leave out whatever was written of the value
+        encoder->encoder->offset = offset;
+        try_catch.ReThrow();
+        return;
+    }
+
+    if(stream->remaining > 0)
+        stream->remaining--;
+
+    info.GetReturnValue().Set(stream->TakeChunks(false));
+}
+
+/**
+ * Give back what is left of the output. Throws if an array still has elements to be written
+ */
+NAN_METHOD(StreamEncoder::End) {
+    StreamEncoder* stream = Nan::ObjectWrap::Unwrap<StreamEncoder>(info.Holder());
+
+    if(stream->remaining > 0) {
+        Nan::ThrowError(std::string(std::to_string(stream->remaining) + " elements of the array were not written").c_str());
+        return;
+    }
+
+    info.GetReturnValue().Set(stream->TakeChunks(true));
+    stream->values->Shrink();
+}
+
+NAN_METHOD(StreamEncoder::New) {
+    Local<Value> instructions = info[0];
+
+    if(!instructions->IsUndefined() && !instructions->IsArray()) {
+        Nan::ThrowError("First argument must be an array or undefined");
+        return;
+    }
+
+    if(!Options::Check(info[1]))
+        return;
+
+    StreamEncoder* stream = new StreamEncoder();
+    stream->Wrap(info.This());
+
+    Nan::Set(info.This(), Nan::New("instructions").ToLocalChecked(), instructions);
+    stream->values->buffer_prototype.Reset(Nan::NewBuffer(0).ToLocalChecked()->GetPrototype());
+
+    if(!stream->values->GetCustomTypes()->Compile(instructions, CustomType::ForEncoding) ||
+        !stream->values->ReadOptions(info[1]) ||
+        !Options::GetUint32(info[1], "chunkSize", &stream->chunk_size))
+        return;
+
+    if(!stream->values->CheckUncompressed("stream encoders"))
+        return;
+
+    if(stream->chunk_size == 0) {
+        Nan::ThrowError("Option `chunkSize` must be greater than zero");
+        return;
+    }
+
+    // Chunks are copied out of the serializer anyway, so payloads are never referenced
+    stream->values->zero_copy_threshold = 0;
+    stream->values->Reserve(std::max((size_t) stream->values->initial_capacity, (size_t) stream->chunk_size));
+
+    info.GetReturnValue().Set(info.This());
+}
+
+void StreamEncoder::Init(Local<Object> exports) {
+    Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+    tpl->SetClassName(Nan::New("ObjectStreamEncoder").ToLocalChecked());
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+    Nan::SetPrototypeMethod(tpl, "writeArrayHeader", WriteArrayHeader);
+    Nan::SetPrototypeMethod(tpl, "write", Write);
+    Nan::SetPrototypeMethod(tpl, "end", End);
+
+    Nan::Set(exports, Nan::New("ObjectStreamEncoder").ToLocalChecked(), Nan::GetFunction(tpl).ToLocalChecked());
+}
@@ -0,0 +1,37 @@
+#ifndef NODE_STREAM_ENCODER_H_
+#define NODE_STREAM_ENCODER_H_
+
+#include <nan.h>
+#include "node-encoder.h"
+
+using namespace v8;
+
+/**
+ * Encoder which gives back it's output in chunks of a fixed size as values are written, so
+ * memory taken by it does not depend on the size of the output. An array can be written by
+ * writing it's header first and then each one of it's elements
+ */
+class StreamEncoder : public Nan::ObjectWrap {
+private:
+    Encoder* values;
+    uint32_t chunk_size = 65536;
+    /**
+     * Elements of the top-level array which were not written yet
+     */
+    size_t remaining = 0;
+    StreamEncoder();
+    ~StreamEncoder();
+    static NAN_METHOD(New);
+    static NAN_METHOD(WriteArrayHeader);
+    static NAN_METHOD(Write);
+    static NAN_METHOD(End);
+    /**
+     * Move contents out of the serializer in chunks of `chunk_size` bytes. If `all` is
+     * true what is left is given back too, otherwise it is kept for the next chunk
+     */
+    Local<Array> TakeChunks(bool all);
+public:
+    static void Init(Local<Object> exports);
+};
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef NUMBER_SCAN_H_
+#define NUMBER_SCAN_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "node-binobject.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace NumberScan {
+    /**
+     * Check if `n` is an integer in the range of a 32-bit signed integer
+     */
+    inline bool IsInt32(double n) {
+        return n >= -2147483648.0 && n <= 2147483647.0 && n == (double) (int32_t) n;
+    }
+
+    /**
+     * Check if `n` does not change when it is stored as a float
+     */
+    inline bool IsFloat(double n) {
+        return n != n || (double) (float) n == n;
+    }
+
+#if !defined(__SSE2__) && defined(__ARM_NEON) && defined(__aarch64__)
+    inline uint64x2_t IsNaN(float64x2_t values) {
+        return vreinterpretq_u64_u32(vmvnq_u32(vreinterpretq_u32_u64(vceqq_f64(values, values))));
+    }
+#endif
+
+    /**
+     * Find the narrowest number type which holds every value exactly. Returns one of the
+     * integer types up to `BO::Int32`, `BO::Float` or `BO::Double`. Integers and floats
+     * are checked and minimum and maximum are kept two values at a time when SIMD is available
+     */
+    inline uint8_t Classify(const double* values, size_t length) {
+        bool integers = true;
+        bool floats = true;
+        double min = 0;
+        double max = 0;
+        size_t i = 0;
+
+        if(length == 0)
+            return BO::UInt8;
+
+#if defined(__SSE2__)
+        if(length >= 2) {
+            __m128d min_values = _mm_loadu_pd(values);
+            __m128d max_values = min_values;
+            __m128d integer_mask = _mm_castsi128_pd(_mm_set1_epi32(-1));
+            __m128d float_mask = integer_mask;
+
+            for(; i + 2 <= length; i += 2) {
+                __m128d chunk = _mm_loadu_pd(values + i);
+                // Values out of 32-bit range are converted to INT32_MIN, so they are not equal after converting back
+                __m128d truncated = _mm_cvtepi32_pd(_mm_cvttpd_epi32(chunk));
+                __m128d narrowed = _mm_cvtps_pd(_mm_cvtpd_ps(chunk));
+
+                integer_mask = _mm_and_pd(integer_mask, _mm_cmpeq_pd(chunk, truncated));
+                float_mask = _mm_and_pd(float_mask, _mm_or_pd(_mm_cmpeq_pd(chunk, narrowed), _mm_cmpunord_pd(chunk, chunk)));
+                min_values = _mm_min_pd(min_values, chunk);
+                max_values = _mm_max_pd(max_values, chunk);
+
+                if(_mm_movemask_pd(_mm_or_pd(integer_mask, float_mask)) != 3)
+                    return BO::Double;
+            }
+
+            double lanes[2];
+
+            integers = _mm_movemask_pd(integer_mask) == 3;
+            floats = _mm_movemask_pd(float_mask) == 3;
+            _mm_storeu_pd(lanes, min_values);
+            min = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+            _mm_storeu_pd(lanes, max_values);
+            max = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+        } else {
+            min = max = values[0];
+        }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        if(length >= 2) {
+            float64x2_t min_values = vld1q_f64(values);
+            float64x2_t max_values = min_values;
+            uint64x2_t integer_mask = vdupq_n_u64(~0ULL);
+            uint64x2_t float_mask = integer_mask;
+
+            for(; i + 2 <= length; i += 2) {
+                float64x2_t chunk = vld1q_f64(values + i);
+                float64x2_t narrowed = vcvt_f64_f32(vcvt_f32_f64(chunk));
+
+                integer_mask = vandq_u64(integer_mask, vceqq_f64(chunk, vrndq_f64(chunk)));
+                float_mask = vandq_u64(float_mask, vorrq_u64(vceqq_f64(chunk, narrowed), IsNaN(chunk)));
+                min_values = vminq_f64(min_values, chunk);
+                max_values = vmaxq_f64(max_values, chunk);
+            }
+
+            integers = (vgetq_lane_u64(integer_mask, 0) & vgetq_lane_u64(integer_mask, 1)) != 0;
+            floats = (vgetq_lane_u64(float_mask, 0) & vgetq_lane_u64(float_mask, 1)) != 0;
+            min = vminvq_f64(min_values);
+            max = vmaxvq_f64(max_values);
+            integers = integers && min >= -2147483648.0 && max <= 2147483647.0;
+        } else {
+            min = max = values[0];
+        }
+#else
+        min = max = values[0];
+#endif
+
+        for(; i < length; i++) {
+            integers = integers && IsInt32(values[i]);
+            floats = floats && IsFloat(values[i]);
+
+            if(values[i] < min)
+                min = values[i];
+            if(values[i] > max)
+                max = values[i];
+        }
+
+        if(integers) {
+            if(min >= 0 && max <= 0xff)
+                return BO::UInt8;
+            else if(min >= -0x80 && max <= 0x7f)
+                return BO::Int8;
+            else if(min >= 0 && max <= 0xffff)
+                return BO::UInt16;
+            else if(min >= -0x8000 && max <= 0x7fff)
+                return BO::Int16;
+            return BO::Int32;
+        }
+
+        return floats ? BO::Float : BO::Double;
+    }
+
+    /**
+     * Amount of bytes taken by each element of a packed array of `type`, or zero if the type can't be packed
+     */
+    inline size_t Width(uint8_t type) {
+        switch(type) {
+            case BO::UInt8:
+            case BO::Int8:
+                return 1;
+            case BO::UInt16:
+            case BO::Int16:
+                return 2;
+            case BO::Int32:
+            case BO::Float:
+                return 4;
+            case BO::Double:
+                return 8;
+        }
+
+        return 0;
+    }
+}
+
+#endif
@@ -0,0 +1,403 @@
+#include "object-schema.h"
+#include "node-encoder.h"
+#include "node-decoder.h"
+#include "node-options.h"
+
+#include <math.h>
+
+Nan::Persistent<FunctionTemplate> ObjectSchema::tpl;
+
+static const char* const type_names[] = {
+    "any", "boolean", "int8", "uint8", "int16", "uint16", "int32", "uint32", "float", "double", "string", "date", "buffer"
+};
+
+ObjectSchema::Node::~Node() {
+    for(Node* child : children)
+        delete child;
+
+    key.Reset();
+    tpl.Reset();
+}
+
+ObjectSchema::ObjectSchema() {
+}
+
+ObjectSchema::~ObjectSchema() {
+    prototype.Reset();
+}
+
+uint8_t ObjectSchema::GetId() {
+    return id;
+}
+
+const ObjectSchema::Node* ObjectSchema::GetRoot() {
+    return &root;
+}
+
+void ObjectSchema::Retain() {
+    Ref();
+}
+
+void ObjectSchema::Release() {
+    Unref();
+}
+
+bool ObjectSchema::HasClass() {
+    return !prototype.IsEmpty();
+}
+
+bool ObjectSchema::Matches(Local<Object> object) {
+    return !prototype.IsEmpty() && object->GetPrototype()->StrictEquals(Nan::New(prototype));
+}
+
+bool ObjectSchema::Compile(Local<Value> definition, Node* node, const std::string& path) {
+    if(definition->IsString()) {
+        std::string name = *Nan::Utf8String(definition);
+
+        for(uint8_t i = 0; i < sizeof(type_names) / sizeof(type_names[0]); i++) {
+            if(name == type_names[i]) {
+                node->type = i;
+                return true;
+            }
+        }
+
+        Nan::ThrowError(std::string("Unknown type '" + name + "' at `" + path + "`").c_str());
+        return false;
+    }
+
+    if(definition->IsArray()) {
+        Local<Array> list = Local<Array>::Cast(definition);
+
+        if(list->Length() != 1) {
+            Nan::ThrowError(std::string("List at `" + path + "` must have the type of it's items only").c_str());
+            return false;
+        }
+
+        node->type = SchemaType::List;
+        node->children.push_back(new Node());
+        return Compile(Nan::Get(list, 0).ToLocalChecked(), node->children[0], path + "[]");
+    }
+
+    if(!definition->IsObject() || definition->IsFunction()) {
+        Nan::ThrowError(std::string("Invalid type at `" + path + "`").c_str());
+        return false;
+    }
+
+    Local<Object> object = Local<Object>::Cast(definition);
+    Local<Array> properties = Nan::GetOwnPropertyNames(object).ToLocalChecked();
+    Local<ObjectTemplate> record = Nan::New<ObjectTemplate>();
+
+    // Every item of a list takes at least one byte, so item counts can be checked against the input
+    if(properties->Length() == 0) {
+        Nan::ThrowError(std::string("Record at `" + path + "` must have at least one field").c_str());
+        return false;
+    }
+
+    node->type = SchemaType::Record;
+
+    for(uint32_t i = 0; i < properties->Length(); i++) {
+        Local<String> key = Nan::To<String>(Nan::Get(properties, i).ToLocalChecked()).ToLocalChecked();
+        Node* child = new Node();
+
+        node->children.push_back(child);
+        child->name = *Nan::Utf8String(key);
+        child->key.Reset(String::NewFromUtf8(Isolate::GetCurrent(), child->name.c_str(), NewStringType::kInternalized).ToLocalChecked());
+        record->Set(Nan::New(child->key), Nan::Undefined());
+
+        if(!Compile(Nan::Get(object, key).ToLocalChecked(), child, path.empty() ? child->name : path + "." + child->name))
+            return false;
+    }
+
+    node->tpl.Reset(record);
+    return true;
+}
+
+/**
+ * Check value is an integer between `min` and `max`
+ */
+static bool IsInteger(Local<Value> value, double min, double max) {
+    if(!value->IsNumber())
+        return false;
+
+    double n = Local<Number>::Cast(value)->Value();
+
+    return n >= min && n <= max && n == floor(n);
+}
+
+bool ObjectSchema::WriteNode(Encoder* encoder, Node* node, Local<Value> value) {
+    bool valid = true;
+
+    switch(node->type) {
+        case SchemaType::Any:
+            WriteValue(encoder, value);
+            break;
+        case SchemaType::Boolean:
+            if((valid = value->IsBoolean()))
+                encoder->WriteUInt8(Nan::To<bool>(value).FromJust() ? 1 : 0);
+            break;
+        case SchemaType::Int8:
+            if((valid = IsInteger(value, INT8_MIN, INT8_MAX)))
+                encoder->WriteInt8((int8_t) Local<Number>::Cast(value)->Value());
+            break;
+        case SchemaType::UInt8:
+            if((valid = IsInteger(value, 0, UINT8_MAX)))
+                encoder->WriteUInt8((uint8_t) Local<Number>::Cast(value)->Value());
+            break;
+        case SchemaType::Int16:
+            if((valid = IsInteger(value, INT16_MIN, INT16_MAX)))
+                encoder->WriteInt16LE((int16_t) Local<Number>::Cast(value)->Value());
+            break;
+        case SchemaType::UInt16:
+            if((valid = IsInteger(value, 0, UINT16_MAX)))
+                encoder->WriteUInt16LE((uint16_t) Local<Number>::Cast(value)->Value());
+            break;
+        case SchemaType::Int32:
+            if((valid = IsInteger(value, INT32_MIN, INT32_MAX)))
+                encoder->WriteInt32LE((int32_t) Local<Number>::Cast(value)->Value());
+            break;
+        case SchemaType::UInt32:
+            if((valid = IsInteger(value, 0, UINT32_MAX)))
+                encoder->WriteUInt32LE((uint32_t) Local<Number>::Cast(value)->Value());
+            break;
+        case SchemaType::Float:
+            if((valid = value->IsNumber()))
+                encoder->WriteFloatLE((float) Local<Number>::Cast(value)->Value());
+            break;
+        case SchemaType::Double:
+            if((valid = value->IsNumber()))
+                encoder->WriteDoubleLE(Local<Number>::Cast(value)->Value());
+            break;
+        case SchemaType::String:
+            if((valid = value->IsString()))
+                WriteString(encoder, Local<String>::Cast(value));
+            break;
+        case SchemaType::Date:
+            if((valid = value->IsDate()))
+                encoder->WriteDoubleLE(Local<v8::Date>::Cast(value)->ValueOf());
+            break;
+        case SchemaType::Buffer:
+            if((valid = value->IsArrayBufferView())) {
+                size_t byte_length = node::Buffer::Length(value);
+
+                WriteLength(encoder, byte_length, true);
+                encoder->PushPayload(value, byte_length, (const uint8_t*) node::Buffer::Data(value));
+            }
+            break;
+        case SchemaType::List:
+            if((valid = value->IsArray())) {
+                Local<Array> list = Local<Array>::Cast(value);
+                uint32_t length = list->Length();
+
+                WriteLength(encoder, length, true);
+
+                for(uint32_t i = 0; i < length; i++)
+                    if(!WriteNode(encoder, node->children[0], Nan::Get(list, i).ToLocalChecked()))
+                        return false;
+            }
+            break;
+        case SchemaType::Record:
+            if((valid = value->IsObject())) {
+                Local<Object> object = Local<Object>::Cast(value);
+
+                for(Node* child : node->children)
+                    if(!WriteNode(encoder, child, Nan::Get(object, Nan::New(child->key)).ToLocalChecked()))
+                        return false;
+            }
+            break;
+    }
+
+    if(!valid) {
+        const char* expected = node->type == SchemaType::List ? "an array" : node->type == SchemaType::Record ? "an object" : type_names[node->type];
+
+        Nan::ThrowError(std::string("Field `" + node->name + "` must be " + expected).c_str());
+        return false;
+    }
+
+    return true;
+}
+
+Local<Value> ObjectSchema::ReadNode(Decoder* decoder, Node* node) {
+    switch(node->type) {
+        case SchemaType::Boolean:
+            return Nan::New(decoder->ReadUInt8() != 0);
+        case SchemaType::Int8:
+            return Nan::New<Number>(decoder->ReadInt8());
+        case SchemaType::UInt8:
+            return Nan::New<Number>(decoder->ReadUInt8());
+        case SchemaType::Int16:
+            return Nan::New<Number>(decoder->ReadInt16LE());
+        case SchemaType::UInt16:
+            return Nan::New<Number>(decoder->ReadUInt16LE());
+        case SchemaType::Int32:
+            return Nan::New<Number>(decoder->ReadInt32LE());
+        case SchemaType::UInt32:
+            return Nan::New<Number>(decoder->ReadUInt32LE());
+        case SchemaType::Float:
+            return Nan::New<Number>(decoder->ReadFloatLE());
+        case SchemaType::Double:
+            return Nan::New<Number>(decoder->ReadDoubleLE());
+        case SchemaType::String:
+            return ReadString(decoder, BO::String);
+        case SchemaType::Date:
+            return Nan::New<v8::Date>(decoder->ReadDoubleLE()).ToLocalChecked();
+        case SchemaType::Buffer:
+            return ReadBuffer(decoder);
+        case SchemaType::List: {
+            size_t length = ReadLength(decoder);
+            size_t offset = decoder->Offset();
+
+            // Items take at least one byte each
+            if(decoder->Consume(length) == nullptr)
+                return Nan::Undefined();
+
+            decoder->Seek(offset);
+
+            std::vector<Local<Value>> items(length);
+
+            for(size_t i = 0; i < length; i++)
+                items[i] = ReadNode(decoder, node->children[0]);
+
+            return Array::New(Isolate::GetCurrent(), items.data(), length);
+        }
+        case SchemaType::Record: {
+            Local<Object> record = Nan::NewInstance(Nan::New(node->tpl)).ToLocalChecked();
+
+            for(Node* child : node->children)
+                Nan::Set(record, Nan::New(child->key), ReadNode(decoder, child));
+
+            return record;
+        }
+    }
+
+    return ReadValue(decoder);
+}
+
+bool ObjectSchema::Write(Encoder* encoder, Local<Value> value) {
+    return WriteNode(encoder, &root, value);
+}
+
+Local<Value> ObjectSchema::Read(Decoder* decoder) {
+    return ReadNode(decoder, &root);
+}
+
+ObjectSchema* ObjectSchema::From(Local<Value> value) {
+    if(!value->IsObject() || !Nan::New(tpl)->HasInstance(value))
+        return nullptr;
+
+    return Nan::ObjectWrap::Unwrap<ObjectSchema>(Local<Object>::Cast(value));
+}
+
+/**
+ * new ObjectSchema({ id: 'uint32', name: 'string', tags: ['string'] }, { id: 1, class: Event })
+ */
+NAN_METHOD(ObjectSchema::New) {
+    Local<Value> definition = info[0];
+    Local<Value> options = info[1];
+    uint32_t id = 0;
+
+    if(!definition->IsObject() || definition->IsArray()) {
+        Nan::ThrowError("First argument must be an object");
+        return;
+    }
+
+    if(!Options::Check(options) || !Options::GetUint32(options, "id", &id))
+        return;
+
+    if(id > UINT8_MAX) {
+        Nan::ThrowError("Option `id` must be between 0 and 255");
+        return;
+    }
+
+    ObjectSchema* schema = new ObjectSchema();
+    schema->Wrap(info.This());
+    schema->id = id;
+
+    if(options->IsObject()) {
+        Local<Value> class_value = Nan::Get(Local<Object>::Cast(options), Nan::New("class").ToLocalChecked()).ToLocalChecked();
+
+        if(!class_value->IsUndefined()) {
+            if(!class_value->IsFunction()) {
+                Nan::ThrowError("Option `class` must be a class");
+                return;
+            }
+
+            schema->prototype.Reset(Nan::Get(Local<Object>::Cast(class_value), Nan::New("prototype").ToLocalChecked()).ToLocalChecked());
+        }
+    }
+
+    if(!Compile(definition, &schema->root, ""))
+        return;
+
+    Nan::Set(info.This(), Nan::New("id").ToLocalChecked(), Nan::New<Number>(id));
+    info.GetReturnValue().Set(info.This());
+}
+
+void ObjectSchema::Init(Local<Object> exports) {
+    Local<FunctionTemplate> t = Nan::New<FunctionTemplate>(New);
+    t->SetClassName(Nan::New("ObjectSchema").ToLocalChecked());
+    t->InstanceTemplate()->SetInternalFieldCount(1);
+
+    tpl.Reset(t);
+    Nan::Set(exports, Nan::New("ObjectSchema").ToLocalChecked(), Nan::GetFunction(t).ToLocalChecked());
+}
+
+SchemaTable::~SchemaTable() {
+    for(ObjectSchema* schema : schemas)
+        schema->Release();
+}
+
+bool SchemaTable::Read(Local<Value> options) {
+    if(!options->IsObject())
+        return true;
+
+    Local<Value> value = Nan::Get(Local<Object>::Cast(options), Nan::New("schemas").ToLocalChecked()).ToLocalChecked();
+
+    if(value->IsUndefined())
+        return true;
+
+    if(!value->IsArray()) {
+        Nan::ThrowError("Option `schemas` must be an array of schemas");
+        return false;
+    }
+
+    Local<Array> list = Local<Array>::Cast(value);
+
+    for(uint32_t i = 0; i < list->Length(); i++) {
+        ObjectSchema* schema = ObjectSchema::From(Nan::Get(list, i).ToLocalChecked());
+
+        if(schema == nullptr) {
+            Nan::ThrowError("Option `schemas` must be an array of schemas");
+            return false;
+        }
+
+        if(Find(schema->GetId()) != nullptr) {
+            Nan::ThrowError(std::string("More than one schema has id " + std::to_string(schema->GetId())).c_str());
+            return false;
+        }
+
+        schema->Retain();
+        schemas.push_back(schema);
+        matching = matching || schema->HasClass();
+    }
+
+    return true;
+}
+
+ObjectSchema* SchemaTable::Find(uint8_t id) {
+    for(ObjectSchema* schema : schemas)
+        if(schema->GetId() == id)
+            return schema;
+
+    return nullptr;
+}
+
+ObjectSchema* SchemaTable::Match(Local<Object> object) {
+    if(!matching)
+        return nullptr;
+
+    for(ObjectSchema* schema : schemas)
+        if(schema->Matches(object))
+            return schema;
+
+    return nullptr;
+}
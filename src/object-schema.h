@@ -0,0 +1,131 @@
+#ifndef OBJECT_SCHEMA_H_
+#define OBJECT_SCHEMA_H_
+
+#include <nan.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace v8;
+
+class Encoder;
+class Decoder;
+
+namespace SchemaType {
+    enum SchemaType {
+        /**
+         * Any value, written with it's type as usual
+         */
+        Any = 0,
+        Boolean = 1,
+        Int8 = 2,
+        UInt8 = 3,
+        Int16 = 4,
+        UInt16 = 5,
+        Int32 = 6,
+        UInt32 = 7,
+        Float = 8,
+        Double = 9,
+        String = 10,
+        Date = 11,
+        Buffer = 12,
+        /**
+         * Array whose items all have the same layout
+         */
+        List = 13,
+        Record = 14
+    };
+}
+
+/**
+ * Layout of records whose fields are known upfront. Fields are written in the order they were
+ * defined, without their keys nor types, and records are read into objects of a fixed shape
+ */
+class ObjectSchema : public Nan::ObjectWrap {
+public:
+    struct Node {
+        uint8_t type = SchemaType::Any;
+        /**
+         * Property name of record fields
+         */
+        std::string name;
+        Nan::Persistent<String> key;
+        /**
+         * Item layout of lists, fields of records
+         */
+        std::vector<Node*> children;
+        /**
+         * Template with every field of a record, so decoded records all share the same shape
+         */
+        Nan::Persistent<ObjectTemplate> tpl;
+        ~Node();
+    };
+private:
+    Node root;
+    uint8_t id = 0;
+    /**
+     * Prototype of the class whose instances are written as records of this schema by any encoder
+     */
+    Nan::Persistent<Value> prototype;
+    static Nan::Persistent<FunctionTemplate> tpl;
+    ObjectSchema();
+    ~ObjectSchema();
+    static NAN_METHOD(New);
+    /**
+     * Compile `definition` into `node`. Throws and returns false if it's not valid
+     */
+    static bool Compile(Local<Value> definition, Node* node, const std::string& path);
+    static bool WriteNode(Encoder* encoder, Node* node, Local<Value> value);
+    static Local<Value> ReadNode(Decoder* decoder, Node* node);
+public:
+    static void Init(Local<Object> exports);
+    /**
+     * Get schema behind `value` or nullptr if it is not a schema
+     */
+    static ObjectSchema* From(Local<Value> value);
+    uint8_t GetId();
+    /**
+     * Layout of the fields, for readers which step over records without creating values
+     */
+    const Node* GetRoot();
+    bool HasClass();
+    /**
+     * Check if `object` is an instance of the class of this schema
+     */
+    bool Matches(Local<Object> object);
+    /**
+     * Write fields of `value`. Throws and returns false if any of them doesn't fit the schema
+     */
+    bool Write(Encoder* encoder, Local<Value> value);
+    Local<Value> Read(Decoder* decoder);
+    /**
+     * Keep schema alive while an encoder or decoder uses it
+     */
+    void Retain();
+    void Release();
+};
+
+/**
+ * Schemas given to an encoder or decoder
+ */
+class SchemaTable {
+private:
+    std::vector<ObjectSchema*> schemas;
+    /**
+     * True when some schema has a class, so objects need to be matched against them
+     */
+    bool matching = false;
+public:
+    ~SchemaTable();
+    /**
+     * Read `schemas` option. Throws and returns false if it's not a list of schemas with distinct ids
+     */
+    bool Read(Local<Value> options);
+    ObjectSchema* Find(uint8_t id);
+    /**
+     * Find schema whose class `object` is an instance of, or nullptr
+     */
+    ObjectSchema* Match(Local<Object> object);
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "projection.h"
+
+#include <nan.h>
+
+size_t Projection::Child(size_t node, const std::string& step) {
+    if(step == "*") {
+        if(nodes[node].any == none) {
+            nodes[node].any = nodes.size();
+            nodes.push_back(Node());
+        }
+
+        return nodes[node].any;
+    }
+
+    std::unordered_map<std::string, size_t>::iterator it = nodes[node].children.find(step);
+
+    if(it != nodes[node].children.end())
+        return it->second;
+
+    size_t child = nodes.size();
+
+    nodes[node].children[step] = child;
+    nodes.push_back(Node());
+    return child;
+}
+
+void Projection::Merge(size_t from, size_t into) {
+    if(nodes[from].leaf)
+        nodes[into].leaf = true;
+
+    // Steps are copied first, since adding nodes moves them
+    std::vector<std::pair<std::string, size_t>> steps(nodes[from].children.begin(), nodes[from].children.end());
+
+    if(nodes[from].any != none)
+        steps.push_back(std::make_pair(std::string("*"), nodes[from].any));
+
+    for(const std::pair<std::string, size_t>& step : steps)
+        Merge(step.second, Child(into, step.first));
+}
+
+bool Projection::Compile(const std::vector<std::string>& paths) {
+    nodes.clear();
+    nodes.push_back(Node());
+
+    for(const std::string& path : paths) {
+        size_t node = 0;
+        size_t start = 0;
+
+        while(true) {
+            size_t end = path.find('.', start);
+
+            if(end == std::string::npos)
+                end = path.size();
+
+            if(end == start) {
+                Nan::ThrowError(std::string("Invalid path: '" + path + "'").c_str());
+                return false;
+            }
+
+            node = Child(node, path.substr(start, end - start));
+
+            if(end == path.size())
+                break;
+
+            start = end + 1;
+        }
+
+        nodes[node].leaf = true;
+    }
+
+    // Keys which are named are also matched by `*`, so they need it's paths too. Nodes
+    // added while merging come after the current one, so they are visited as well
+    for(size_t node = 0; node < nodes.size(); node++) {
+        if(nodes[node].any == none || nodes[node].children.empty())
+            continue;
+
+        std::vector<size_t> named;
+
+        for(const std::pair<const std::string, size_t>& child : nodes[node].children)
+            named.push_back(child.second);
+
+        for(size_t child : named)
+            Merge(nodes[node].any, child);
+    }
+
+    return true;
+}
+
+bool Projection::IsEmpty() {
+    return nodes.empty();
+}
+
+bool Projection::IsLeaf(size_t node) {
+    return nodes[node].leaf;
+}
+
+size_t Projection::FindKey(size_t node, const uint8_t* key, size_t length) {
+    const Node& parent = nodes[node];
+
+    if(!parent.children.empty()) {
+        std::unordered_map<std::string, size_t>::const_iterator it = parent.children.find(std::string((const char*) key, length));
+
+        if(it != parent.children.end())
+            return it->second;
+    }
+
+    return parent.any;
+}
+
+size_t Projection::FindIndex(size_t node, size_t index) {
+    const Node& parent = nodes[node];
+
+    if(!parent.children.empty()) {
+        std::unordered_map<std::string, size_t>::const_iterator it = parent.children.find(std::to_string(index));
+
+        if(it != parent.children.end())
+            return it->second;
+    }
+
+    return parent.any;
+}
@@ -0,0 +1,53 @@
+#ifndef PROJECTION_H_
+#define PROJECTION_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Tree of the property paths wanted out of a message, such as `user.id` or `items.*.price`. Each
+ * node is a step of a path, and `*` matches any key or array index. Nodes are referred to by their
+ * index, the root being zero
+ */
+class Projection {
+public:
+    static const size_t none = SIZE_MAX;
+private:
+    struct Node {
+        /**
+         * A path ends here, so the whole value is wanted
+         */
+        bool leaf = false;
+        /**
+         * Node for `*`, or `none`
+         */
+        size_t any = none;
+        std::unordered_map<std::string, size_t> children;
+    };
+    std::vector<Node> nodes;
+    size_t Child(size_t node, const std::string& step);
+    /**
+     * Add paths under node `from` to node `into`
+     */
+    void Merge(size_t from, size_t into);
+public:
+    /**
+     * Build tree out of dot separated `paths`. Throws and returns false if any of them is not valid
+     */
+    bool Compile(const std::vector<std::string>& paths);
+    bool IsEmpty();
+    bool IsLeaf(size_t node);
+    /**
+     * Node wanted under `node` for object key of `length` bytes at `key`, or `none` if it's not wanted
+     */
+    size_t FindKey(size_t node, const uint8_t* key, size_t length);
+    /**
+     * Node wanted under `node` for array element `index`, or `none` if it's not wanted
+     */
+    size_t FindIndex(size_t node, size_t index);
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include "record-log.h"
+#include "block-codec.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::string RecordLog::IndexPath(const std::string& path) {
+    return path + ".idx";
+}
+
+const char* RecordLog::Map(const std::string& path, bool optional, Mapping* mapping) {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat status;
+
+    mapping->data = nullptr;
+    mapping->length = 0;
+
+    if(fd == -1)
+        return optional && errno == ENOENT ? nullptr : "Failed to open record log";
+
+    if(fstat(fd, &status) != 0) {
+        close(fd);
+        return "Failed to open record log";
+    }
+
+    if(status.st_size > 0) {
+        void* data = mmap(nullptr, (size_t) status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+        if(data == MAP_FAILED) {
+            close(fd);
+            return "Failed to map record log into memory";
+        }
+
+        mapping->data = (uint8_t*) data;
+        mapping->length = (size_t) status.st_size;
+    }
+
+    // Mappings stay valid after their file is closed
+    close(fd);
+    return nullptr;
+}
+
+void RecordLog::Unmap(uint8_t* data, size_t length) {
+    if(data != nullptr)
+        munmap(data, length);
+}
+
+/**
+ * Check that a complete record starts at `offset`
+ */
+static bool IsComplete(const uint8_t* data, size_t length, uint64_t offset) {
+    if(offset < RecordLog::header_length || offset % 8 != 0 || offset > length || length - offset < RecordLog::prefix_length)
+        return false;
+
+    return RecordLog::RecordLength(RecordLog::ReadUInt32LE(data + offset)) <= length - offset;
+}
+
+const char* RecordLog::Recover(const uint8_t* data, size_t length, const uint8_t* index, size_t index_length, Layout* layout) {
+    layout->indexed = 0;
+    layout->tail.clear();
+    layout->end = header_length;
+
+    if(length == 0)
+        return nullptr;
+
+    if(length < header_length || memcmp(data, header, header_length) != 0)
+        return "File is not a record log";
+
+    size_t indexed = index_length / 8;
+
+    // Offsets are written after their records, so only the last ones could point past the end of the log
+    while(indexed > 0 && !IsComplete(data, length, ReadUInt64LE(index + (indexed - 1) * 8)))
+        indexed--;
+
+    size_t offset = header_length;
+
+    if(indexed > 0) {
+        offset = (size_t) ReadUInt64LE(index + (indexed - 1) * 8);
+        offset += RecordLength(ReadUInt32LE(data + offset));
+    }
+
+    // Records which are not in the index are only kept if their contents match their checksum
+    while(IsComplete(data, length, offset)) {
+        uint32_t message_length = ReadUInt32LE(data + offset);
+
+        if(BlockCodec::Checksum(data + offset + prefix_length, message_length) != ReadUInt32LE(data + offset + 4))
+            break;
+
+        layout->tail.push_back(offset);
+        offset += RecordLength(message_length);
+    }
+
+    layout->indexed = indexed;
+    layout->end = offset;
+    return nullptr;
+}
@@ -0,0 +1,91 @@
+#ifndef RECORD_LOG_H_
+#define RECORD_LOG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+/**
+ * Append-only file of encoded messages. It starts with an 8-byte header, followed by the records. Each record is
+ * the length of it's message and the CRC-32 of it's contents, as unsigned 32-bit integers, then the message and
+ * zeros up to a multiple of 8 bytes, so messages stay aligned in memory when the file is mapped. Offsets of the
+ * records are kept in a sidecar index file, as unsigned 64-bit integers. Records written after the last offset of
+ * the index, which happens if a process stops between writing both files, are found by going through them
+ */
+namespace RecordLog {
+    static const size_t header_length = 8;
+    static const size_t prefix_length = 8;
+    static const uint8_t header[header_length] = { 'b', 'o', 'l', 'o', 'g', 0, 0, 1 };
+
+    /**
+     * Path of the index of the log at `path`
+     */
+    std::string IndexPath(const std::string& path);
+
+    /**
+     * Bytes taken by a record with a message of `length` bytes
+     */
+    inline size_t RecordLength(size_t length) {
+        return (prefix_length + length + 7) & ~((size_t) 7);
+    }
+
+    /**
+     * File mapped into memory for reading. Empty files are not mapped
+     */
+    struct Mapping {
+        uint8_t* data = nullptr;
+        size_t length = 0;
+    };
+
+    /**
+     * Map file at `path`. A missing file is an empty mapping when `optional` is set. Returns an error message or nullptr
+     */
+    const char* Map(const std::string& path, bool optional, Mapping* mapping);
+    void Unmap(uint8_t* data, size_t length);
+
+    /**
+     * Records found in a log
+     */
+    struct Layout {
+        /**
+         * Amount of index entries which point to complete records
+         */
+        size_t indexed = 0;
+        /**
+         * Offsets of the records after the last one in the index
+         */
+        std::vector<uint64_t> tail;
+        /**
+         * Where the last complete record ends. Anything after it was cut short
+         */
+        size_t end = header_length;
+    };
+
+    /**
+     * Find records of `length` bytes of a log at `data`, using `index_length` bytes of it's index.
+     * Only the last indexed record and the ones after it are looked at, so logs of any size are
+     * opened at once. Returns an error message if it's not a log or nullptr
+     */
+    const char* Recover(const uint8_t* data, size_t length, const uint8_t* index, size_t index_length, Layout* layout);
+
+    inline uint64_t ReadUInt64LE(const uint8_t* data) {
+        uint64_t n = 0;
+
+        for(int i = 7; i >= 0; i--)
+            n = (n << 8) | data[i];
+
+        return n;
+    }
+
+    inline uint32_t ReadUInt32LE(const uint8_t* data) {
+        return (uint32_t) data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+    }
+
+    inline void WriteUInt64LE(uint8_t* output, uint64_t n) {
+        for(int i = 0; i < 8; i++)
+            output[i] = (uint8_t) (n >> (i * 8));
+    }
+}
+
+#endif
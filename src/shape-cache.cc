@@ -0,0 +1,59 @@
+#include "shape-cache.h"
+
+ShapeCache::~ShapeCache() {
+    Clear();
+}
+
+void ShapeCache::Clear() {
+    for(auto& item : shapes) {
+        item.second->tpl.Reset();
+        delete item.second;
+    }
+    shapes.clear();
+}
+
+static uint64_t Hash(const char* data, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+
+    for(size_t i = 0; i < length; i++)
+        hash = (hash ^ (uint8_t) data[i]) * 1099511628211ULL;
+
+    return hash;
+}
+
+Local<Object> ShapeCache::NewObject(const char* keys, size_t keys_length, bool cacheable, Local<Value>* properties, size_t length) {
+    Shape* shape = nullptr;
+
+    if(cacheable && length > 0 && length <= max_properties) {
+        uint64_t hash = Hash(keys, keys_length);
+        auto item = shapes.find(hash);
+
+        if(item != shapes.end()) {
+            if(item->second->keys.compare(0, std::string::npos, keys, keys_length) == 0)
+                shape = item->second;
+        } else if(shapes.size() < max_shapes) {
+            shape = new Shape();
+            shape->keys.assign(keys, keys_length);
+            shape->hits = 0;
+            shapes[hash] = shape;
+        }
+    }
+
+    if(shape != nullptr && shape->hits < 2 && ++shape->hits == 2) {
+        Local<ObjectTemplate> tpl = Nan::New<ObjectTemplate>();
+
+        for(size_t i = 0; i < length; i++)
+            tpl->Set(Local<Name>::Cast(properties[i * 2]), Nan::Undefined());
+
+        shape->tpl.Reset(tpl);
+    }
+
+    Local<Object> result = shape != nullptr && !shape->tpl.IsEmpty() ?
+        Nan::NewInstance(Nan::New(shape->tpl)).ToLocalChecked() :
+        Nan::New<Object>();
+
+    for(size_t i = 0; i < length; i++)
+        Nan::Set(result, properties[i * 2], properties[i * 2 + 1]);
+
+    return result;
+}
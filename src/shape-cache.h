@@ -0,0 +1,39 @@
+#ifndef SHAPE_CACHE_H_
+#define SHAPE_CACHE_H_
+
+#include <nan.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+using namespace v8;
+
+/**
+ * Object templates for sequences of keys (shapes) which were seen more than once. Objects created from
+ * them already have all their properties, so setting values doesn't go through hidden class transitions
+ */
+class ShapeCache {
+private:
+    struct Shape {
+        /**
+         * Key bytes as they were given to `NewObject`, to tell shapes with the same hash apart
+         */
+        std::string keys;
+        uint32_t hits;
+        Nan::Persistent<ObjectTemplate> tpl;
+    };
+    static const size_t max_shapes = 256;
+    static const size_t max_properties = 64;
+    std::unordered_map<uint64_t, Shape*> shapes;
+public:
+    ~ShapeCache();
+    /**
+     * Create object with `length` properties, whose names and values are interleaved in `properties`. `keys`
+     * identifies the sequence of names. If `cacheable` is false the shape is never cached, which is
+     * needed for keys with special meaning
+     */
+    Local<Object> NewObject(const char* keys, size_t keys_length, bool cacheable, Local<Value>* properties, size_t length);
+    void Clear();
+};
+
+#endif
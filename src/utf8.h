@@ -0,0 +1,79 @@
+#ifndef UTF8_H_
+#define UTF8_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace Utf8 {
+    /**
+     * Count UTF-16 code units of the string V8 creates out of UTF-8 `data`. Invalid sequences are
+     * counted as one replacement character per maximal subpart, the way V8 decodes them, and
+     * `valid` is set to false when there is any
+     */
+    inline size_t Utf16Length(const uint8_t* data, size_t length, bool* valid) {
+        size_t units = 0;
+        size_t i = 0;
+
+        *valid = true;
+
+        while(i < length) {
+            uint8_t byte = data[i];
+
+            if(byte < 0x80) {
+                units++;
+                i++;
+                continue;
+            }
+
+            size_t needed;
+            uint8_t lower = 0x80;
+            uint8_t upper = 0xBF;
+
+            if(byte >= 0xC2 && byte <= 0xDF) {
+                needed = 1;
+            } else if(byte >= 0xE0 && byte <= 0xEF) {
+                needed = 2;
+                if(byte == 0xE0)
+                    lower = 0xA0;
+                if(byte == 0xED)
+                    upper = 0x9F;
+            } else if(byte >= 0xF0 && byte <= 0xF4) {
+                needed = 3;
+                if(byte == 0xF0)
+                    lower = 0x90;
+                if(byte == 0xF4)
+                    upper = 0x8F;
+            } else {
+                *valid = false;
+                units++;
+                i++;
+                continue;
+            }
+
+            size_t seen = 0;
+
+            i++;
+
+            // Only the first continuation byte has a narrower range
+            while(seen < needed && i < length && data[i] >= lower && data[i] <= upper) {
+                lower = 0x80;
+                upper = 0xBF;
+                seen++;
+                i++;
+            }
+
+            if(seen < needed) {
+                // Byte which broke the sequence starts the next one
+                *valid = false;
+                units++;
+                continue;
+            }
+
+            units += needed == 3 ? 2 : 1;
+        }
+
+        return units;
+    }
+}
+
+#endif
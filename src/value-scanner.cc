@@ -0,0 +1,944 @@
+#include "value-scanner.h"
+#include "node-binobject.h"
+#include "number-scan.h"
+#include "varint.h"
+#include "ascii.h"
+#include "utf8.h"
+
+#include <string.h>
+#include <vector>
+
+size_t Scanner::NumberWidth(uint8_t type) {
+    switch(type) {
+        case BO::UInt8:
+        case BO::Int8:
+            return 1;
+        case BO::UInt16:
+        case BO::Int16:
+            return 2;
+        case BO::UInt32:
+        case BO::Int32:
+        case BO::Float:
+            return 4;
+        case BO::Double:
+        case BO::Int64:
+        case BO::UInt64:
+            return 8;
+    }
+
+    return 0;
+}
+
+template<typename T>
+static double ReadAt(const uint8_t* data) {
+    T n;
+    memcpy(&n, data, sizeof(T));
+    return (double) n;
+}
+
+static double ReadNumberAt(uint8_t type, const uint8_t* data) {
+    switch(type) {
+        case BO::UInt8:
+            return ReadAt<uint8_t>(data);
+        case BO::Int8:
+            return ReadAt<int8_t>(data);
+        case BO::UInt16:
+            return ReadAt<uint16_t>(data);
+        case BO::Int16:
+            return ReadAt<int16_t>(data);
+        case BO::UInt32:
+            return ReadAt<uint32_t>(data);
+        case BO::Int32:
+            return ReadAt<int32_t>(data);
+        case BO::Float:
+            return ReadAt<float>(data);
+        case BO::Double:
+            return ReadAt<double>(data);
+        case BO::Int64:
+            return ReadAt<int64_t>(data);
+    }
+
+    return ReadAt<uint64_t>(data);
+}
+
+uint8_t Scanner::ParseVarint(const uint8_t* data, size_t available, size_t* consumed, uint64_t* result) {
+    *consumed = Varint::Decode(data, available, result);
+
+    if(*consumed > 0)
+        return Scanner::Done;
+
+    return available >= Varint::max_length ? Scanner::Invalid : Scanner::NeedMore;
+}
+
+uint8_t Scanner::ParseLength(const uint8_t* data, size_t available, uint8_t format, size_t* consumed, size_t* length) {
+    uint64_t n;
+
+    if(format == BO::Format::V2) {
+        uint8_t result = ParseVarint(data, available, consumed, &n);
+        *length = n;
+        return result;
+    }
+
+    if(available == 0)
+        return Scanner::NeedMore;
+
+    if(data[0] == BO::VarInt) {
+        uint8_t result = ParseVarint(data + 1, available - 1, consumed, &n);
+        int64_t value = Varint::UnZigZag(n);
+
+        *consumed += 1;
+        *length = value;
+        return result == Scanner::Done && value < 0 ? (uint8_t) Scanner::Invalid : result;
+    }
+
+    size_t width = NumberWidth(data[0]);
+
+    if(width == 0)
+        return Scanner::Invalid;
+
+    if(available < 1 + width)
+        return Scanner::NeedMore;
+
+    double value = ReadNumberAt(data[0], data + 1);
+
+    if(!(value >= 0) || value > 9007199254740991.0)
+        return Scanner::Invalid;
+
+    *consumed = 1 + width;
+    *length = value;
+    return Scanner::Done;
+}
+
+uint8_t Scanner::ParseLeaf(const uint8_t* data, size_t available, uint8_t format, bool custom, size_t* span) {
+    uint8_t type = data[0];
+    size_t consumed;
+    size_t length;
+    uint8_t result;
+    uint64_t n;
+
+    switch(type) {
+        case BO::Null:
+        case BO::Undefined:
+            *span = 1;
+            break;
+        case BO::Boolean:
+            *span = 2;
+            break;
+        case BO::Date:
+            *span = 9;
+            break;
+        case BO::VarInt:
+            result = ParseVarint(data + 1, available - 1, &consumed, &n);
+            if(result != Scanner::Done)
+                return result;
+            *span = 1 + consumed;
+            break;
+        case BO::TypedArray: {
+            if(available < 2)
+                return Scanner::NeedMore;
+
+            size_t element_size = BO::ElementKind::ElementSize(data[1]);
+
+            if(element_size == 0)
+                return Scanner::Invalid;
+
+            result = ParseLength(data + 2, available - 2, format, &consumed, &length);
+            if(result != Scanner::Done)
+                return result;
+            if(length % element_size != 0)
+                return Scanner::Invalid;
+            if(available < 3 + consumed || length > available)
+                return Scanner::NeedMore;
+            if(data[2 + consumed] >= element_size)
+                return Scanner::Invalid;
+            *span = 3 + consumed + data[2 + consumed] + length;
+            break;
+        }
+        case BO::Reference:
+            result = ParseLength(data + 1, available - 1, format, &consumed, &length);
+            if(result != Scanner::Done)
+                return result;
+            *span = 1 + consumed;
+            break;
+        case BO::Record: {
+            if(available < 6)
+                return Scanner::NeedMore;
+
+            uint32_t byte_length;
+            memcpy(&byte_length, data + 2, sizeof(byte_length));
+            *span = 6 + (size_t) byte_length;
+            break;
+        }
+        case BO::PackedArray: {
+            if(available < 2)
+                return Scanner::NeedMore;
+
+            size_t width = NumberScan::Width(data[1]);
+
+            if(width == 0)
+                return Scanner::Invalid;
+
+            result = ParseLength(data + 2, available - 2, format, &consumed, &length);
+            if(result != Scanner::Done)
+                return result;
+            if(length > available / width)
+                return Scanner::NeedMore;
+            *span = 2 + consumed + length * width;
+            break;
+        }
+        default:
+            if(NumberWidth(type) > 0) {
+                *span = 1 + NumberWidth(type);
+                break;
+            }
+
+            if(type != BO::String && type != BO::OneByteString && type != BO::Buffer && type != BO::ArrayBuffer && !custom)
+                return Scanner::Invalid;
+
+            result = ParseLength(data + 1, available - 1, format, &consumed, &length);
+            if(result != Scanner::Done)
+                return result;
+            if(length > available)
+                return Scanner::NeedMore;
+            *span = 1 + consumed + length;
+    }
+
+    return *span > available ? Scanner::NeedMore : Scanner::Done;
+}
+
+/**
+ * Values numbered so far inside the `BO::Shared` value being walked through, counted the
+ * way decoders number them, so references can be checked to point at a value read before
+ */
+struct SharedScope {
+    bool active = false;
+    /**
+     * Strings with fewer UTF-16 code units are not numbered
+     */
+    size_t min_length = 0;
+    size_t count = 0;
+};
+
+/**
+ * What walking through a value needs besides the value itself
+ */
+struct WalkContext {
+    uint8_t format;
+    CustomType::Table* types;
+    SchemaTable* schemas;
+    /**
+     * Check sized containers hold exactly as many bytes as their prefix tells instead of jumping over them, and
+     * check records, columns, dictionaries and references hold what decoders expect
+     */
+    bool strict;
+    SharedScope shared;
+};
+
+/**
+ * Container being walked through
+ */
+struct ScannerLevel {
+    /**
+     * Values left, keys not included
+     */
+    size_t remaining;
+    bool object;
+    /**
+     * Where the container must end as told by it's `BO::Sized` prefix, or `SIZE_MAX`
+     */
+    size_t end;
+    /**
+     * Where the prefix starts
+     */
+    size_t start;
+    /**
+     * Set for shared values walked in strict mode, whose numbering is replaced by `outer` once they end
+     */
+    bool shared;
+    SharedScope outer;
+};
+
+static void AddTapeEntry(std::vector<Scanner::TapeEntry>* tape, uint16_t type, uint8_t kind, size_t offset, size_t length) {
+    Scanner::TapeEntry entry;
+
+    entry.type = type;
+    entry.kind = kind;
+    entry.offset = offset;
+    entry.length = length;
+    tape->push_back(entry);
+}
+
+static uint8_t Walk(const uint8_t* data, size_t available, WalkContext* context, size_t max_depth,
+    std::vector<Scanner::TapeEntry>* tape, size_t* span, size_t* error_offset);
+
+/**
+ * Find out the `StringKind` of the contents of a string of `type` and their length in UTF-16 code units. Strings
+ * which are not well formed UTF-8 are rejected, just like decoders do
+ */
+static uint8_t ScanString(uint8_t type, const uint8_t* data, size_t length, uint8_t* kind, size_t* characters) {
+    bool valid = true;
+
+    *characters = length;
+
+    if(Ascii::IsASCII(data, length))
+        *kind = Scanner::AsciiString;
+    else if(type == BO::OneByteString)
+        *kind = Scanner::Latin1String;
+    else {
+        *kind = Scanner::Utf8String;
+        *characters = Utf8::Utf16Length(data, length, &valid);
+    }
+
+    return valid ? (uint8_t) Scanner::Done : (uint8_t) Scanner::InvalidString;
+}
+
+/**
+ * Check the string starting at `data`, which is a string of `type` whose type was already read
+ */
+static uint8_t WalkString(const uint8_t* data, size_t available, WalkContext* context, uint8_t type, size_t* span) {
+    size_t consumed;
+    size_t length;
+    size_t characters;
+    uint8_t kind;
+
+    uint8_t result = Scanner::ParseLength(data, available, context->format, &consumed, &length);
+    if(result != Scanner::Done)
+        return result;
+    if(length > available - consumed)
+        return Scanner::NeedMore;
+
+    *span = consumed + length;
+    return ScanString(type, data + consumed, length, &kind, &characters);
+}
+
+/**
+ * Check the packed indices of a dictionary of `count` strings. There must be `rows` of them, or any amount if it's `SIZE_MAX`
+ */
+static uint8_t WalkDictionaryIndices(const uint8_t* data, size_t available, WalkContext* context, size_t count, size_t rows, size_t* span) {
+    size_t consumed;
+    size_t length;
+
+    if(available == 0)
+        return Scanner::NeedMore;
+
+    if(data[0] != BO::PackedArray)
+        return Scanner::Invalid;
+
+    uint8_t result = Scanner::ParseLeaf(data, available, context->format, false, span);
+    if(result != Scanner::Done)
+        return result;
+
+    uint8_t type = data[1];
+    size_t width = NumberScan::Width(type);
+
+    Scanner::ParseLength(data + 2, available - 2, context->format, &consumed, &length);
+
+    if(rows != SIZE_MAX && length != rows)
+        return Scanner::Invalid;
+
+    const uint8_t* items = data + 2 + consumed;
+
+    for(size_t i = 0; i < length; i++) {
+        // Indices are never negative nor fractional, so encoders don't pick other types
+        if(type != BO::UInt8 && type != BO::UInt16 && type != BO::Int32)
+            return Scanner::Invalid;
+
+        double index = ReadNumberAt(type, items + i * width);
+
+        if(index < 0 || index >= count)
+            return Scanner::Invalid;
+    }
+
+    return Scanner::Done;
+}
+
+/**
+ * Check distinct strings and indices of a dictionary, which start after it's type
+ */
+static uint8_t WalkDictionaryContents(const uint8_t* data, size_t available, WalkContext* context, size_t rows, size_t* span, size_t* error_offset) {
+    size_t position = 0;
+    size_t consumed;
+    size_t count;
+    size_t length;
+
+    *error_offset = 0;
+
+    uint8_t result = Scanner::ParseLength(data, available, context->format, &consumed, &count);
+    if(result != Scanner::Done)
+        return result;
+    position += consumed;
+
+    // Each string takes at least one byte
+    if(count > available - position)
+        return Scanner::NeedMore;
+
+    for(size_t i = 0; i < count; i++) {
+        *error_offset = position;
+
+        if(position >= available)
+            return Scanner::NeedMore;
+
+        if(data[position] != BO::String && data[position] != BO::OneByteString)
+            return Scanner::Invalid;
+
+        result = WalkString(data + position + 1, available - position - 1, context, data[position], &length);
+        if(result != Scanner::Done)
+            return result;
+        position += 1 + length;
+    }
+
+    *error_offset = position;
+
+    result = WalkDictionaryIndices(data + position, available - position, context, count, rows, &length);
+    if(result != Scanner::Done)
+        return result;
+
+    *span = position + length;
+    return Scanner::Done;
+}
+
+/**
+ * Check every column of a `BO::Columns` value starting at `data` holds one cell per row. Cells
+ * of columns written as arrays are walked with at most `max_depth` levels of containers
+ */
+static uint8_t WalkColumns(const uint8_t* data, size_t available, WalkContext* context, size_t max_depth, size_t* span, size_t* error_offset) {
+    size_t position = 1;
+    size_t consumed;
+    size_t rows;
+    size_t count;
+    size_t length;
+    uint8_t result;
+
+    *error_offset = 0;
+
+    result = Scanner::ParseLength(data + position, available - position, context->format, &consumed, &rows);
+    if(result != Scanner::Done)
+        return result;
+    position += consumed;
+
+    result = Scanner::ParseLength(data + position, available - position, context->format, &consumed, &count);
+    if(result != Scanner::Done)
+        return result;
+    position += consumed;
+
+    // Rows can't be told apart without columns, so any amount of them could be claimed for free
+    if(count == 0)
+        return Scanner::Invalid;
+
+    // Each key and each cell take at least one byte
+    if(rows >= SIZE_MAX / 2 || (available - position) / count < rows + 1)
+        return Scanner::NeedMore;
+
+    for(size_t k = 0; k < count; k++) {
+        result = Scanner::ParseLength(data + position, available - position, context->format, &consumed, &length);
+        if(result != Scanner::Done)
+            return result;
+        if(length > available - position - consumed)
+            return Scanner::NeedMore;
+        position += consumed + length;
+    }
+
+    for(size_t k = 0; k < count; k++) {
+        *error_offset = position;
+
+        if(position >= available)
+            return Scanner::NeedMore;
+
+        uint8_t type = data[position];
+
+        if(type == BO::PackedArray) {
+            result = Scanner::ParseLeaf(data + position, available - position, context->format, false, &length);
+            if(result != Scanner::Done)
+                return result;
+
+            size_t cells;
+
+            Scanner::ParseLength(data + position + 2, available - position - 2, context->format, &consumed, &cells);
+
+            if(cells != rows)
+                return Scanner::Invalid;
+
+            position += length;
+        } else if(type == BO::Dictionary) {
+            result = WalkDictionaryContents(data + position + 1, available - position - 1, context, rows, &length, error_offset);
+            *error_offset += position + 1;
+            if(result != Scanner::Done)
+                return result;
+            position += 1 + length;
+        } else if(type == BO::Array) {
+            size_t cells;
+
+            result = Scanner::ParseLength(data + position + 1, available - position - 1, context->format, &consumed, &cells);
+            if(result != Scanner::Done)
+                return result;
+            if(cells != rows)
+                return Scanner::Invalid;
+            position += 1 + consumed;
+
+            for(size_t i = 0; i < rows; i++) {
+                result = Walk(data + position, available - position, context, max_depth, nullptr, &length, error_offset);
+                *error_offset += position;
+                if(result != Scanner::Done)
+                    return result;
+                position += length;
+            }
+        } else {
+            return Scanner::Invalid;
+        }
+    }
+
+    *span = position;
+    return Scanner::Done;
+}
+
+/**
+ * Check record fields of layout `node` are all within `available` bytes. Fields of any type are walked
+ * as values, which counts as a level of containers
+ */
+static uint8_t WalkFields(const uint8_t* data, size_t available, WalkContext* context, const ObjectSchema::Node* node, size_t max_depth,
+    size_t* span, size_t* error_offset) {
+    size_t position = 0;
+    size_t consumed;
+    size_t length;
+    size_t width = 0;
+    uint8_t result;
+
+    *error_offset = 0;
+
+    switch(node->type) {
+        case SchemaType::Boolean:
+        case SchemaType::Int8:
+        case SchemaType::UInt8:
+            width = 1;
+            break;
+        case SchemaType::Int16:
+        case SchemaType::UInt16:
+            width = 2;
+            break;
+        case SchemaType::Int32:
+        case SchemaType::UInt32:
+        case SchemaType::Float:
+            width = 4;
+            break;
+        case SchemaType::Double:
+        case SchemaType::Date:
+            width = 8;
+            break;
+        case SchemaType::String:
+            return WalkString(data, available, context, BO::String, span);
+        case SchemaType::Buffer:
+            result = Scanner::ParseLength(data, available, context->format, &consumed, &length);
+            if(result != Scanner::Done)
+                return result;
+            if(length > available - consumed)
+                return Scanner::NeedMore;
+            *span = consumed + length;
+            return Scanner::Done;
+        case SchemaType::List: {
+            size_t items;
+
+            result = Scanner::ParseLength(data, available, context->format, &consumed, &items);
+            if(result != Scanner::Done)
+                return result;
+            position += consumed;
+
+            // Items take at least one byte each
+            if(items > available - position)
+                return Scanner::NeedMore;
+
+            for(size_t i = 0; i < items; i++) {
+                result = WalkFields(data + position, available - position, context, node->children[0], max_depth, &length, error_offset);
+                *error_offset += position;
+                if(result != Scanner::Done)
+                    return result;
+                position += length;
+            }
+
+            *span = position;
+            return Scanner::Done;
+        }
+        case SchemaType::Record:
+            for(const ObjectSchema::Node* child : node->children) {
+                result = WalkFields(data + position, available - position, context, child, max_depth, &length, error_offset);
+                *error_offset += position;
+                if(result != Scanner::Done)
+                    return result;
+                position += length;
+            }
+
+            *span = position;
+            return Scanner::Done;
+        default:
+            if(max_depth == 0)
+                return Scanner::TooDeep;
+
+            return Walk(data, available, context, max_depth - 1, nullptr, span, error_offset);
+    }
+
+    if(available < width)
+        return Scanner::NeedMore;
+
+    *span = width;
+    return Scanner::Done;
+}
+
+/**
+ * Check a `BO::Record` starting at `data` is of a known schema and it's fields take exactly the bytes the record tells
+ */
+static uint8_t WalkRecord(const uint8_t* data, size_t available, WalkContext* context, size_t max_depth, size_t* span, size_t* error_offset) {
+    size_t length;
+
+    *error_offset = 0;
+
+    if(available < 6)
+        return Scanner::NeedMore;
+
+    ObjectSchema* schema = context->schemas->Find(data[1]);
+
+    if(schema == nullptr)
+        return Scanner::Invalid;
+
+    uint32_t byte_length;
+    memcpy(&byte_length, data + 2, sizeof(byte_length));
+
+    if(byte_length > available - 6)
+        return Scanner::NeedMore;
+
+    uint8_t result = WalkFields(data + 6, byte_length, context, schema->GetRoot(), max_depth, &length, error_offset);
+
+    // Fields which go past the record don't match the schema, even if the input goes on
+    if(result == Scanner::NeedMore || (result == Scanner::Done && length != byte_length)) {
+        *error_offset = 0;
+        return Scanner::Invalid;
+    }
+
+    *error_offset += 6;
+
+    if(result != Scanner::Done)
+        return result;
+
+    *span = 6 + (size_t) byte_length;
+    return Scanner::Done;
+}
+
+/**
+ * Number value the way decoders do, if it's inside a shared value
+ */
+static void NumberShared(WalkContext* context) {
+    if(context->shared.active)
+        context->shared.count++;
+}
+
+/**
+ * Walk through the value at `data` without recursion, except for values which decoders read in one go such as
+ * columns. Items are added to `tape` unless it's nullptr, which needs strict mode so sized containers are entered
+ */
+static uint8_t Walk(const uint8_t* data, size_t available, WalkContext* context, size_t max_depth,
+    std::vector<Scanner::TapeEntry>* tape, size_t* span, size_t* error_offset) {
+    std::vector<ScannerLevel> levels;
+    uint8_t format = context->format;
+    bool strict = context->strict;
+    size_t position = 0;
+    size_t consumed;
+    size_t length;
+    uint8_t result;
+
+    while(true) {
+        *error_offset = position;
+
+        if(!levels.empty()) {
+            ScannerLevel& level = levels.back();
+
+            if(level.remaining == 0) {
+                if(level.end != SIZE_MAX && position != level.end) {
+                    *error_offset = level.start;
+                    return Scanner::Invalid;
+                }
+
+                if(level.shared)
+                    context->shared = level.outer;
+
+                levels.pop_back();
+
+                if(levels.empty())
+                    break;
+                continue;
+            }
+
+            level.remaining--;
+
+            if(level.object) {
+                result = Scanner::ParseLength(data + position, available - position, format, &consumed, &length);
+                if(result != Scanner::Done)
+                    return result;
+                if(length > available - position - consumed)
+                    return Scanner::NeedMore;
+                if(tape != nullptr) {
+                    uint8_t kind = Ascii::IsASCII(data + position + consumed, length) ? Scanner::AsciiString : Scanner::Utf8String;
+
+                    AddTapeEntry(tape, Scanner::TapeKey, kind, position + consumed, length);
+                }
+                position += consumed + length;
+                *error_offset = position;
+            }
+        }
+
+        if(position >= available)
+            return Scanner::NeedMore;
+
+        uint8_t type = data[position];
+        size_t sized_start = position;
+        size_t sized_end = SIZE_MAX;
+
+        if(type == BO::Sized) {
+            if(available - position < 5)
+                return Scanner::NeedMore;
+
+            uint32_t byte_length;
+            memcpy(&byte_length, data + position + 1, sizeof(byte_length));
+
+            if(byte_length > available - position - 5)
+                return Scanner::NeedMore;
+
+            if(!strict) {
+                position += 5 + byte_length;
+
+                if(levels.empty())
+                    break;
+                continue;
+            }
+
+            sized_end = position + 5 + byte_length;
+            position += 5;
+            type = byte_length > 0 ? data[position] : 0;
+
+            if(type != BO::Object && type != BO::Array && type != BO::Map)
+                return Scanner::Invalid;
+        }
+
+        if(type == BO::Object || type == BO::Array || type == BO::Map) {
+            result = Scanner::ParseLength(data + position + 1, available - position - 1, format, &consumed, &length);
+            if(result != Scanner::Done)
+                return result;
+
+            // Every item takes at least one byte, so there can't be more of them than bytes left
+            if(length > available - position)
+                return Scanner::NeedMore;
+
+            if(levels.size() >= max_depth)
+                return Scanner::TooDeep;
+
+            position += 1 + consumed;
+
+            ScannerLevel level;
+            level.remaining = type == BO::Map ? length * 2 : length;
+            level.object = type == BO::Object;
+            level.end = sized_end;
+            level.start = sized_start;
+            level.shared = false;
+            levels.push_back(level);
+
+            if(strict)
+                NumberShared(context);
+
+            if(tape != nullptr)
+                AddTapeEntry(tape, type, Scanner::AsciiString, position - 1 - consumed, length);
+            continue;
+        }
+
+        if(type == BO::Columns || type == BO::Dictionary || type == BO::Shared) {
+            if(levels.size() >= max_depth)
+                return Scanner::TooDeep;
+
+            // Columns and dictionaries are read in one go by decoders, so they're checked and added to tapes as a single entry
+            if(strict && type != BO::Shared) {
+                if(type == BO::Columns) {
+                    result = WalkColumns(data + position, available - position, context, max_depth - levels.size() - 1, &length, error_offset);
+                } else {
+                    result = WalkDictionaryContents(data + position + 1, available - position - 1, context, SIZE_MAX, &length, error_offset);
+                    *error_offset += 1;
+                    length++;
+                }
+
+                *error_offset += position;
+
+                if(result != Scanner::Done)
+                    return result;
+
+                if(tape != nullptr)
+                    AddTapeEntry(tape, type, Scanner::AsciiString, position, length);
+
+                position += length;
+
+                if(levels.empty())
+                    break;
+                continue;
+            }
+
+            // Decoders read shared values in order, so tapes keep them as a single entry
+            if(tape != nullptr) {
+                result = Walk(data + position, available - position, context, max_depth - levels.size(), nullptr, &length, error_offset);
+                *error_offset += position;
+
+                if(result != Scanner::Done)
+                    return result;
+
+                AddTapeEntry(tape, type, Scanner::AsciiString, position, length);
+                position += length;
+
+                if(levels.empty())
+                    break;
+                continue;
+            }
+
+            size_t start = position;
+            size_t count;
+            SharedScope shared;
+
+            position++;
+
+            if(type == BO::Columns) {
+                // Amount of rows is checked against each column in strict mode only
+                result = Scanner::ParseLength(data + position, available - position, format, &consumed, &length);
+                if(result != Scanner::Done)
+                    return result;
+                position += consumed;
+
+                result = Scanner::ParseLength(data + position, available - position, format, &consumed, &count);
+                if(result != Scanner::Done)
+                    return result;
+                if(count == 0)
+                    return Scanner::Invalid;
+                position += consumed;
+
+                for(size_t k = 0; k < count; k++) {
+                    result = Scanner::ParseLength(data + position, available - position, format, &consumed, &length);
+                    if(result != Scanner::Done)
+                        return result;
+                    if(length > available - position - consumed)
+                        return Scanner::NeedMore;
+                    position += consumed + length;
+                }
+            } else if(type == BO::Shared) {
+                // Minimum length of numbered strings
+                result = Scanner::ParseLength(data + position, available - position, format, &consumed, &length);
+                if(result != Scanner::Done)
+                    return result;
+                position += consumed;
+                count = 1;
+
+                shared.active = true;
+                shared.min_length = length;
+            } else {
+                result = Scanner::ParseLength(data + position, available - position, format, &consumed, &count);
+                if(result != Scanner::Done)
+                    return result;
+                position += consumed;
+
+                if(count > available - position)
+                    return Scanner::NeedMore;
+
+                // Distinct strings are followed by the packed indices
+                count++;
+            }
+
+            ScannerLevel level;
+            level.remaining = count;
+            level.object = false;
+            level.end = SIZE_MAX;
+            level.start = start;
+            level.shared = strict && type == BO::Shared;
+
+            // Values of shared values have numbers of their own, just like decoders give them
+            if(level.shared) {
+                level.outer = context->shared;
+                context->shared = shared;
+            }
+
+            levels.push_back(level);
+            continue;
+        }
+
+        if(strict && type == BO::Record) {
+            result = WalkRecord(data + position, available - position, context, max_depth - levels.size(), &length, error_offset);
+            *error_offset += position;
+        } else {
+            result = Scanner::ParseLeaf(data + position, available - position, format, context->types->Find(type) != nullptr, &length);
+        }
+
+        if(result != Scanner::Done)
+            return result;
+
+        if(strict && type == BO::Reference) {
+            size_t id;
+
+            Scanner::ParseLength(data + position + 1, available - position - 1, format, &consumed, &id);
+
+            if(!context->shared.active || id >= context->shared.count)
+                return Scanner::Invalid;
+        }
+
+        if(strict && type == BO::PackedArray)
+            NumberShared(context);
+
+        if(strict && (type == BO::String || type == BO::OneByteString)) {
+            size_t string_length;
+            size_t characters;
+            uint8_t kind;
+
+            Scanner::ParseLength(data + position + 1, available - position - 1, format, &consumed, &string_length);
+
+            result = ScanString(type, data + position + 1 + consumed, string_length, &kind, &characters);
+            if(result != Scanner::Done)
+                return result;
+
+            // Decoders number strings by their length in UTF-16 code units
+            if(context->shared.active && characters >= context->shared.min_length)
+                NumberShared(context);
+
+            if(tape != nullptr)
+                AddTapeEntry(tape, type, kind, position + 1 + consumed, string_length);
+        } else if(tape != nullptr) {
+            AddTapeEntry(tape, type, Scanner::AsciiString, position, length);
+        }
+
+        position += length;
+
+        if(levels.empty())
+            break;
+    }
+
+    *span = position;
+    return Scanner::Done;
+}
+
+static WalkContext NewContext(uint8_t format, CustomType::Table* types, SchemaTable* schemas, bool strict) {
+    WalkContext context;
+
+    context.format = format;
+    context.types = types;
+    context.schemas = schemas;
+    context.strict = strict;
+    return context;
+}
+
+uint8_t Scanner::Skip(const uint8_t* data, size_t available, uint8_t format, CustomType::Table* types, size_t* span) {
+    WalkContext context = NewContext(format, types, nullptr, false);
+    size_t error_offset;
+
+    return Walk(data, available, &context, SIZE_MAX, nullptr, span, &error_offset);
+}
+
+uint8_t Scanner::Validate(const uint8_t* data, size_t available, uint8_t format, CustomType::Table* types, SchemaTable* schemas,
+    size_t max_depth, size_t* span, size_t* error_offset) {
+    WalkContext context = NewContext(format, types, schemas, true);
+
+    return Walk(data, available, &context, max_depth, nullptr, span, error_offset);
+}
+
+uint8_t Scanner::BuildTape(const uint8_t* data, size_t available, uint8_t format, CustomType::Table* types, SchemaTable* schemas,
+    size_t max_depth, std::vector<TapeEntry>* tape, size_t* span, size_t* error_offset) {
+    WalkContext context = NewContext(format, types, schemas, true);
+
+    return Walk(data, available, &context, max_depth, tape, span, error_offset);
+}
@@ -0,0 +1,106 @@
+#ifndef VALUE_SCANNER_H_
+#define VALUE_SCANNER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "custom-type.h"
+#include "object-schema.h"
+
+/**
+ * Find out where values end by looking at their bytes only. Nothing is read past the
+ * memory it is given and no JavaScript value is created
+ */
+namespace Scanner {
+    enum Result {
+        Done = 0,
+        /**
+         * Input ends before the item does
+         */
+        NeedMore = 1,
+        Invalid = 2,
+        /**
+         * Containers are nested deeper than allowed
+         */
+        TooDeep = 3,
+        /**
+         * String which is not well formed UTF-8
+         */
+        InvalidString = 4
+    };
+
+    /**
+     * Characters of a string or key, as found while walking through it
+     */
+    enum StringKind {
+        AsciiString = 0,
+        Latin1String = 1,
+        /**
+         * Well formed UTF-8 with characters out of ASCII. Keys are not checked to be well formed
+         */
+        Utf8String = 2
+    };
+
+    /**
+     * Item of a value laid out in the order it's read, so values can be created out of
+     * the tape without looking at the input again to find where their items are
+     */
+    struct TapeEntry {
+        /**
+         * Type of the value, or `TapeKey` for object keys
+         */
+        uint16_t type;
+        /**
+         * `StringKind` of strings and keys
+         */
+        uint8_t kind;
+        /**
+         * Where the contents of strings and keys start. Where the type starts for anything else
+         */
+        size_t offset;
+        /**
+         * Byte length of strings and keys, item count of containers
+         */
+        size_t length;
+    };
+    /**
+     * Out of the range of value types, since custom types can use any of them
+     */
+    static const uint16_t TapeKey = 256;
+
+    /**
+     * Bytes taken by a number of `type` after it's type. Zero if it's not a number of fixed size
+     */
+    size_t NumberWidth(uint8_t type);
+    uint8_t ParseVarint(const uint8_t* data, size_t available, size_t* consumed, uint64_t* result);
+    /**
+     * Read length of a string or container out of `available` bytes of `data`
+     */
+    uint8_t ParseLength(const uint8_t* data, size_t available, uint8_t format, size_t* consumed, size_t* length);
+    /**
+     * Find out how many bytes the value starting at `data` takes, for values which are not containers.
+     * `custom` tells if it's type is a custom type known by the decoder
+     */
+    uint8_t ParseLeaf(const uint8_t* data, size_t available, uint8_t format, bool custom, size_t* span);
+    /**
+     * Find out how many bytes the value starting at `data` takes, containers included. Nested
+     * containers are followed without recursion
+     */
+    uint8_t Skip(const uint8_t* data, size_t available, uint8_t format, CustomType::Table* types, size_t* span);
+    /**
+     * Check the value starting at `data` is well formed: every length is within bounds, every type is known, containers
+     * are nested at most `max_depth` levels and sized containers hold exactly what their size tells. Records must be of
+     * one of `schemas` and match it, references must point at a value read before them in the same shared value, and
+     * every column and dictionary must hold what decoders expect. When it's not, `error_offset` is where the first item
+     * which is not valid starts
+     */
+    uint8_t Validate(const uint8_t* data, size_t available, uint8_t format, CustomType::Table* types, SchemaTable* schemas,
+        size_t max_depth, size_t* span, size_t* error_offset);
+    /**
+     * Validate value and add it's items to `tape`, containers before their contents. Sized prefixes are left out
+     */
+    uint8_t BuildTape(const uint8_t* data, size_t available, uint8_t format, CustomType::Table* types, SchemaTable* schemas,
+        size_t max_depth, std::vector<TapeEntry>* tape, size_t* span, size_t* error_offset);
+}
+
+#endif
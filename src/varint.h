@@ -0,0 +1,60 @@
+#ifndef VARINT_H_
+#define VARINT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace Varint {
+    /**
+     * Most bytes a 64-bit integer takes once encoded
+     */
+    static const size_t max_length = 10;
+
+    /**
+     * Map signed integers to unsigned ones so numbers close to zero are small either way
+     */
+    inline uint64_t ZigZag(int64_t n) {
+        return ((uint64_t) n << 1) ^ (uint64_t) (n >> 63);
+    }
+
+    inline int64_t UnZigZag(uint64_t n) {
+        return (int64_t) (n >> 1) ^ -(int64_t) (n & 1);
+    }
+
+    /**
+     * Write `n` as LEB128, seven bits per byte with the high bit telling if more bytes
+     * follow. `output` must have room for `max_length` bytes. Returns bytes written
+     */
+    inline size_t Encode(uint64_t n, uint8_t* output) {
+        size_t length = 0;
+
+        while(n >= 0x80) {
+            output[length++] = (uint8_t) (n | 0x80);
+            n >>= 7;
+        }
+
+        output[length++] = (uint8_t) n;
+        return length;
+    }
+
+    /**
+     * Read LEB128 integer out of at most `length` bytes of `input`. Returns bytes
+     * read, or zero if input ends before the integer does or it is too long
+     */
+    inline size_t Decode(const uint8_t* input, size_t length, uint64_t* result) {
+        uint64_t n = 0;
+
+        for(size_t i = 0; i < length && i < max_length; i++) {
+            n |= (uint64_t) (input[i] & 0x7f) << (7 * i);
+
+            if((input[i] & 0x80) == 0) {
+                *result = n;
+                return i + 1;
+            }
+        }
+
+        return 0;
+    }
+}
+
+#endif
@@ -2,6 +2,9 @@ import * as assert from 'assert';
 import { test } from 'sarg';
 import { randomBytes } from 'crypto';
 import { expect } from 'chai';
+import * as fs from 'fs';
+import * as os from 'os';
+import * as path from 'path';
 
 const bo = require('../');
 
@@ -134,6 +137,22 @@ test('it should encode objects with custom types', function() {
     });
 });
 
+test('it should reject custom types with reserved codes', function() {
+    for(const value of [0, 21, 25, 30])
+        assert.throws(() => new bo.ObjectEncoder([{ value, processor: new UserProcessor }]), /is reserved/);
+
+    assert.doesNotThrow(() => new bo.ObjectDecoder(Buffer.from([5]), [{ value: 31, processor: new UserProcessor }]));
+});
+
+test('it should give back errors thrown by processor decode()', async function() {
+    const encoded = new bo.ObjectEncoder([{ value: 80, processor: new UserProcessor }]).encode({ users: [new User(1, 'victor')] });
+    const failing = [{ value: 80, processor: { decode() { throw new Error('Bad user'); } } }];
+
+    assert.throws(() => new bo.ObjectDecoder(encoded, failing).decode(), /Bad user/);
+    assert.throws(() => new bo.ObjectDecoder(encoded, failing).decodeMany(), /Bad user/);
+    await assert.rejects(bo.decodeAsync(encoded, failing), /Bad user/);
+});
+
 test('it should support fractions', function() {
     const buffer = new bo.ObjectEncoder().encode({
         value: 1.79769e+308
@@ -166,4 +185,760 @@ test('it should support special characters', function() {
     assert.deepEqual(new bo.ObjectDecoder(new bo.ObjectEncoder().encode({ specialText: '¡¢£¤¥¦§¨©ª«¬®¯°±²³´µ¶·¸¹º»¼½¾¿ÁÂÃÄÅÆÇÈÉÊËÌÍÎÏÐÑÒÓÔÕÖÙÚÛÜÝÞàáâãäåæçèéêëìíîïðñòóôõöùúûüýþÿ' })).decode(), {
         specialText: '¡¢£¤¥¦§¨©ª«¬®¯°±²³´µ¶·¸¹º»¼½¾¿ÁÂÃÄÅÆÇÈÉÊËÌÍÎÏÐÑÒÓÔÕÖÙÚÛÜÝÞàáâãäåæçèéêëìíîïðñòóôõöùúûüýþÿ'
     });
-});
\ No newline at end of file
+});
+test('it should match custom types by class without calling validate()', function() {
+    class StrictUserProcessor extends UserProcessor {
+        validate(user: any): boolean {
+            throw new Error('validate() should not be called when instruction has a class matcher');
+        }
+    }
+    const instructions = [{
+        value: 80,
+        instanceOf: User,
+        processor: new StrictUserProcessor
+    }];
+    const buffer = new bo.ObjectEncoder(instructions).encode({
+        users: [new User(1, 'victor'), 10, 'text', { id: 1 }]
+    });
+
+    assert.deepEqual(new bo.ObjectDecoder(buffer, instructions).decode(), {
+        users: [new User(1, 'victor'), 10, 'text', { id: 1 }]
+    });
+});
+
+test('it should encode custom types using native processors', function() {
+    class Identifier {
+        id: Buffer;
+        constructor(id: Buffer) {
+            this.id = id;
+        }
+    }
+    const instructions = [{
+        value: 60,
+        processor: new bo.NativeProcessor({ type: 'fixed', class: Identifier, byteLength: 12, property: 'id' })
+    }, {
+        value: 61,
+        processor: new bo.NativeProcessor({ type: 'uuid' })
+    }, {
+        value: 62,
+        processor: new bo.NativeProcessor({ type: 'hex', byteLength: 4 })
+    }];
+    const source = {
+        _id: new Identifier(randomBytes(12)),
+        session: '1b4e28ba-2fa1-11d2-883f-0016541e2d5b',
+        color: 'ff00aa11',
+        upperCase: 'FF00AA11',
+        text: 'not hex'
+    };
+    const buffer = new bo.ObjectEncoder(instructions).encode(source);
+    const decoded = new bo.ObjectDecoder(buffer, instructions).decode();
+
+    assert.ok(decoded._id instanceof Identifier);
+    assert.deepEqual(decoded, source);
+
+    // Built-in processors only claim strings, so numbers are still packed and objects written as columns
+    const sessions = Array.from({ length: 10 }, (_, i) => ({ session: source.session, color: i % 2 ? 'ff00aa11' : 'not hex', count: i }));
+    const message = { sessions, counts: [1, 2, 3, 4, 5, 6, 7, 8] };
+    const columnar = new bo.ObjectEncoder(instructions, { columnar: true, packedArrays: true }).encode(message);
+
+    assert.ok(columnar.includes(27) && columnar.includes(22));
+    assert.ok(columnar.length < new bo.ObjectEncoder(instructions).encode(message).length);
+    assert.deepEqual(new bo.ObjectDecoder(columnar, instructions).decode(), message);
+});
+
+test('it should encode large buffers as references to the original memory', function() {
+    const source = {
+        name: 'image.png',
+        image: randomBytes(1024 * 64),
+        thumbnail: randomBytes(32)
+    };
+    const encoder = new bo.ObjectEncoder(undefined, { zeroCopyThreshold: 1024 });
+    const list: Buffer[] = encoder.encodeVectored(source);
+
+    assert.ok(list.some(buffer => buffer.buffer === source.image.buffer && buffer.byteOffset === source.image.byteOffset));
+    assert.ok(Buffer.concat(list).equals(encoder.encode(source)));
+    assert.ok(Buffer.concat(list).equals(new bo.ObjectEncoder(undefined, { zeroCopyThreshold: 0 }).encode(source)));
+    assert.deepEqual(new bo.ObjectDecoder(Buffer.concat(list)).decode(), source);
+});
+
+test('it should decode buffers as views of the input when zeroCopy is enabled', function() {
+    const source = { blobs: [randomBytes(128), randomBytes(4096)] };
+    const buffer = new bo.ObjectEncoder().encode(source);
+    const decoded = new bo.ObjectDecoder(buffer, undefined, { zeroCopy: true }).decode();
+
+    assert.deepEqual(decoded, source);
+    for(const blob of decoded.blobs) {
+        assert.ok(blob.buffer === buffer.buffer);
+        assert.ok(blob.byteOffset >= buffer.byteOffset && blob.byteOffset < buffer.byteOffset + buffer.byteLength);
+    }
+});
+
+test('it should encode into preallocated buffers', function() {
+    const encoder = new bo.ObjectEncoder(undefined, { initialCapacity: 1024, arenaSize: 4096 });
+    const source = { id: 1, name: 'victor', data: randomBytes(64) };
+    const expected = encoder.encode(source);
+    const target = Buffer.alloc(expected.byteLength + 10);
+
+    assert.strictEqual(encoder.encodeInto(source, target, 10), expected.byteLength);
+    assert.ok(target.slice(10).equals(expected));
+    assert.strictEqual(encoder.encodeInto(source, Buffer.alloc(expected.byteLength), 8), -8);
+    assert.ok(encoder.encode(source).equals(expected));
+    assert.deepEqual(new bo.ObjectDecoder(target.slice(10)).decode(), source);
+});
+
+test('it should only share output buffers when the arena is enabled', function() {
+    const message = { id: 1, name: 'victor' };
+    const plain = new bo.ObjectEncoder();
+    assert.notStrictEqual(plain.encode(message).buffer, plain.encode(message).buffer);
+
+    const encoder = new bo.ObjectEncoder(undefined, { arenaSize: 4096 });
+    const first = encoder.encode(message);
+    assert.strictEqual(encoder.encode(message).buffer, first.buffer);
+
+    // Transferring the arena detaches it, so the next output goes to a new one
+    structuredClone(first.buffer, { transfer: [first.buffer] });
+    const next = encoder.encode(message);
+    assert.notStrictEqual(next.buffer, first.buffer);
+    assert.deepEqual(new bo.ObjectDecoder(next).decode(), message);
+});
+
+test('it should measure encoded values without encoding them', function() {
+    const source = require('./test.json');
+    const encoder = new bo.ObjectEncoder(undefined, { exactSize: true });
+    const expected = new bo.ObjectEncoder().encode(source);
+
+    assert.strictEqual(encoder.measure(source), expected.byteLength);
+    assert.ok(encoder.encode(source).equals(expected));
+});
+
+test('it should support characters outside of latin-1', function() {
+    const source = {
+        'chave ção': 'Cristóvão Galvão',
+        '名前': '日本語のテキスト 🚀',
+        ascii: 'plain text',
+        long: 'Galvão 🚀 '.repeat(20000)
+    };
+    const encoder = new bo.ObjectEncoder(undefined, { initialCapacity: 64 });
+    const encoded = encoder.encode(source);
+    const target = Buffer.alloc(encoded.byteLength);
+
+    assert.deepEqual(new bo.ObjectDecoder(encoded).decode(), source);
+    assert.strictEqual(encoder.measure(source), encoded.byteLength);
+    assert.strictEqual(encoder.encodeInto(source, target, 0), encoded.byteLength);
+    assert.ok(target.equals(encoded));
+});
+
+test('it should decode long strings as external strings when asked to', function() {
+    const source = { text: 'a'.repeat(4096), small: 'b', accents: 'ção'.repeat(1024) };
+    const buffer = new bo.ObjectEncoder().encode(source);
+
+    assert.deepEqual(new bo.ObjectDecoder(buffer, undefined, { externalStrings: 1024 }).decode(), source);
+});
+
+test('it should reuse object keys across records', function() {
+    const records = [];
+
+    for(let i = 0; i < 1000; i++)
+        records.push({ id: i, name: 'user ' + i, 'ção': true, [`unique${i}`]: i });
+
+    const buffer = new bo.ObjectEncoder().encode(records);
+
+    for(const keyCache of ['none', 'call', 'decoder'])
+        assert.deepEqual(new bo.ObjectDecoder(buffer, undefined, { keyCache }).decode(), records);
+
+    assert.throws(() => new bo.ObjectDecoder(buffer, undefined, { keyCache: 'forever' }));
+});
+
+test('it should decode records sharing the same shape', function() {
+    const records = [];
+
+    for(let i = 0; i < 100; i++)
+        records.push({ id: i, name: 'user ' + i, nested: { x: i, y: [i, i + 1] }, 10: 'index' });
+
+    records.push({ ['__proto__']: { polluted: true } }, {}, { id: 'different order', name: 1 });
+
+    const buffer = new bo.ObjectEncoder().encode(records);
+
+    assert.deepEqual(new bo.ObjectDecoder(buffer).decode(), new bo.ObjectDecoder(buffer, undefined, { shapeCache: false }).decode());
+    assert.deepEqual(new bo.ObjectDecoder(buffer).decode().slice(0, 100), records.slice(0, 100));
+});
+
+test('it should reject containers claiming more items than the input holds', function() {
+    const huge = [255, 255, 255, 255];
+
+    // Array, object and map, on their own and inside a shared value
+    for(const type of [4, 1, 18]) {
+        assert.throws(() => new bo.ObjectDecoder(Buffer.from([type, 11, ...huge])).decode(), /Exceeded maximum size/);
+        assert.throws(() => new bo.ObjectDecoder(Buffer.from([30, 7, 0, type, 11, ...huge])).decode(), /Exceeded maximum size/);
+    }
+
+    // An object with one property needs at least two bytes
+    assert.throws(() => new bo.ObjectDecoder(Buffer.from([1, 7, 1, 7])).decode(), /Exceeded maximum size/);
+
+    // Reading stops at the first item that fails
+    const references = Buffer.from([4, 7, 3, 29, 7, 0, 29, 7, 0, 29, 7, 0]);
+
+    assert.throws(() => new bo.ObjectDecoder(references).decode(), /Got reference outside of a shared value/);
+});
+
+test('it should pack arrays of numbers using the narrowest type', function() {
+    const lists = [
+        Array.from({ length: 1000 }, (_, i) => i % 256),
+        Array.from({ length: 1000 }, (_, i) => i - 500),
+        Array.from({ length: 1000 }, (_, i) => i * 100000),
+        Array.from({ length: 1000 }, (_, i) => i + 0.5),
+        Array.from({ length: 1000 }, (_, i) => i / 3),
+        [1, 2, 3, NaN, Infinity, -Infinity]
+    ];
+    const encoder = new bo.ObjectEncoder(undefined, { packedArrays: true });
+    const unpacked = new bo.ObjectEncoder();
+
+    for(const list of lists) {
+        const buffer = encoder.encode(list);
+
+        assert.deepEqual(new bo.ObjectDecoder(buffer).decode(), list);
+        assert.deepEqual(new bo.ObjectDecoder(unpacked.encode(list)).decode(), list);
+        assert.ok(buffer.byteLength < unpacked.encode(list).byteLength);
+    }
+
+    assert.ok(encoder.encode(lists[0]).byteLength < 1010);
+    assert.deepEqual(new bo.ObjectDecoder(encoder.encode([1, 2, 3, 'a', 5])).decode(), [1, 2, 3, 'a', 5]);
+});
+
+test('it should keep the kind of typed arrays', function() {
+    const source: { [key: string]: ArrayBufferView | ArrayBuffer } = {
+        buffer: Buffer.from([1, 2, 3]),
+        bytes: new Uint8Array([1, 2, 3]),
+        clamped: new Uint8ClampedArray([4, 5]),
+        embeddings: new Float32Array([0.5, -1.25, 3]),
+        doubles: new Float64Array([Math.PI, Math.E]),
+        ints: new Int16Array([-1, 2, -3]),
+        big: new BigInt64Array([-1n, 2n ** 40n]),
+        view: new DataView(new Uint8Array([9, 8, 7]).buffer),
+        arrayBuffer: new Uint8Array([6, 5, 4]).buffer
+    };
+    const bytesOf = (value: ArrayBufferView | ArrayBuffer) =>
+        value instanceof ArrayBuffer ? Buffer.from(value) : Buffer.from(value.buffer, value.byteOffset, value.byteLength);
+    const buffer = new bo.ObjectEncoder().encode(source);
+
+    for(const zeroCopy of [false, true]) {
+        const result = new bo.ObjectDecoder(buffer, undefined, { zeroCopy }).decode();
+
+        for(const key of Object.keys(source)) {
+            assert.strictEqual(Object.getPrototypeOf(result[key]), Object.getPrototypeOf(source[key]));
+            assert.ok(bytesOf(result[key]).equals(bytesOf(source[key])));
+        }
+    }
+
+    const view = new bo.ObjectDecoder(buffer, undefined, { zeroCopy: true }).decode().embeddings;
+
+    assert.strictEqual(view.buffer, buffer.buffer);
+    assert.strictEqual(view.byteOffset % 4, 0);
+});
+
+test('it should encode 64-bit integers', function() {
+    const source = {
+        id: 18446744073709551615n,
+        negative: -9223372036854775808n,
+        small: 5n,
+        timestamp: 1700000000123456789n,
+        safe: Number.MAX_SAFE_INTEGER,
+        unsafe: -Number.MAX_SAFE_INTEGER,
+        ms: 1700000000123
+    };
+    const buffer = new bo.ObjectEncoder().encode(source);
+
+    assert.deepStrictEqual(new bo.ObjectDecoder(buffer).decode(), source);
+    assert.strictEqual(new bo.ObjectDecoder(buffer, undefined, { int64: 'number' }).decode().small, 5);
+    assert.ok(new bo.ObjectEncoder().encode(1700000000123).byteLength < 9);
+    assert.throws(() => new bo.ObjectEncoder().encode({ big: 2n ** 64n }));
+});
+
+test('it should encode messages using format 2', function() {
+    const source = {
+        id: 12345,
+        negative: -7,
+        big: 1700000000123,
+        ratio: 0.5,
+        pi: Math.PI,
+        nan: NaN,
+        name: 'a'.repeat(300),
+        list: [1, 'two', { three: 3 }],
+        numbers: [0.25, 0.5, 0.75, 1],
+        map: new Map([[1, 'one']]),
+        buffer: Buffer.alloc(200, 1),
+        embeddings: new Float32Array([1, 2, 3]),
+        id64: 2n ** 63n
+    };
+    const v1 = new bo.ObjectEncoder().encode(source);
+    const v2 = new bo.ObjectEncoder(undefined, { format: 2 }).encode(source);
+
+    assert.deepStrictEqual(new bo.ObjectDecoder(v2).decode(), new bo.ObjectDecoder(v1).decode());
+    assert.deepStrictEqual(new bo.ObjectDecoder(v2).decode().pi, Math.PI);
+    assert.ok(v2.byteLength < v1.byteLength);
+    assert.throws(() => new bo.ObjectEncoder(undefined, { format: 3 }));
+});
+
+test('it should decode values split in chunks of any size', function() {
+    const values = [
+        { id: 1, name: 'first', tags: ['a', 'b'], nested: { map: new Map<any, any>([['k', [1, 2]]]) }, empty: {}, list: [] },
+        [1, 2, 3, 4, 5, 'mixed', null, undefined, true, new Date(1000), Buffer.from('payload')],
+        { embeddings: new Float32Array([1, 2, 3]), id: 2n ** 40n, packed: [0.5, 1.5, 2.5, 3.5], text: 'ção'.repeat(100) }
+    ];
+    const input = Buffer.concat([
+        new bo.ObjectEncoder().encode(values[0]),
+        new bo.ObjectEncoder(undefined, { format: 2 }).encode(values[1]),
+        new bo.ObjectEncoder().encode(values[2])
+    ]);
+
+    for(const chunkSize of [1, 2, 3, 7, 64, input.byteLength]) {
+        const decoder = new bo.ObjectStreamDecoder();
+        const results = [];
+
+        for(let i = 0; i < input.byteLength; i += chunkSize)
+            results.push(...decoder.write(input.slice(i, i + chunkSize)));
+
+        decoder.end();
+        assert.deepStrictEqual(results, values);
+    }
+
+    const elements: any[] = [];
+    const decoder = new bo.ObjectStreamDecoder(undefined, {
+        onElement: (value: any, index: number) => elements.push([index, value])
+    });
+
+    for(const byte of new bo.ObjectEncoder().encode(['a', { b: 1 }, [2]]))
+        assert.deepEqual(decoder.write(Buffer.from([byte])), []);
+
+    assert.deepEqual(elements, [[0, 'a'], [1, { b: 1 }], [2, [2]]]);
+
+    const truncated = new bo.ObjectStreamDecoder();
+    truncated.write(new bo.ObjectEncoder().encode({ a: 'text' }).slice(0, 5));
+    assert.throws(() => truncated.end());
+    assert.throws(() => new bo.ObjectStreamDecoder().write(Buffer.from([200])));
+});
+
+test('it should encode arrays one element at a time in chunks of fixed size', function() {
+    const records = Array.from({ length: 2000 }, (_, i) => ({ id: i, name: 'record ' + i, values: [i, i * 2] }));
+    const encoder = new bo.ObjectStreamEncoder(undefined, { chunkSize: 1024 });
+    const chunks: Buffer[] = [...encoder.writeArrayHeader(records.length)];
+
+    for(const record of records)
+        chunks.push(...encoder.write(record));
+
+    chunks.push(...encoder.end());
+
+    assert.ok(chunks.slice(0, -1).every(chunk => chunk.byteLength == 1024));
+    assert.ok(chunks[chunks.length - 1].byteLength <= 1024);
+    assert.deepEqual(new bo.ObjectDecoder(Buffer.concat(chunks)).decode(), records);
+
+    const unfinished = new bo.ObjectStreamEncoder();
+    unfinished.writeArrayHeader(2);
+    unfinished.write(1);
+    assert.throws(() => unfinished.end());
+    assert.throws(() => unfinished.write({ big: 2n ** 64n }));
+});
+
+test('it should pipe records through encode and decode streams', function() {
+    const records = Array.from({ length: 500 }, (_, i) => ({ id: i, text: 'x'.repeat(i) }));
+    const encoder = new bo.EncodeStream(undefined, { length: records.length, chunkSize: 4096, format: 2 });
+    const decoder = new bo.DecodeStream(undefined, { elements: true });
+    const results: any[] = [];
+
+    decoder.on('data', (record: any) => results.push(record));
+    encoder.pipe(decoder);
+
+    for(const record of records)
+        encoder.write(record);
+    encoder.end();
+
+    return new Promise<void>((resolve, reject) => {
+        decoder.on('error', reject);
+        decoder.on('end', () => {
+            assert.deepEqual(results, records);
+            resolve();
+        });
+    });
+});
+
+test('it should stream null values without ending the stream', function() {
+    const values = [1, null, 'a', null, { value: null }, 2];
+    const encoder = new bo.EncodeStream(undefined, { length: values.length });
+    const decoder = new bo.DecodeStream(undefined, { elements: true });
+    const results: any[] = [];
+
+    decoder.on('data', (value: any) => results.push(value === bo.NULL ? null : value));
+    encoder.pipe(decoder);
+
+    for(const value of values)
+        encoder.write(value === null ? bo.NULL : value);
+    encoder.end();
+
+    return new Promise<void>((resolve, reject) => {
+        decoder.on('error', reject);
+        decoder.on('end', () => {
+            assert.deepEqual(results, values);
+            resolve();
+        });
+    });
+});
+
+test('it should skip sized containers and decode them lazily', function() {
+    const envelope = {
+        id: 'request-1',
+        headers: { host: 'example.com', accept: '*/*' },
+        body: Array.from({ length: 1000 }, (_, i) => ({ index: i, name: `item ${i}` }))
+    };
+
+    for(const format of [1, 2]) {
+        const encoded = new bo.ObjectEncoder(undefined, { sizedContainers: true, format }).encode(envelope);
+
+        assert.deepEqual(new bo.ObjectDecoder(encoded).decode(), envelope);
+
+        const decoder = new bo.ObjectDecoder(Buffer.concat([encoded, encoded]));
+
+        assert.equal(decoder.skipValue(), format == 2 ? 2 : 0);
+
+        const lazy = decoder.decodeLazy();
+
+        assert.equal(lazy.id, 'request-1');
+        assert.equal(lazy.headers.host, 'example.com');
+        assert.equal(lazy.body.length, 1000);
+        assert.deepEqual(lazy.body[999], envelope.body[999]);
+        assert.deepEqual(Object.keys(lazy), ['id', 'headers', 'body']);
+        assert.deepEqual(JSON.parse(JSON.stringify(lazy)), envelope);
+    }
+});
+
+test('it should decode only the requested paths', function() {
+    const message = {
+        user: { id: 10, name: 'Alice', avatar: Buffer.alloc(256) },
+        items: [{ price: 1.5, title: 'a' }, { price: 20, title: 'b', tags: ['x'] }],
+        notes: 'x'.repeat(1000)
+    };
+
+    for(const sizedContainers of [false, true]) {
+        const encoded = new bo.ObjectEncoder(undefined, { sizedContainers }).encode(message);
+        const decoded = new bo.ObjectDecoder(encoded).decode({ paths: ['user.id', 'items.*.price', 'items.1.tags'] });
+
+        assert.deepEqual(decoded, {
+            user: { id: 10 },
+            items: [{ price: 1.5 }, { price: 20, tags: ['x'] }]
+        });
+    }
+
+    assert.throws(() => new bo.ObjectDecoder(Buffer.from([5])).decode({ paths: ['user..id'] }));
+
+    // An empty list would select nothing rather than everything
+    assert.throws(() => new bo.ObjectDecoder(Buffer.from([5])).decode({ paths: [] }), /Option `paths` must not be empty/);
+
+    // Packed arrays and schema records are read whole when a path goes through them
+    class Person {
+        constructor(public id: number, public name: string) {}
+    }
+
+    const schema = bo.compileSchema({ id: 'uint32', name: 'string' }, { id: 4, class: Person });
+    const packed = new bo.ObjectEncoder(undefined, { schemas: [schema], packedArrays: true }).encode({ items: [1, 2, 3, 4], user: new Person(1, 'a') });
+    const projected = new bo.ObjectDecoder(packed, undefined, { schemas: [schema] }).decode({ paths: ['items.*', 'user.name'] });
+
+    assert.deepEqual(projected, { items: [1, 2, 3, 4], user: { id: 1, name: 'a' } });
+});
+
+test('it should validate messages without decoding them', function() {
+    const message = { id: 1, tags: ['a', 'b'], nested: { list: [[1], [2]] } };
+
+    for(const options of [{}, { format: 2 }, { sizedContainers: true }]) {
+        const encoded = new bo.ObjectEncoder(undefined, options).encode(message);
+
+        assert.equal(bo.validate(encoded), null);
+        assert.equal(bo.validate(encoded.slice(0, encoded.length - 1)).message, 'Input ends before the value does');
+        assert.equal(bo.validate(Buffer.concat([encoded, Buffer.from([5])])).offset, encoded.length);
+        assert.equal(bo.validate(encoded, undefined, { maxDepth: 2 }).message, 'Containers are nested too deep');
+    }
+
+    // Array of length 2 whose second item has an unknown type
+    assert.deepEqual(bo.validate(Buffer.from([4, 7, 2, 5, 99])), { offset: 4, message: 'Got invalid value' });
+
+    // Anything decoders would reject is invalid, not only lengths and types
+    const malformed = [
+        // Reference outside of a shared value, and one to a value not read yet
+        [29, 7, 0],
+        [30, 7, 8, 4, 7, 2, 29, 7, 5, 5],
+        // Reference to a string shorter than the minimum length of numbered strings
+        [30, 7, 2, 4, 7, 2, 2, 7, 1, 120, 29, 7, 1],
+        // Dictionary with a number among it's strings, and one whose indices are not packed
+        [28, 7, 1, 7, 1, 22, 7, 7, 2, 0, 0],
+        [28, 7, 1, 2, 7, 1, 120, 4, 7, 1, 7, 0],
+        // Dictionary index past it's strings
+        [28, 7, 1, 2, 7, 1, 120, 22, 7, 7, 2, 0, 1],
+        // Columns of 3 rows whose column only has 2 cells
+        [27, 7, 3, 7, 1, 7, 1, 97, 22, 7, 7, 2, 1, 2],
+        [27, 7, 3, 7, 1, 7, 1, 97, 4, 7, 2, 5, 5]
+    ];
+
+    for(const bytes of malformed) {
+        const buffer = Buffer.from(bytes);
+
+        assert.notEqual(bo.validate(buffer), null);
+        assert.throws(() => new bo.ObjectDecoder(buffer).decode());
+    }
+
+    assert.equal(bo.validate(Buffer.from([30, 7, 1, 4, 7, 2, 2, 7, 1, 120, 29, 7, 1])), null);
+
+    // Records must be of a known schema and match it
+    const schema = bo.compileSchema({ id: 'uint32', name: 'string' }, { id: 4 });
+    const record = schema.encode({ id: 1, name: 'a' });
+    const other = bo.compileSchema({ id: 'uint32' }, { id: 4 });
+
+    assert.equal(bo.validate(record, undefined, { schemas: [schema] }), null);
+    assert.notEqual(bo.validate(record), null);
+    assert.notEqual(bo.validate(record, undefined, { schemas: [other] }), null);
+    assert.throws(() => new bo.ObjectDecoder(record, undefined, { schemas: [other] }).decode(), /doesn't match schema/);
+});
+
+test('it should decode on the thread pool', async function() {
+    const message = {
+        users: Array.from({ length: 200 }, (_, i) => ({ id: i, name: `user ${i}`, city: 'São Paulo', tags: new Map([['a', i]]) })),
+        created: new Date(0),
+        payload: Buffer.from('hello')
+    };
+
+    for(const options of [{}, { format: 2, sizedContainers: true }]) {
+        const encoded = new bo.ObjectEncoder(undefined, options).encode(message);
+        const results = await Promise.all([bo.decodeAsync(encoded), bo.decodeAsync(encoded)]);
+
+        for(const result of results)
+            assert.deepEqual(result, message);
+    }
+
+    await assert.rejects(bo.decodeAsync(Buffer.from([4, 7, 2, 5, 99])), /Got invalid value at offset 4/);
+
+    // Malformed UTF-8 is rejected by both, instead of being replaced by one of them
+    const invalid = Buffer.from([4, 7, 2, 2, 7, 2, 0xc3, 0xa9, 2, 7, 2, 0xc3, 0x28]);
+
+    assert.throws(() => new bo.ObjectDecoder(invalid).decode(), /Got invalid UTF-8 string/);
+    await assert.rejects(bo.decodeAsync(invalid), /Got invalid UTF-8 string at offset 8/);
+    assert.deepEqual(bo.validate(invalid), { offset: 8, message: 'Got invalid UTF-8 string' });
+    assert.equal(await bo.decodeAsync(Buffer.from([2, 7, 2, 0xc3, 0xa9])), 'é');
+});
+
+test('it should encode and decode many messages at once', function() {
+    const events = Array.from({ length: 100 }, (_, i) => ({ topic: `topic ${i % 3}`, sequence: i, large: i * 2 ** 40 }));
+
+    for(const format of [1, 2]) {
+        const encoder = new bo.ObjectEncoder(undefined, { format });
+        const { buffer, offsets } = encoder.encodeMany(events);
+
+        assert.equal(offsets.length, events.length + 1);
+        assert.equal(offsets[events.length], buffer.length);
+        assert.deepEqual(new bo.ObjectDecoder(buffer.subarray(offsets[42], offsets[43])).decode(), events[42]);
+        assert.deepEqual(new bo.ObjectDecoder(buffer).decodeMany(), events);
+    }
+
+    assert.deepEqual(new bo.ObjectEncoder().encodeMany([]).buffer.length, 0);
+});
+
+test('it should encode records of a schema without their keys', function() {
+    class Event {
+        constructor(public id: number, public name: string, public tags: string[], public position: { x: number, y: number }, public extra?: any) {}
+    }
+
+    const definition = { id: 'uint32', name: 'string', tags: ['string'], position: { x: 'float', y: 'double' }, extra: 'any' };
+    const schema = bo.compileSchema(definition, { id: 3, class: Event });
+    const plain = { id: 7, name: 'created', tags: ['a', 'b'], position: { x: 1.5, y: 0.1 }, extra: null };
+    const encoded = schema.encode(plain);
+
+    assert.deepEqual(schema.decode(encoded), plain);
+    assert.ok(encoded.length < new bo.ObjectEncoder().encode(plain).length);
+    assert.throws(() => schema.encode({ ...plain, id: -1 }), /Field `id` must be uint32/);
+
+    const events = [new Event(1, 'a', [], { x: 0, y: 1 }), new Event(2, 'b', ['c'], { x: 2, y: 3 }, { nested: true })];
+    const message = new bo.ObjectEncoder(undefined, { schemas: [schema], format: 2 }).encode({ events, count: 2 });
+    const decoded = new bo.ObjectDecoder(message, undefined, { schemas: [schema] }).decode();
+
+    assert.equal(decoded.count, 2);
+    assert.deepEqual(decoded.events, events.map((event) => ({ ...event, extra: event.extra })));
+    assert.equal(bo.validate(message), null);
+    assert.throws(() => new bo.ObjectDecoder(message).decode(), /unknown schema 3/);
+});
+
+test('it should encode arrays of objects with the same keys as columns', function() {
+    const rows = Array.from({ length: 50 }, (_, i) => ({ id: i, status: i % 3 ? 'open' : 'closed', price: i / 4, note: i % 2 ? null : `note ${i}` }));
+    const message = { rows, total: rows.length };
+
+    for(const format of [1, 2]) {
+        const encoded = new bo.ObjectEncoder(undefined, { columnar: true, format }).encode(message);
+
+        assert.ok(encoded.length < new bo.ObjectEncoder(undefined, { format }).encode(message).length);
+        assert.deepEqual(new bo.ObjectDecoder(encoded).decode(), message);
+        assert.equal(bo.validate(encoded), null);
+
+        const columns = new bo.ObjectDecoder(encoded, undefined, { columns: 'arrays' }).decode().rows;
+
+        assert.ok(columns.id instanceof Uint8Array);
+        assert.deepEqual(Array.from(columns.price), rows.map((row) => row.price));
+        assert.deepEqual(columns.status, rows.map((row) => row.status));
+        assert.deepEqual(columns.note, rows.map((row) => row.note));
+    }
+
+    // Arrays whose objects don't share their keys are written as usual
+    const mixed = [...rows.slice(0, 10), { id: 10 }];
+
+    assert.deepEqual(new bo.ObjectDecoder(new bo.ObjectEncoder(undefined, { columnar: true }).encode(mixed)).decode(), mixed);
+
+    // Columns without keys would let a few bytes claim any amount of rows
+    const keyless = Buffer.from([27, 11, 255, 255, 255, 255, 7, 0]);
+
+    assert.notEqual(bo.validate(keyless), null);
+    assert.throws(() => new bo.ObjectDecoder(keyless).decode(), /Columns must have at least one key/);
+
+    // Integer-like keys are columns like any other
+    const numeric = Array.from({ length: 10 }, (_, i) => ({ 1: `a${i}`, 2: i, name: 'x' }));
+
+    assert.deepEqual(new bo.ObjectDecoder(new bo.ObjectEncoder(undefined, { columnar: true }).encode(numeric)).decode(), numeric);
+});
+
+test('it should write repeated values as references when asked to', function() {
+    const metadata = { source: 'cache', region: 'eu-west-1', tags: ['a', 'b'] };
+    const items = Array.from({ length: 20 }, (_, i) => ({ id: i, status: i % 2 ? 'status:pending-review' : 'status:approved', metadata }));
+    const message = { items, first: items[0] };
+
+    for(const format of [1, 2]) {
+        const encoded = new bo.ObjectEncoder(undefined, { references: true, format }).encode(message);
+        const decoded = new bo.ObjectDecoder(encoded).decode();
+
+        assert.ok(encoded.length < new bo.ObjectEncoder(undefined, { format }).encode(message).length);
+        assert.deepEqual(decoded, message);
+        assert.equal(decoded.items[0].metadata, decoded.items[1].metadata);
+        assert.equal(decoded.first, decoded.items[0]);
+        assert.equal(bo.validate(encoded), null);
+    }
+
+    const node: any = { name: 'root', children: [] };
+    node.children.push({ name: 'child', parent: node });
+    node.self = node;
+
+    const decoded = new bo.ObjectDecoder(new bo.ObjectEncoder(undefined, { references: true }).encode(node)).decode();
+
+    assert.equal(decoded.self, decoded);
+    assert.equal(decoded.children[0].parent, decoded);
+    assert.equal(decoded.children[0].name, 'child');
+});
+
+test('it should reject records which contain themselves', function() {
+    class Item {
+        constructor(public name: string, public next: any) {}
+    }
+
+    const schema = bo.compileSchema({ name: 'string', next: 'any' }, { id: 5, class: Item });
+    const direct = new Item('a', null);
+    const nested = new Item('b', null);
+
+    direct.next = direct;
+    nested.next = { list: [nested] };
+
+    for(const references of [false, true]) {
+        const encoder = new bo.ObjectEncoder(undefined, { schemas: [schema], references });
+
+        assert.throws(() => encoder.encode(direct), /Record of schema 5 contains itself/);
+        assert.throws(() => encoder.encode(nested), /Record of schema 5 contains itself/);
+
+        // The same record more than once is not a cycle
+        const leaf = new Item('leaf', null);
+        const encoded = encoder.encode([leaf, new Item('parent', leaf), leaf]);
+        const decoded = new bo.ObjectDecoder(encoded, undefined, { schemas: [schema] }).decode();
+
+        assert.deepEqual(decoded, [{ name: 'leaf', next: null }, { name: 'parent', next: { name: 'leaf', next: null } }, { name: 'leaf', next: null }]);
+    }
+});
+
+test('it should compress messages in blocks and decode them transparently', async function() {
+    const message = { items: Array.from({ length: 2000 }, (_, i) => ({ id: i, name: `item ${i % 10}`, enabled: i % 2 == 0 })) };
+    const raw = new bo.ObjectEncoder().encode(message);
+
+    for(const format of [1, 2]) {
+        const encoded = new bo.ObjectEncoder(undefined, { compress: true, blockSize: 4096, format }).encode(message);
+
+        assert.deepEqual(Array.from(encoded.subarray(0, 2)), [0, 3]);
+        assert.ok(encoded.length < raw.length / 2);
+        assert.deepEqual(new bo.ObjectDecoder(encoded).decode(), message);
+        assert.deepEqual(await bo.decodeAsync(encoded), message);
+        assert.equal(bo.validate(encoded), null);
+
+        const corrupted = Buffer.from(encoded);
+        corrupted[corrupted.length - 10] ^= 0xff;
+        assert.throws(() => new bo.ObjectDecoder(corrupted).decode(), /Compressed frame has/);
+        await assert.rejects(bo.decodeAsync(corrupted), /Compressed frame has/);
+        assert.throws(() => new bo.ObjectDecoder(encoded.subarray(0, encoded.length - 1)).decode(), /Compressed frame/);
+    }
+
+    assert.deepEqual(new bo.ObjectDecoder(new bo.ObjectEncoder(undefined, { compress: true }).encode({})).decode(), {});
+
+    // Frames are compressed on the thread pool, and several of them can be written and read at once
+    const options = { compress: true, blockSize: 4096 };
+    const encoded = await bo.encodeAsync(message, undefined, options);
+    assert.deepEqual(Array.from(encoded.subarray(0, 2)), [0, 3]);
+    assert.deepEqual(new bo.ObjectDecoder(encoded).decode(), message);
+    assert.deepEqual(await Promise.all([
+        bo.encodeAsync(message, undefined, options).then((buffer: Buffer) => bo.decodeAsync(buffer)),
+        bo.decodeAsync(encoded),
+        new bo.BinaryObject(undefined, options).encodeAsync(message).then((buffer: Buffer) => bo.decodeAsync(buffer))
+    ]), [message, message, message]);
+    assert.deepEqual(new bo.ObjectDecoder(await bo.encodeAsync([1, 'a'])).decode(), [1, 'a']);
+    assert.throws(() => new bo.ObjectEncoder().encodeAsync({}, undefined), /Expected callback function/);
+    assert.throws(() => new bo.ObjectEncoder(undefined, { compress: true, blockSize: 0 }), /Block size must be greater than zero/);
+
+    // Only encode() and encodeAsync() give back frames, so methods which would write plain messages throw instead
+    const compressing = new bo.ObjectEncoder(undefined, { compress: true });
+
+    assert.throws(() => compressing.measure(message), /only applies to encode\(\) and encodeAsync\(\), not to measure\(\)/);
+    assert.throws(() => compressing.encodeInto(message, Buffer.alloc(raw.length)), /not to encodeInto\(\)/);
+    assert.throws(() => compressing.encodeMany([message]), /not to encodeMany\(\)/);
+    assert.throws(() => compressing.encodeVectored(message), /not to encodeVectored\(\)/);
+    assert.throws(() => new bo.ObjectStreamEncoder(undefined, { compress: true }), /not to stream encoders/);
+    assert.throws(() => new bo.ObjectEncoder(undefined, { compress: true, exactSize: true }), /can't be used together/);
+});
+
+test('it should append records to a log and read them back by number', function() {
+    const directory = fs.mkdtempSync(path.join(os.tmpdir(), 'binobject-'));
+    const file = path.join(directory, 'records.log');
+    const records = Array.from({ length: 100 }, (_, i) => ({ id: i, name: `record ${i}`, payload: Buffer.alloc(i % 7, i) }));
+
+    try {
+        const writer = new bo.RecordLogWriter(file, undefined, { flushThreshold: 256 });
+        assert.equal(writer.append(records[0]), 0);
+        assert.equal(writer.appendMany(records.slice(1, 60)), 1);
+        writer.close();
+
+        // Reopened logs carry on after their last record
+        const appender = new bo.RecordLogWriter(file);
+        assert.equal(appender.count(), 60);
+        appender.appendMany(records.slice(60));
+        appender.close();
+
+        const reader = new bo.RecordLogReader(file, undefined, { zeroCopy: true, verifyChecksums: true });
+        assert.equal(reader.count(), 100);
+        assert.deepEqual(reader.decode(42), records[42]);
+        assert.deepEqual(new bo.ObjectDecoder(reader.record(99)).decode(), records[99]);
+        assert.deepEqual(Array.from(reader), records);
+        assert.throws(() => reader.decode(100), /Record number is out of range/);
+        reader.close();
+        assert.throws(() => reader.decode(0), /Record log was closed/);
+
+        // Records missing from the index and records cut short by a crash are found when the log is opened
+        fs.truncateSync(file + '.idx', 98 * 8);
+        fs.truncateSync(file, fs.statSync(file).size - 3);
+        assert.equal(new bo.RecordLogReader(file).count(), 99);
+
+        const recovered = new bo.RecordLogWriter(file);
+        assert.equal(recovered.count(), 99);
+        recovered.append(records[99]);
+        recovered.close();
+        assert.deepEqual(Array.from(new bo.RecordLogReader(file)), records);
+
+        fs.writeFileSync(file, 'not a log');
+        assert.throws(() => new bo.RecordLogReader(file), /File is not a record log/);
+    } finally {
+        fs.rmSync(directory, { recursive: true, force: true });
+    }
+});